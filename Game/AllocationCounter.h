@@ -0,0 +1,10 @@
+#pragma once
+
+
+// Number of calls to the global operator new since the start, from every thread. The replaced operators
+// forward to malloc and free, allocations made through them directly (C libraries, drivers) aren't counted.
+class AllocationCounter
+{
+public:
+	static unsigned long long count();
+};
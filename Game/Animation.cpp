@@ -0,0 +1,286 @@
+#include "Animation.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "Model.h"
+#include "SimdLanes.h"
+
+
+constexpr float AnimationClip::s_frame_rate;
+constexpr size_t AnimationClip::s_tracks;
+
+namespace
+{
+	using namespace Simd;
+
+	constexpr size_t JOINT_BATCH = 8; // joints are padded to a multiple of the widest batch
+	constexpr size_t TRANSLATION_TRACK = 0, ROTATION_TRACK = 3, SCALE_TRACK = 7;
+
+	static_assert(JOINT_BATCH % LANE_COUNT == 0, "Joints must be padded to whole SIMD batches");
+
+	// out = a + (b - a) * weight over count floats, out may be a
+	void lerp(float const* a, float const* b, float const& weight, size_t const& count, float* out)
+	{
+		const Lanes t(set1(weight));
+		for (size_t i = 0; i < count; i += LANE_COUNT) {
+			const Lanes from(load(a + i));
+			store(out + i, from + (load(b + i) - from) * t);
+		}
+	}
+
+	// Like lerp, the rotations of b being taken in the hemisphere of those of a so that the joints turn the short way
+	void blend(float const* a, float const* b, float const& weight, size_t const& stride, float* out)
+	{
+		lerp(a + TRANSLATION_TRACK * stride, b + TRANSLATION_TRACK * stride, weight, 3 * stride, out + TRANSLATION_TRACK * stride);
+		lerp(a + SCALE_TRACK * stride, b + SCALE_TRACK * stride, weight, 3 * stride, out + SCALE_TRACK * stride);
+
+		const Lanes t(set1(weight));
+		float const* const ra(a + ROTATION_TRACK * stride);
+		float const* const rb(b + ROTATION_TRACK * stride);
+		float* const rout(out + ROTATION_TRACK * stride);
+		for (size_t i = 0; i < stride; i += LANE_COUNT) {
+			const Lanes ax(load(ra + i)), ay(load(ra + stride + i)), az(load(ra + 2 * stride + i)), aw(load(ra + 3 * stride + i));
+			const Lanes bx(load(rb + i)), by(load(rb + stride + i)), bz(load(rb + 2 * stride + i)), bw(load(rb + 3 * stride + i));
+			const Lanes dot(ax * bx + ay * by + az * bz + aw * bw);
+
+			store(rout + i, ax + (flipSign(bx, dot) - ax) * t);
+			store(rout + stride + i, ay + (flipSign(by, dot) - ay) * t);
+			store(rout + 2 * stride + i, az + (flipSign(bz, dot) - az) * t);
+			store(rout + 3 * stride + i, aw + (flipSign(bw, dot) - aw) * t);
+		}
+	}
+
+	// Linear blending shortens the quaternions, padding joints are identities so none of them is null
+	void normalizeRotations(float* pose, size_t const& stride)
+	{
+		const Lanes one(set1(1.f));
+		float* const rotations(pose + ROTATION_TRACK * stride);
+		for (size_t i = 0; i < stride; i += LANE_COUNT) {
+			const Lanes x(load(rotations + i)), y(load(rotations + stride + i)), z(load(rotations + 2 * stride + i)), w(load(rotations + 3 * stride + i));
+			const Lanes inverse_length(one / sqrt(x * x + y * y + z * z + w * w));
+
+			store(rotations + i, x * inverse_length);
+			store(rotations + stride + i, y * inverse_length);
+			store(rotations + 2 * stride + i, z * inverse_length);
+			store(rotations + 3 * stride + i, w * inverse_length);
+		}
+	}
+
+	// Local = T * R * S, like the world transforms of TransformSystem
+	void composeLocals(float const* pose, size_t const& stride, glm::mat4* out)
+	{
+		float const* const translation[3] = { pose + TRANSLATION_TRACK * stride, pose + (TRANSLATION_TRACK + 1) * stride, pose + (TRANSLATION_TRACK + 2) * stride };
+		float const* const rotation[4] = { pose + ROTATION_TRACK * stride, pose + (ROTATION_TRACK + 1) * stride, pose + (ROTATION_TRACK + 2) * stride, pose + (ROTATION_TRACK + 3) * stride };
+		float const* const scale[3] = { pose + SCALE_TRACK * stride, pose + (SCALE_TRACK + 1) * stride, pose + (SCALE_TRACK + 2) * stride };
+		composeTrs(translation, rotation, scale, stride, out);
+	}
+
+	// progress in [0, 1) along the clip
+	void sample(AnimationClip const& clip, float const& progress, size_t const& count, float* out)
+	{
+		const float position(progress * static_cast<float>(clip.frameCount() - 1));
+		const size_t first(std::min(static_cast<size_t>(position), clip.frameCount() - 2));
+		lerp(clip.frame(first), clip.frame(first + 1), position - static_cast<float>(first), count, out);
+	}
+}
+
+
+size_t Skeleton::jointCount() const
+{
+	return parents.size();
+}
+
+size_t Skeleton::paddedJointCount() const
+{
+	return (jointCount() + JOINT_BATCH - 1) / JOINT_BATCH * JOINT_BATCH;
+}
+
+int Skeleton::find(std::string const& name) const
+{
+	const auto joint(std::find(names.begin(), names.end(), name));
+	return joint != names.end() ? static_cast<int>(joint - names.begin()) : -1;
+}
+
+// The local matrix is split back into translation, rotation and scale, which are what clips blend
+size_t Skeleton::addJoint(std::string const& name, int const& parent, glm::mat4 const& local)
+{
+	const glm::vec3 scale(glm::length(glm::vec3(local[0])), glm::length(glm::vec3(local[1])), glm::length(glm::vec3(local[2])));
+	const glm::mat3 rotation(
+		scale.x > 0.f ? glm::vec3(local[0]) / scale.x : glm::vec3(1.f, 0.f, 0.f),
+		scale.y > 0.f ? glm::vec3(local[1]) / scale.y : glm::vec3(0.f, 1.f, 0.f),
+		scale.z > 0.f ? glm::vec3(local[2]) / scale.z : glm::vec3(0.f, 0.f, 1.f));
+
+	names.push_back(name);
+	parents.push_back(parent);
+	bind_translations.push_back(glm::vec3(local[3]));
+	bind_rotations.push_back(glm::normalize(glm::quat_cast(rotation)));
+	bind_scales.push_back(scale);
+	return names.size() - 1;
+}
+
+// Returns the index of the joint's bone, meshes sharing a bone share its palette entry
+size_t Skeleton::addBone(size_t const& joint, glm::mat4 const& inverse_bind)
+{
+	const auto bone(std::find(bone_joints.begin(), bone_joints.end(), joint));
+	if (bone != bone_joints.end())
+		return static_cast<size_t>(bone - bone_joints.begin());
+	if (bone_joints.size() >= MAX_SKELETON_BONES)
+		return MAX_SKELETON_BONES;
+
+	bone_joints.push_back(joint);
+	inverse_binds.push_back(inverse_bind);
+	return bone_joints.size() - 1;
+}
+
+
+// Every frame starts in the bind pose, joints without a channel keep it
+AnimationClip::AnimationClip(std::string const& name, Skeleton const& skeleton, float const& duration) : m_name(name), m_duration(std::max(duration, 0.f)),
+	m_frame_count(std::max<size_t>(2, static_cast<size_t>(std::ceil(m_duration * s_frame_rate)) + 1)), m_stride(skeleton.paddedJointCount()),
+	m_frames(m_frame_count * s_tracks * m_stride, 0.f)
+{
+	for (size_t frame = 0; frame < m_frame_count; frame++) {
+		float* const tracks(&m_frames[frame * s_tracks * m_stride]);
+		for (size_t joint = 0; joint < m_stride; joint++) {
+			tracks[(ROTATION_TRACK + 3) * m_stride + joint] = 1.f;
+			for (size_t axis = 0; axis < 3; axis++)
+				tracks[(SCALE_TRACK + axis) * m_stride + joint] = 1.f;
+		}
+		for (size_t joint = 0; joint < skeleton.jointCount(); joint++)
+			setKey(frame, joint, skeleton.bind_translations[joint], skeleton.bind_rotations[joint], skeleton.bind_scales[joint]);
+	}
+}
+
+void AnimationClip::setKey(size_t const& frame, size_t const& joint, glm::vec3 const& translation, glm::quat const& rotation, glm::vec3 const& scale)
+{
+	float* const tracks(&m_frames[frame * s_tracks * m_stride]);
+
+	glm::quat key(rotation);
+	if (frame > 0) {
+		float const* const previous(tracks - s_tracks * m_stride + ROTATION_TRACK * m_stride + joint);
+		if (previous[0] * key.x + previous[m_stride] * key.y + previous[2 * m_stride] * key.z + previous[3 * m_stride] * key.w < 0.f)
+			key = -key;
+	}
+
+	for (int axis = 0; axis < 3; axis++) {
+		tracks[(TRANSLATION_TRACK + static_cast<size_t>(axis)) * m_stride + joint] = translation[axis];
+		tracks[(SCALE_TRACK + static_cast<size_t>(axis)) * m_stride + joint] = scale[axis];
+	}
+	tracks[ROTATION_TRACK * m_stride + joint] = key.x;
+	tracks[(ROTATION_TRACK + 1) * m_stride + joint] = key.y;
+	tracks[(ROTATION_TRACK + 2) * m_stride + joint] = key.z;
+	tracks[(ROTATION_TRACK + 3) * m_stride + joint] = key.w;
+}
+
+std::string const& AnimationClip::name() const
+{
+	return m_name;
+}
+
+float AnimationClip::duration() const
+{
+	return m_duration;
+}
+
+size_t AnimationClip::frameCount() const
+{
+	return m_frame_count;
+}
+
+float AnimationClip::frameTime(size_t const& index) const
+{
+	return m_duration * static_cast<float>(index) / static_cast<float>(m_frame_count - 1);
+}
+
+float const* AnimationClip::frame(size_t const& index) const
+{
+	return &m_frames[index * s_tracks * m_stride];
+}
+
+
+AnimationSystem::AnimationSystem() : m_skeletons(), m_animations(), m_objects(), m_clips(), m_blend_clips(), m_blend_weights(), m_speeds(), m_phases()
+{
+}
+
+// The model must have a skeleton and outlive the system
+size_t AnimationSystem::create(size_t const& object, Model const& model, size_t const& clip, float const& speed, float const& phase)
+{
+	return create(object, *model.skeleton(), model.animations(), clip, speed, phase);
+}
+
+// The skeleton and the clips must outlive the system
+size_t AnimationSystem::create(size_t const& object, Skeleton const& skeleton, std::vector<AnimationClip> const& clips, size_t const& clip, float const& speed, float const& phase)
+{
+	m_skeletons.push_back(&skeleton);
+	m_animations.push_back(&clips);
+	m_objects.push_back(object);
+	m_clips.push_back(clip);
+	m_blend_clips.push_back(clip);
+	m_blend_weights.push_back(0.f);
+	m_speeds.push_back(speed);
+	m_phases.push_back(phase);
+	return m_skeletons.size() - 1;
+}
+
+void AnimationSystem::setBlend(size_t const& handle, size_t const& clip, float const& weight)
+{
+	m_blend_clips[handle] = clip;
+	m_blend_weights[handle] = glm::clamp(weight, 0.f, 1.f);
+}
+
+size_t AnimationSystem::size() const
+{
+	return m_skeletons.size();
+}
+
+size_t AnimationSystem::object(size_t const& handle) const
+{
+	return m_objects[handle];
+}
+
+size_t AnimationSystem::boneCount(size_t const& handle) const
+{
+	return m_skeletons[handle]->bone_joints.size();
+}
+
+// Safe to call concurrently, the scratch is per thread and only palette is written
+void AnimationSystem::evaluate(size_t const& handle, double const& time, glm::vec4* palette) const
+{
+	Skeleton const& skeleton(*m_skeletons[handle]);
+	std::vector<AnimationClip> const& clips(*m_animations[handle]);
+	const size_t stride(skeleton.paddedJointCount());
+	const size_t floats(stride * AnimationClip::s_tracks);
+
+	thread_local std::vector<float> pose, blended;
+	thread_local std::vector<glm::mat4> locals, globals;
+	pose.resize(floats);
+	locals.resize(stride);
+	globals.resize(stride);
+
+	// Blended clips are synchronized on their progress, so that e.g. the steps of a walk and a run stay in phase
+	AnimationClip const& clip(clips[m_clips[handle]]);
+	double progress(clip.duration() > 0.f ? (time * m_speeds[handle] + m_phases[handle]) / clip.duration() : 0.);
+	progress -= std::floor(progress);
+	sample(clip, static_cast<float>(progress), floats, pose.data());
+	if (m_blend_weights[handle] > 0.f) {
+		blended.resize(floats);
+		sample(clips[m_blend_clips[handle]], static_cast<float>(progress), floats, blended.data());
+		blend(pose.data(), blended.data(), m_blend_weights[handle], stride, pose.data());
+	}
+	normalizeRotations(pose.data(), stride);
+	composeLocals(pose.data(), stride, locals.data());
+
+	for (size_t joint = 0; joint < skeleton.jointCount(); joint++) {
+		const int parent(skeleton.parents[joint]);
+		globals[joint] = (parent < 0 ? skeleton.root_inverse : globals[static_cast<size_t>(parent)]) * locals[joint];
+	}
+
+	// Rows of the affine matrix, the last one is implied
+	for (size_t bone = 0; bone < skeleton.bone_joints.size(); bone++) {
+		const glm::mat4 skinning(globals[skeleton.bone_joints[bone]] * skeleton.inverse_binds[bone]);
+		for (int row = 0; row < 3; row++)
+			palette[bone * 3 + static_cast<size_t>(row)] = glm::vec4(skinning[0][row], skinning[1][row], skinning[2][row], skinning[3][row]);
+	}
+}
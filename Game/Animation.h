@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+class Model;
+
+
+constexpr size_t MAX_SKELETON_BONES = 256; // bone indices are stored as bytes in the vertices
+
+// Joint hierarchy of a rigged model, parents always come before their children
+struct Skeleton {
+	std::vector<std::string> names;
+	std::vector<int> parents; // -1 for the roots
+	std::vector<glm::vec3> bind_translations; // local transform of the joints, used where a clip has no channel
+	std::vector<glm::quat> bind_rotations;
+	std::vector<glm::vec3> bind_scales;
+	glm::mat4 root_inverse; // the skinned vertices end up in model space, not under the scene's root node
+
+	// Joints deforming the meshes, in the order of the skinning palette
+	std::vector<size_t> bone_joints;
+	std::vector<glm::mat4> inverse_binds; // mesh space to bone space
+
+	size_t jointCount() const;
+	size_t paddedJointCount() const; // rounded up to the widest SIMD batch
+	int find(std::string const& name) const;
+	size_t addJoint(std::string const& name, int const& parent, glm::mat4 const& local);
+	// Index of the joint's bone, MAX_SKELETON_BONES without adding it once the palette is full
+	size_t addBone(size_t const& joint, glm::mat4 const& inverse_bind);
+};
+
+
+// Clip resampled at a fixed rate when loaded, so that sampling it is the same blend of two frames for every joint.
+// A frame holds the local translation, rotation and scale of every joint as s_tracks arrays of paddedJointCount() floats.
+class AnimationClip
+{
+public:
+	static constexpr float s_frame_rate = 30.f;
+	static constexpr size_t s_tracks = 10; // translation xyz, rotation xyzw, scale xyz
+
+	AnimationClip(std::string const& name, Skeleton const& skeleton, float const& duration);
+
+	// Frames of a joint must be set in order, each rotation is flipped to the hemisphere of the previous one
+	void setKey(size_t const& frame, size_t const& joint, glm::vec3 const& translation, glm::quat const& rotation, glm::vec3 const& scale);
+
+	std::string const& name() const;
+	float duration() const; // seconds
+	size_t frameCount() const; // at least 2, the last one at the end of the clip
+	float frameTime(size_t const& index) const; // seconds
+	float const* frame(size_t const& index) const;
+
+private:
+	std::string m_name;
+	float m_duration;
+	size_t m_frame_count;
+	size_t m_stride; // paddedJointCount() of the skeleton
+	std::vector<float> m_frames;
+};
+
+
+// Playback state of every animated instance stored as structure of arrays. Poses are evaluated per instance, the joints
+// being processed 8 at a time with AVX (4 with SSE), and instances are independent so any range can be posed on a worker.
+class AnimationSystem
+{
+public:
+	AnimationSystem();
+
+	// clip indexes model.animations(), phase is a time offset in seconds so that instances don't all move in step
+	size_t create(size_t const& object, Model const& model, size_t const& clip, float const& speed, float const& phase);
+	// Same for a skeleton and clips not loaded with a model (e.g. built in code), clip indexes clips
+	size_t create(size_t const& object, Skeleton const& skeleton, std::vector<AnimationClip> const& clips, size_t const& clip, float const& speed, float const& phase);
+	// Crossfades the instance's clip with another one, weight 0 plays the first clip only
+	void setBlend(size_t const& handle, size_t const& clip, float const& weight);
+
+	size_t size() const;
+	size_t object(size_t const& handle) const;
+	size_t boneCount(size_t const& handle) const;
+
+	// Writes the skinning palette of the instance at time (seconds): for every bone, the 3 rows of its affine matrix
+	void evaluate(size_t const& handle, double const& time, glm::vec4* palette) const;
+
+private:
+	std::vector<Skeleton const*> m_skeletons;
+	std::vector<std::vector<AnimationClip> const*> m_animations;
+	std::vector<size_t> m_objects;
+	std::vector<size_t> m_clips, m_blend_clips;
+	std::vector<float> m_blend_weights;
+	std::vector<float> m_speeds, m_phases;
+};
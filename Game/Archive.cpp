@@ -0,0 +1,331 @@
+#include "Archive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "FileSystem.h"
+#include "Lz4.h"
+
+
+constexpr char Archive::s_magic[4];
+constexpr size_t Archive::s_alignment;
+
+namespace
+{
+	// Appends the paths of the files under directory + relative, relative to directory
+	void listFiles(std::string const& directory, std::string const& relative, std::vector<std::string>& files)
+	{
+#ifdef _WIN32
+		WIN32_FIND_DATAA found;
+		HANDLE const search(FindFirstFileA((directory + relative + "/*").c_str(), &found));
+		if (search == INVALID_HANDLE_VALUE)
+			return;
+
+		do {
+			const std::string name(found.cFileName);
+			if (name == "." || name == "..")
+				continue;
+			if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				listFiles(directory, relative + "/" + name, files);
+			else
+				files.push_back(relative + "/" + name);
+		} while (FindNextFileA(search, &found));
+		FindClose(search);
+#else
+		DIR* const dir(opendir((directory + relative).c_str()));
+		if (!dir)
+			return;
+
+		while (dirent const* const found = readdir(dir)) {
+			const std::string name(found->d_name);
+			if (name == "." || name == "..")
+				continue;
+
+			struct stat file_status;
+			if (stat((directory + relative + "/" + name).c_str(), &file_status) != 0)
+				continue;
+			if (S_ISDIR(file_status.st_mode))
+				listFiles(directory, relative + "/" + name, files);
+			else if (S_ISREG(file_status.st_mode))
+				files.push_back(relative + "/" + name);
+		}
+		closedir(dir);
+#endif
+	}
+
+	void pad(std::ofstream& output, size_t const& alignment)
+	{
+		static const char zeros[64] = {};
+		const size_t position(static_cast<size_t>(output.tellp()));
+		output.write(zeros, static_cast<std::streamsize>((alignment - position % alignment) % alignment));
+	}
+}
+
+
+Archive::Archive() : m_data(nullptr), m_size(0), m_entries(nullptr), m_entry_count(0), m_paths(nullptr)
+{
+}
+
+Archive::~Archive()
+{
+	close();
+}
+
+
+// The file and mapping handles can be closed right away, the view keeps the mapping alive
+bool Archive::open(std::string const& file)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE const handle(CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr));
+	if (handle == INVALID_HANDLE_VALUE) {
+		std::cerr << "Error: archive \"" << file << "\" could not be opened." << std::endl;
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	HANDLE const mapping(GetFileSizeEx(handle, &size) && size.QuadPart > 0 ? CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr);
+	void* const view(mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr);
+	if (mapping)
+		CloseHandle(mapping);
+	CloseHandle(handle);
+	if (!view) {
+		std::cerr << "Error: archive \"" << file << "\" could not be mapped." << std::endl;
+		return false;
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+#else
+	const int descriptor(::open(file.c_str(), O_RDONLY | O_CLOEXEC));
+	if (descriptor < 0) {
+		std::cerr << "Error: archive \"" << file << "\" could not be opened." << std::endl;
+		return false;
+	}
+
+	struct stat file_status;
+	void* view(MAP_FAILED);
+	if (fstat(descriptor, &file_status) == 0 && file_status.st_size > 0)
+		view = mmap(nullptr, static_cast<size_t>(file_status.st_size), PROT_READ, MAP_SHARED, descriptor, 0);
+	::close(descriptor);
+	if (view == MAP_FAILED) {
+		std::cerr << "Error: archive \"" << file << "\" could not be mapped." << std::endl;
+		return false;
+	}
+	m_size = static_cast<size_t>(file_status.st_size);
+#endif
+	m_data = static_cast<unsigned char const*>(view);
+
+	if (!validate()) {
+		std::cerr << "Error: \"" << file << "\" is not a valid archive." << std::endl;
+		close();
+		return false;
+	}
+
+	Header header;
+	std::memcpy(&header, m_data, sizeof(header));
+	m_entries = reinterpret_cast<Entry const*>(m_data + header.entries_offset);
+	m_entry_count = header.entry_count;
+	m_paths = reinterpret_cast<char const*>(m_data + header.paths_offset);
+	return true;
+}
+
+bool Archive::contains(std::string const& path) const
+{
+	return find(path) != nullptr;
+}
+
+FileData Archive::read(std::string const& path) const
+{
+	Entry const* const entry(find(path));
+	if (!entry)
+		return FileData();
+
+	if (entry->compression == s_stored)
+		return FileData(m_data + entry->offset, static_cast<size_t>(entry->size));
+
+	std::vector<unsigned char> contents(static_cast<size_t>(entry->size));
+	if (!Lz4::decompress(m_data + entry->offset, static_cast<size_t>(entry->stored_size), contents.data(), contents.size())) {
+		std::cerr << "Error: archive entry \"" << path << "\" is corrupted." << std::endl;
+		return FileData();
+	}
+	return FileData(std::move(contents));
+}
+
+size_t Archive::entryCount() const
+{
+	return m_entry_count;
+}
+
+
+bool Archive::pack(std::string const& directory, std::vector<std::string> const& subdirectories, std::string const& output_file, bool const& compress)
+{
+	std::vector<std::string> files;
+	for (std::string const& subdirectory : subdirectories)
+		listFiles(directory, subdirectory, files);
+	std::sort(files.begin(), files.end());
+	if (files.empty()) {
+		std::cerr << "Error: no file to pack in \"" << directory << "\"." << std::endl;
+		return false;
+	}
+
+	std::ofstream output(output_file, std::ios::binary | std::ios::trunc);
+	if (!output) {
+		std::cerr << "Error: could not open \"" << output_file << "\" to write the archive." << std::endl;
+		return false;
+	}
+
+	Header header{};
+	output.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+	std::vector<Entry> entries;
+	std::string paths;
+	std::vector<unsigned char> compressed;
+	uint64_t total_size(0), stored_size(0);
+	for (std::string const& file : files) {
+		FileData const contents(FileSystem::read(directory + file));
+		if (!contents.valid()) {
+			std::cerr << "Error: \"" << directory + file << "\" could not be read, it is not packed." << std::endl;
+			continue;
+		}
+
+		const std::string path(FileSystem::normalize(file));
+		Entry entry{ hash(path), 0, contents.size(), contents.size(), static_cast<uint32_t>(paths.size()), static_cast<uint32_t>(path.size()), s_stored, 0 };
+		paths += path;
+
+		unsigned char const* data(contents.data());
+		if (compress && contents.size() > 0) {
+			compressed.resize(Lz4::bound(contents.size()));
+			const size_t compressed_size(Lz4::compress(contents.data(), contents.size(), compressed.data()));
+			if (compressed_size <= contents.size() - contents.size() / 8) {
+				entry.compression = s_lz4;
+				entry.stored_size = compressed_size;
+				data = compressed.data();
+			}
+		}
+
+		pad(output, s_alignment);
+		entry.offset = static_cast<uint64_t>(output.tellp());
+		output.write(reinterpret_cast<char const*>(data), static_cast<std::streamsize>(entry.stored_size));
+		entries.push_back(entry);
+		total_size += entry.size;
+		stored_size += entry.stored_size;
+	}
+
+	// Equal hashes are ordered by path so that packing the same files always gives the same archive
+	std::sort(entries.begin(), entries.end(), [&paths](Entry const& a, Entry const& b) {
+		if (a.hash != b.hash)
+			return a.hash < b.hash;
+		return paths.compare(a.path_offset, a.path_length, paths, b.path_offset, b.path_length) < 0;
+	});
+
+	pad(output, alignof(Entry));
+	std::memcpy(header.magic, s_magic, sizeof(s_magic));
+	header.version = s_version;
+	header.entry_count = static_cast<uint32_t>(entries.size());
+	header.entries_offset = static_cast<uint64_t>(output.tellp());
+	output.write(reinterpret_cast<char const*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+	header.paths_offset = static_cast<uint64_t>(output.tellp());
+	header.paths_size = paths.size();
+	output.write(paths.data(), static_cast<std::streamsize>(paths.size()));
+
+	output.seekp(0);
+	output.write(reinterpret_cast<char const*>(&header), sizeof(header));
+	output.close();
+	if (!output) {
+		std::cerr << "Error: could not write the archive \"" << output_file << "\"." << std::endl;
+		return false;
+	}
+
+	std::cout << "Packed " << entries.size() << " files into \"" << output_file << "\": " << total_size / 1024 << " KB stored as " << stored_size / 1024 << " KB." << std::endl;
+	return true;
+}
+
+
+// FNV-1a
+uint64_t Archive::hash(std::string const& path)
+{
+	uint64_t value(14695981039346656037ull);
+	for (char const& character : path) {
+		value ^= static_cast<unsigned char>(character);
+		value *= 1099511628211ull;
+	}
+	return value;
+}
+
+Archive::Entry const* Archive::find(std::string const& path) const
+{
+	const uint64_t path_hash(hash(path));
+	Entry const* entry(std::lower_bound(m_entries, m_entries + m_entry_count, path_hash, [](Entry const& a, uint64_t const& value) { return a.hash < value; }));
+	for (; entry != m_entries + m_entry_count && entry->hash == path_hash; entry++)
+		if (path.compare(0, std::string::npos, m_paths + entry->path_offset, entry->path_length) == 0)
+			return entry;
+
+	return nullptr;
+}
+
+// Every offset and size is checked once, reads then trust the table
+bool Archive::validate() const
+{
+	if (m_size < sizeof(Header))
+		return false;
+
+	Header header;
+	std::memcpy(&header, m_data, sizeof(header));
+	if (std::memcmp(header.magic, s_magic, sizeof(s_magic)) != 0 || header.version != s_version)
+		return false;
+	if (header.entries_offset % alignof(Entry) != 0 || header.entries_offset > m_size
+		|| static_cast<uint64_t>(header.entry_count) > (m_size - header.entries_offset) / sizeof(Entry))
+		return false;
+	if (header.paths_offset > m_size || header.paths_size > m_size - header.paths_offset)
+		return false;
+
+	Entry const* const entries(reinterpret_cast<Entry const*>(m_data + header.entries_offset));
+	for (uint32_t i = 0; i < header.entry_count; i++) {
+		Entry const& entry(entries[i]);
+		if (entry.offset > m_size || entry.stored_size > m_size - entry.offset)
+			return false;
+		if (static_cast<uint64_t>(entry.path_offset) + entry.path_length > header.paths_size)
+			return false;
+		if (entry.compression == s_stored ? entry.stored_size != entry.size : entry.compression != s_lz4)
+			return false;
+		// Otherwise a corrupted size would have read() allocate whatever it says
+		if (entry.compression == s_lz4 && entry.size > entry.stored_size * Lz4::MAX_EXPANSION)
+			return false;
+		if (i > 0 && entries[i - 1].hash > entry.hash)
+			return false;
+	}
+
+	return true;
+}
+
+void Archive::close()
+{
+	if (m_data) {
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+#else
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_entries = nullptr;
+	m_entry_count = 0;
+	m_paths = nullptr;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class FileData;
+
+
+// Packed assets: a header, the file contents each aligned to s_alignment, the table of entries sorted by path hash,
+// then the paths. Entries are stored as is, or LZ4 compressed when that saves at least an eighth of their size.
+// The whole archive is mapped read only, stored entries are read in place without any copy.
+class Archive
+{
+public:
+	Archive();
+	~Archive();
+
+	Archive(Archive const&) = delete;
+	Archive& operator=(Archive const&) = delete;
+
+	bool open(std::string const& file);
+
+	// Paths are normalized and relative to the packed directory
+	bool contains(std::string const& path) const;
+	FileData read(std::string const& path) const;
+
+	size_t entryCount() const;
+
+	// Packs every file under the given subdirectories of directory
+	static bool pack(std::string const& directory, std::vector<std::string> const& subdirectories, std::string const& output_file, bool const& compress);
+
+private:
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		uint32_t entry_count;
+		uint32_t reserved;
+		uint64_t entries_offset;
+		uint64_t paths_offset;
+		uint64_t paths_size;
+	};
+
+	struct Entry {
+		uint64_t hash;
+		uint64_t offset;
+		uint64_t size;
+		uint64_t stored_size;
+		uint32_t path_offset;
+		uint32_t path_length;
+		uint32_t compression;
+		uint32_t reserved;
+	};
+
+	static constexpr char s_magic[4] = { 'G', 'P', 'A', 'K' };
+	static constexpr uint32_t s_version = 1;
+	static constexpr uint32_t s_stored = 0, s_lz4 = 1;
+	static constexpr size_t s_alignment = 64;
+
+	static uint64_t hash(std::string const& path);
+
+	Entry const* find(std::string const& path) const;
+	bool validate() const;
+	void close();
+
+	unsigned char const* m_data; // the mapped file
+	size_t m_size;
+	Entry const* m_entries;
+	uint32_t m_entry_count;
+	char const* m_paths;
+};
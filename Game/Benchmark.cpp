@@ -0,0 +1,331 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <GL/glew.h>
+#include <SDL.h>
+
+#include "Animation.h"
+#include "GLHandle.h"
+#include "MatrixBatch.h"
+#include "Profiler.h"
+#include "TransformSystem.h"
+
+
+namespace
+{
+	// Nearest-rank percentile of sorted values
+	double percentile(std::vector<double> const& sorted_values, double const& rank)
+	{
+		if (sorted_values.empty())
+			return 0.0;
+
+		const size_t index(static_cast<size_t>(std::ceil(rank / 100.0 * static_cast<double>(sorted_values.size()))));
+		return sorted_values[std::min(sorted_values.size() - 1, index > 0 ? index - 1 : 0)];
+	}
+
+	// Median duration of a run in milliseconds, the fastest and slowest runs being mostly cache and scheduling noise
+	template <typename Function>
+	double measure(Function const& function)
+	{
+		std::vector<double> durations;
+		for (int run = 0; run < 21; run++) {
+			const Uint64 start(SDL_GetPerformanceCounter());
+			function();
+			durations.push_back(static_cast<double>(SDL_GetPerformanceCounter() - start) * 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency()));
+		}
+
+		std::sort(durations.begin(), durations.end());
+		return percentile(durations, 50.0);
+	}
+}
+
+
+Benchmark::Benchmark(unsigned int const& frames, std::string const& output_file, bool const& require_no_allocations) : m_frames(frames),
+	m_warmup_frames(std::min(30u, frames / 10)), m_frame(0), m_output_file(output_file), m_require_no_allocations(require_no_allocations), m_leaked_objects(0),
+	m_frame_times(), m_gpu_ms(0.0), m_gpu_frames(0), m_draw_calls(0), m_triangles(0), m_state_changes(0), m_allocations(0), m_allocating_frames(0), m_texture_bytes(0), m_opaque_fragments(0), m_opaque_pixels(0), m_posed_instances(0), m_pose_cpu_ms(0.0), m_passes()
+{
+	m_frame_times.reserve(frames);
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+
+bool Benchmark::running() const
+{
+	return m_frame <= m_frames + m_warmup_frames;
+}
+
+// Called at the start of each frame, once the profiler holds the previous frame's data
+void Benchmark::nextFrame(double const& frame_time)
+{
+	// The first call has no previous frame to measure
+	if (m_frame++ <= m_warmup_frames)
+		return;
+
+	m_frame_times.push_back(frame_time * 1000.0);
+
+	FrameCounters const& counters(Profiler::counters());
+	if (counters.gpu_complete) {
+		m_gpu_ms += counters.gpu_ms;
+		m_gpu_frames++;
+	}
+	m_draw_calls += counters.draw_calls;
+	m_triangles += counters.triangles;
+	m_state_changes += counters.state_changes;
+	m_allocations += counters.allocations;
+	if (counters.allocations > 0)
+		m_allocating_frames++;
+	m_texture_bytes += counters.texture_bytes;
+	m_opaque_fragments += counters.opaque_fragments;
+	m_opaque_pixels += counters.opaque_pixels;
+	m_posed_instances += counters.posed_instances;
+	m_pose_cpu_ms += counters.pose_cpu_ms;
+
+	for (Profiler::PassTiming const& timing : Profiler::passes()) {
+		auto it = std::find_if(m_passes.begin(), m_passes.end(), [&timing](PassSamples const& samples) { return samples.name == timing.name; });
+		if (it == m_passes.end())
+			it = m_passes.insert(m_passes.end(), { timing.name, 0.0, 0.0, 0, 0 });
+
+		// Timings that weren't ready still hold an older frame's, counting them would weigh that frame twice
+		it->cpu_ms += timing.cpu_ms;
+		if (timing.gpu_fresh) {
+			it->gpu_ms += timing.gpu_ms;
+			it->gpu_samples++;
+		}
+		it->draw_calls += timing.draw_calls;
+	}
+}
+
+
+// Orbit around the scene while bobbing up and down, one revolution over the whole run
+glm::vec3 Benchmark::cameraPosition() const
+{
+	const float progress(static_cast<float>(m_frame) / static_cast<float>(std::max(1u, m_frames + m_warmup_frames)));
+	const float angle(progress * 2.f * 3.14159265f);
+
+	return cameraTarget() + glm::vec3(9.f * std::sin(angle), 2.f + 2.f * std::sin(2.f * angle), 9.f * std::cos(angle));
+}
+
+glm::vec3 Benchmark::cameraTarget() const
+{
+	return glm::vec3(0.f, -3.f, -4.f);
+}
+
+
+bool Benchmark::writeReport(unsigned int const& width, unsigned int const& height) const
+{
+	std::ofstream file(m_output_file);
+	if (!file) {
+		std::cerr << "Error: could not open \"" << m_output_file << "\" to write the benchmark report." << std::endl;
+		return false;
+	}
+
+	std::vector<double> sorted(m_frame_times);
+	std::sort(sorted.begin(), sorted.end());
+
+	const double frames(static_cast<double>(std::max<size_t>(1, m_frame_times.size())));
+	double total(0.0);
+	for (double const& frame_time : m_frame_times)
+		total += frame_time;
+
+	const GLubyte* renderer(glGetString(GL_RENDERER));
+	const GLubyte* version(glGetString(GL_VERSION));
+
+	file << "{" << std::endl
+		<< "\t\"renderer\": \"" << (renderer ? reinterpret_cast<const char*>(renderer) : "unknown") << "\"," << std::endl
+		<< "\t\"version\": \"" << (version ? reinterpret_cast<const char*>(version) : "unknown") << "\"," << std::endl
+		<< "\t\"width\": " << width << "," << std::endl
+		<< "\t\"height\": " << height << "," << std::endl
+		<< "\t\"frames\": " << m_frame_times.size() << "," << std::endl
+		<< "\t\"frame_time_ms\": {" << std::endl
+		<< "\t\t\"mean\": " << total / frames << "," << std::endl
+		<< "\t\t\"min\": " << (sorted.empty() ? 0.0 : sorted.front()) << "," << std::endl
+		<< "\t\t\"p50\": " << percentile(sorted, 50.0) << "," << std::endl
+		<< "\t\t\"p90\": " << percentile(sorted, 90.0) << "," << std::endl
+		<< "\t\t\"p95\": " << percentile(sorted, 95.0) << "," << std::endl
+		<< "\t\t\"p99\": " << percentile(sorted, 99.0) << "," << std::endl
+		<< "\t\t\"max\": " << (sorted.empty() ? 0.0 : sorted.back()) << std::endl
+		<< "\t}," << std::endl
+		<< "\t\"draw_calls\": " << static_cast<double>(m_draw_calls) / frames << "," << std::endl
+		<< "\t\"triangles\": " << static_cast<double>(m_triangles) / frames << "," << std::endl
+		<< "\t\"state_changes\": " << static_cast<double>(m_state_changes) / frames << "," << std::endl
+		<< "\t\"gpu_time_ms\": " << (m_gpu_frames > 0 ? m_gpu_ms / m_gpu_frames : 0.0) << "," << std::endl
+		<< "\t\"gpu_complete_frames\": " << m_gpu_frames << "," << std::endl
+		<< "\t\"heap_allocations\": " << static_cast<double>(m_allocations) / frames << "," << std::endl
+		<< "\t\"allocating_frames\": " << m_allocating_frames << "," << std::endl
+		<< "\t\"leaked_gl_objects\": " << m_leaked_objects << "," << std::endl
+		<< "\t\"texture_memory_mb\": " << static_cast<double>(m_texture_bytes) / frames / (1024.0 * 1024.0) << "," << std::endl
+		<< "\t\"opaque_fragments\": " << static_cast<double>(m_opaque_fragments) / frames << "," << std::endl
+		<< "\t\"opaque_overdraw\": " << (m_opaque_pixels > 0 ? static_cast<double>(m_opaque_fragments) / static_cast<double>(m_opaque_pixels) : 0.0) << "," << std::endl
+		<< "\t\"fragment_count_source\": \"" << Profiler::fragmentCountSource() << "\"," << std::endl
+		<< "\t\"animated_instances\": " << static_cast<double>(m_posed_instances) / frames << "," << std::endl
+		<< "\t\"pose_cpu_ms\": " << m_pose_cpu_ms / frames << "," << std::endl
+		<< "\t\"passes\": [";
+
+	for (size_t i = 0; i < m_passes.size(); i++) {
+		file << (i ? "," : "") << std::endl
+			<< "\t\t{ \"name\": \"" << m_passes[i].name << "\", \"cpu_ms\": " << m_passes[i].cpu_ms / frames
+			<< ", \"gpu_ms\": " << (m_passes[i].gpu_samples > 0 ? m_passes[i].gpu_ms / m_passes[i].gpu_samples : 0.0) << ", \"gpu_samples\": " << m_passes[i].gpu_samples
+			<< ", \"draw_calls\": " << static_cast<double>(m_passes[i].draw_calls) / frames << " }";
+	}
+	file << std::endl << "\t]" << std::endl << "}" << std::endl;
+
+	std::cout << "Benchmark: " << m_frame_times.size() << " frames, mean " << total / frames << " ms, p99 " << percentile(sorted, 99.0)
+		<< " ms. Report written to \"" << m_output_file << "\"." << std::endl;
+	if (m_require_no_allocations && m_allocating_frames > 0)
+		std::cerr << "Error: " << m_allocating_frames << " measured frame(s) allocated on the heap (" << m_allocations << " allocations)." << std::endl;
+
+	return true;
+}
+
+bool Benchmark::passed() const
+{
+	return (!m_require_no_allocations || m_allocating_frames == 0) && m_leaked_objects == 0;
+}
+
+// Checked after every cycle so that a leak is reported once per type and cycle, a later cycle can't hide it by deleting more
+bool Benchmark::checkObjectLifetimes(const char* name, unsigned int const& cycles, std::function<void()> const& cycle)
+{
+	std::array<long, GL_OBJECT_TYPE_COUNT> baseline;
+	for (int type = 0; type < GL_OBJECT_TYPE_COUNT; type++)
+		baseline[type] = GLObjects::live(static_cast<GLObjectType>(type));
+
+	bool clean(true);
+	for (unsigned int i = 0; i < cycles; i++) {
+		cycle();
+
+		for (int type = 0; type < GL_OBJECT_TYPE_COUNT; type++) {
+			const long difference(GLObjects::live(static_cast<GLObjectType>(type)) - baseline[type]);
+			if (difference == 0)
+				continue;
+
+			std::cerr << "Error: " << name << " cycle " << i + 1 << " left " << difference << " GL " << GLObjects::name(static_cast<GLObjectType>(type)) << " alive." << std::endl;
+			m_leaked_objects += std::abs(difference);
+			baseline[type] += difference;
+			clean = false;
+		}
+	}
+
+	std::cout << "Lifetimes: " << cycles << " " << name << " load/unload cycles " << (clean ? "left no GL object behind." : "leaked GL objects.") << std::endl;
+	return clean;
+}
+
+
+// Compares the batched TransformSystem against composing every matrix one at a time with glm, printed to the standard output
+void Benchmark::transforms(size_t const& count)
+{
+	std::vector<glm::vec3> positions, scales;
+	std::vector<glm::quat> rotations;
+	TransformSystem system;
+
+	// Deterministic spread of objects, the values don't matter much as long as nothing is trivially constant
+	for (size_t i = 0; i < count; i++) {
+		const float t(static_cast<float>(i));
+		positions.push_back(glm::vec3(std::sin(t) * 100.f, std::cos(t * 0.7f) * 100.f, t * 0.01f));
+		rotations.push_back(glm::angleAxis(t * 0.1f, glm::normalize(glm::vec3(std::sin(t), 1.f, std::cos(t)))));
+		scales.push_back(glm::vec3(1.f + std::fmod(t, 3.f)));
+		system.create(positions.back(), rotations.back(), scales.back());
+	}
+
+	const glm::mat4 view_projection(glm::perspective(glm::radians(70.f), 16.f / 9.f, 0.1f, 100.f)
+		* glm::lookAt(glm::vec3(0.f, 0.f, 3.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f)));
+	std::vector<glm::mat4> worlds(count), model_view_projs(count);
+
+	const double scalar_world(measure([&]() {
+		for (size_t i = 0; i < count; i++)
+			worlds[i] = TransformSystem::compose(positions[i], rotations[i], scales[i]);
+	}));
+	const double scalar_mvp(measure([&]() {
+		for (size_t i = 0; i < count; i++)
+			model_view_projs[i] = view_projection * worlds[i];
+	}));
+
+	const double batched_world(measure([&]() {
+		for (size_t i = 0; i < count; i++)
+			system.setPosition(i, positions[i]);
+		system.update();
+	}));
+	const double batched_static(measure([&]() { system.update(); }));
+	const double batched_mvp(measure([&]() { system.modelViewProj(view_projection, 0, count, model_view_projs.data()); }));
+
+	std::cout << "Transforms: " << count << " objects, median of 21 runs" << std::endl
+		<< "  world matrices, glm:          " << scalar_world << " ms" << std::endl
+		<< "  world matrices, batched:      " << batched_world << " ms (all dirty, setters included)" << std::endl
+		<< "  world matrices, batched:      " << batched_static << " ms (static)" << std::endl
+		<< "  model view projection, glm:   " << scalar_mvp << " ms" << std::endl
+		<< "  model view projection, batch: " << batched_mvp << " ms" << std::endl;
+}
+
+// Poses instances of a synthetic humanoid skeleton the way the scene's animated grid does (own speed and phase, two clips
+// crossfaded), on the calling thread only, and prints the CPU cost per frame to the standard output
+void Benchmark::animation(size_t const& instances)
+{
+	// Hips, spine, neck and head, then for each side an arm with five three-joint fingers and a leg
+	Skeleton skeleton;
+	skeleton.root_inverse = glm::mat4(1.f);
+	const auto add_chain = [&skeleton](std::string const& name, int parent, size_t const& length, glm::vec3 const& offset) {
+		for (size_t i = 0; i < length; i++)
+			parent = static_cast<int>(skeleton.addJoint(name + std::to_string(i), parent, glm::translate(glm::mat4(1.f), offset)));
+		return parent;
+	};
+	const int spine(add_chain("spine", -1, 4, glm::vec3(0.f, .15f, 0.f)));
+	add_chain("head", spine, 2, glm::vec3(0.f, .1f, 0.f));
+	for (float const side : { -1.f, 1.f }) {
+		const int hand(add_chain("arm", spine, 4, glm::vec3(side * .15f, 0.f, 0.f)));
+		for (int finger = 0; finger < 5; finger++)
+			add_chain("finger" + std::to_string(finger), hand, 3, glm::vec3(side * .03f, 0.f, .01f * static_cast<float>(finger - 2)));
+		add_chain("leg", 0, 4, glm::vec3(side * .05f, -.2f, 0.f));
+	}
+
+	// Every joint deforms the mesh, with its inverse bind pose
+	std::vector<glm::mat4> binds(skeleton.jointCount());
+	for (size_t joint = 0; joint < skeleton.jointCount(); joint++) {
+		const int parent(skeleton.parents[joint]);
+		binds[joint] = (parent < 0 ? glm::mat4(1.f) : binds[static_cast<size_t>(parent)]) * glm::translate(glm::mat4(1.f), skeleton.bind_translations[joint]);
+		skeleton.addBone(joint, glm::inverse(binds[joint]));
+	}
+
+	// Two cyclic clips of different lengths swinging every joint around its own axis
+	std::vector<AnimationClip> clips;
+	for (float const duration : { 1.f, .7f }) {
+		clips.emplace_back(duration < 1.f ? "run" : "walk", skeleton, duration);
+		AnimationClip& clip(clips.back());
+		for (size_t frame = 0; frame < clip.frameCount(); frame++)
+			for (size_t joint = 0; joint < skeleton.jointCount(); joint++) {
+				const float angle(.4f * std::sin(2.f * 3.14159265f * clip.frameTime(frame) / duration + .3f * static_cast<float>(joint)));
+				const glm::vec3 axis(joint % 2 ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 0.f, 1.f));
+				clip.setKey(frame, joint, skeleton.bind_translations[joint], glm::angleAxis(angle, axis), glm::vec3(1.f));
+			}
+	}
+
+	AnimationSystem system;
+	for (size_t i = 0; i < instances; i++) {
+		const size_t handle(system.create(i, skeleton, clips, i % clips.size(), .8f + .05f * static_cast<float>(i % 9), .37f * static_cast<float>(i)));
+		system.setBlend(handle, (i + 1) % clips.size(), .2f * static_cast<float>(i % 5));
+	}
+
+	const size_t bones(skeleton.bone_joints.size());
+	std::vector<glm::vec4> palettes(instances * bones * 3);
+	double time(0.0);
+	const double pose(measure([&]() {
+		for (size_t i = 0; i < instances; i++)
+			system.evaluate(i, time, &palettes[i * bones * 3]);
+		time += 1.0 / 60.0;
+	}));
+
+	std::cout << "Animation: " << instances << " instances of a " << skeleton.jointCount() << " joint skeleton, " << clips.size() << " clips crossfaded, one thread, median of 21 runs" << std::endl
+		<< "  posing, per frame:    " << pose << " ms" << std::endl
+		<< "  posing, per instance: " << (instances > 0 ? pose * 1000.0 / static_cast<double>(instances) : 0.0) << " us" << std::endl
+		<< "  palettes, per frame:  " << static_cast<double>(palettes.size() * sizeof(glm::vec4)) / 1024.0 << " KB" << std::endl;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+
+// Drives the camera along a scripted path for a fixed number of frames and reports timings as JSON.
+// The path only depends on the frame index so that runs are reproducible.
+class Benchmark
+{
+public:
+	Benchmark(unsigned int const& frames, std::string const& output_file, bool const& require_no_allocations = false);
+	~Benchmark();
+
+	bool running() const;
+	void nextFrame(double const& frame_time);
+
+	glm::vec3 cameraPosition() const;
+	glm::vec3 cameraTarget() const;
+
+	// Runs cycle the given number of times, every GL object it creates must be deleted when it returns or the run fails
+	bool checkObjectLifetimes(const char* name, unsigned int const& cycles, std::function<void()> const& cycle);
+
+	bool writeReport(unsigned int const& width, unsigned int const& height) const;
+	bool passed() const;
+
+	static void transforms(size_t const& count);
+	static void animation(size_t const& instances);
+
+private:
+	struct PassSamples {
+		std::string name;
+		double cpu_ms;
+		double gpu_ms;
+		unsigned int gpu_samples; // frames whose timing was read back, gpu_ms is their sum
+		unsigned long long draw_calls;
+	};
+
+	unsigned int const m_frames;
+	unsigned int const m_warmup_frames; // excluded from the statistics (shader builds, first texture uses...)
+	unsigned int m_frame;
+	std::string const m_output_file;
+	bool const m_require_no_allocations; // fails the run if any measured frame allocated on the heap
+	long m_leaked_objects; // left alive by the load/unload cycles, always fails the run
+
+	std::vector<double> m_frame_times; // milliseconds
+	double m_gpu_ms;
+	unsigned int m_gpu_frames; // frames whose every pass timing was read back, m_gpu_ms is their sum
+	unsigned long long m_draw_calls;
+	unsigned long long m_triangles;
+	unsigned long long m_state_changes;
+	unsigned long long m_allocations;
+	unsigned int m_allocating_frames;
+	unsigned long long m_texture_bytes;
+	unsigned long long m_opaque_fragments;
+	unsigned long long m_opaque_pixels;
+	unsigned long long m_posed_instances;
+	double m_pose_cpu_ms;
+	std::vector<PassSamples> m_passes; // accumulated over the measured frames
+};
@@ -0,0 +1,116 @@
+#include "Bloom.h"
+
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+
+Bloom::Bloom(unsigned int const& levels, float const& threshold, float const& intensity, std::string const& shaders_directory) :
+	m_levels(std::max(levels, 1u)), m_threshold(threshold), m_intensity(intensity), m_pyramid(), m_sizes(),
+	m_downsample_shader(shaders_directory + "fullscreen.vert", shaders_directory + "bloom_downsample.frag"),
+	m_upsample_shader(shaders_directory + "fullscreen.vert", shaders_directory + "bloom_upsample.frag"),
+	m_composite_shader(shaders_directory + "fullscreen.vert", shaders_directory + "bloom_upsample.frag", "#define COMPOSITE\n")
+{
+}
+
+Bloom::~Bloom()
+{
+}
+
+
+RenderTarget const& Bloom::render(PostProcessChain& chain, RenderTarget const& input)
+{
+	RenderTargetPool& pool(chain.pool());
+	const glm::ivec2 render_size(static_cast<int>(chain.renderWidth()), static_cast<int>(chain.renderHeight()));
+
+	// Down the pyramid, the first level keeping only what's above the threshold. R11G11B10 halves the memory of RGBA16F.
+	m_pyramid.clear();
+	m_sizes.clear();
+	m_downsample_shader.use();
+	m_downsample_shader.setUni("source", 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	RenderTarget const* source(&input);
+	glm::ivec2 source_size(render_size);
+	for (unsigned int level = 1; level <= m_levels; level++) {
+		RenderTarget const& target(pool.acquire(std::max(chain.width() >> level, 1u), std::max(chain.height() >> level, 1u), GL_R11F_G11F_B10F));
+		const glm::ivec2 size(std::max(render_size.x >> level, 1), std::max(render_size.y >> level, 1));
+
+		glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+		glViewport(0, 0, size.x, size.y);
+		m_downsample_shader.setUni("threshold", level == 1 ? m_threshold : -1.f);
+		setSource(m_downsample_shader, *source, source_size, size);
+		glBindTexture(GL_TEXTURE_2D, source->texture);
+		chain.drawFullscreen();
+
+		m_pyramid.push_back(&target);
+		m_sizes.push_back(size);
+		source = &target;
+		source_size = size;
+	}
+
+	// Back up, every level adding the blurred one below to itself
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	m_upsample_shader.use();
+	m_upsample_shader.setUni("source", 0);
+
+	for (size_t level = m_pyramid.size() - 1; level > 0; level--) {
+		glBindFramebuffer(GL_FRAMEBUFFER, m_pyramid[level - 1]->framebuffer);
+		glViewport(0, 0, m_sizes[level - 1].x, m_sizes[level - 1].y);
+		setSource(m_upsample_shader, *m_pyramid[level], m_sizes[level], m_sizes[level - 1]);
+		glBindTexture(GL_TEXTURE_2D, m_pyramid[level]->texture);
+		chain.drawFullscreen();
+	}
+	glDisable(GL_BLEND);
+
+	// Last upsample, added to the scene into a new target
+	RenderTarget const& output(pool.acquire(chain.width(), chain.height(), GL_RGBA16F));
+	glBindFramebuffer(GL_FRAMEBUFFER, output.framebuffer);
+	glViewport(0, 0, render_size.x, render_size.y);
+
+	m_composite_shader.use();
+	m_composite_shader.setUni("source", 0);
+	m_composite_shader.setUni("scene", 1);
+	m_composite_shader.setUni("intensity", m_intensity);
+	setSource(m_composite_shader, *m_pyramid[0], m_sizes[0], render_size);
+	glBindTexture(GL_TEXTURE_2D, m_pyramid[0]->texture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, input.texture);
+	chain.drawFullscreen();
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	for (RenderTarget const* target : m_pyramid)
+		pool.release(*target);
+
+	return output;
+}
+
+
+// Maps the fragments of a size x size viewport onto the rendered source_size corner of source, clamped to that corner
+void Bloom::setSource(Shader const& shader, RenderTarget const& source, glm::ivec2 const& source_size, glm::ivec2 const& size)
+{
+	const float texel_x(1.f / source.width), texel_y(1.f / source.height);
+
+	shader.setUni("uv_scale", glm::vec2(texel_x * source_size.x / size.x, texel_y * source_size.y / size.y));
+	shader.setUni("uv_min", glm::vec2(texel_x * .5f, texel_y * .5f));
+	shader.setUni("uv_max", glm::vec2(texel_x * (source_size.x - .5f), texel_y * (source_size.y - .5f)));
+}
+
+
+// Exposed for hot reloading
+Shader& Bloom::downsampleShader()
+{
+	return m_downsample_shader;
+}
+
+Shader& Bloom::upsampleShader()
+{
+	return m_upsample_shader;
+}
+
+Shader& Bloom::compositeShader()
+{
+	return m_composite_shader;
+}
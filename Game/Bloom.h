@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+#include "PostProcessChain.h"
+#include "Shader.h"
+
+
+// Downsample / upsample bloom (Jimenez, 2014): the bright parts of the scene are filtered down a pyramid of half size
+// targets, then upsampled back with a tent filter, each level being added to the one above it. The result is added
+// to the scene in the last upsample, which writes the pass output.
+class Bloom
+{
+public:
+	Bloom(unsigned int const& levels, float const& threshold, float const& intensity, std::string const& shaders_directory);
+	~Bloom();
+
+	RenderTarget const& render(PostProcessChain& chain, RenderTarget const& input);
+
+	Shader& downsampleShader();
+	Shader& upsampleShader();
+	Shader& compositeShader();
+
+private:
+	static void setSource(Shader const& shader, RenderTarget const& source, glm::ivec2 const& source_size, glm::ivec2 const& size);
+
+	unsigned int const m_levels;
+	float const m_threshold; // brightness where the bloom starts, with a soft knee below it
+	float const m_intensity;
+
+	std::vector<RenderTarget const*> m_pyramid; // reused every frame
+	std::vector<glm::ivec2> m_sizes; // rendered part of every level
+
+	Shader m_downsample_shader;
+	Shader m_upsample_shader;
+	Shader m_composite_shader;
+};
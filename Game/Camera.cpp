@@ -9,13 +9,13 @@
 #include <iostream>
 
 
-Camera::Camera() : m_yaw(0), m_pitch(0), m_front(0.0f, 0.0f, -1.0f), m_world_up(0, 0, 1), m_right(0.f), m_position(0.f), m_sensitivity(0), m_speed(0)
+Camera::Camera() : m_yaw(0), m_pitch(0), m_front(0.0f, 0.0f, -1.0f), m_world_up(0, 0, 1), m_right(0.f), m_position(0.f), m_previous_position(0.f), m_sensitivity(0), m_speed(0)
 {
 
 }
 
 Camera::Camera(glm::vec3 position, glm::vec3 target, glm::vec3 world_up, float sensitivity, float speed) :
-	m_yaw(0), m_pitch(0), m_front(0.0f, 0.0f, -1.0f), m_right(0.f), m_world_up(world_up), m_position(position), m_sensitivity(sensitivity), m_speed(speed)
+	m_yaw(0), m_pitch(0), m_front(0.0f, 0.0f, -1.0f), m_right(0.f), m_world_up(world_up), m_position(position), m_previous_position(position), m_sensitivity(sensitivity), m_speed(speed)
 {
 	setTarget();
 }
@@ -25,11 +25,11 @@ Camera::~Camera()
 }
 
 
-void Camera::orientate(int const& rel_x, int const& rel_y, float const& delta_time)
+// Mouse counts are already a displacement, they must not be scaled by the frame duration
+void Camera::orientate(int const& rel_x, int const& rel_y)
 {
-	const float sensitivity = m_sensitivity * delta_time;
-	m_pitch += -rel_y * sensitivity;
-	m_yaw += -rel_x * sensitivity;
+	m_pitch += -rel_y * m_sensitivity;
+	m_yaw += -rel_x * m_sensitivity;
 
 	if (m_pitch > 89.0)
 		m_pitch = 89.0;
@@ -60,10 +60,10 @@ void Camera::orientate(int const& rel_x, int const& rel_y, float const& delta_ti
 	}
 }
 
+// Meant to be called at a fixed rate, delta_time being in seconds
 void Camera::shift(Input const& input, std::map<std::string, SDL_Scancode> const& keys, float const& delta_time)
 {
-	if (input.hasMiceMoved())
-		orientate(input.getXRel(), input.getYRel(), delta_time);
+	m_previous_position = m_position;
 
 	const float previous_y_position = m_position.y;
 	const float speed = m_speed * delta_time;
@@ -94,6 +94,13 @@ glm::mat4 Camera::lookAt() const
 	return glm::lookAt(m_position, m_position + m_front, m_world_up);
 }
 
+// View matrix at the interpolated position between the last two shift() calls
+glm::mat4 Camera::lookAt(float const& alpha) const
+{
+	const glm::vec3 position(getPosition(alpha));
+	return glm::lookAt(position, position + m_front, m_world_up);
+}
+
 
 void Camera::setTarget()
 {
@@ -111,9 +118,10 @@ void Camera::setTarget()
 	else if (m_world_up.y == 1.0)
 	{
 		m_pitch = asin(m_front.y);
-		m_yaw = acos(m_front.z / cos(m_pitch));
+		m_yaw = acos(glm::clamp(m_front.z / cos(m_pitch), -1.f, 1.f));
 
-		if (m_front.z < 0)
+		// orientate() gives front.x = cos(pitch) * sin(yaw)
+		if (m_front.x < 0)
 			m_yaw *= -1;
 	}
 	else
@@ -130,10 +138,17 @@ void Camera::setTarget()
 	m_yaw = glm::degrees(m_yaw);
 }
 
+void Camera::setTarget(glm::vec3 const& target)
+{
+	m_front = target - m_position;
+	setTarget();
+}
+
 
 void Camera::setPosition(glm::vec3 const& position)
 {
 	m_position = position;
+	m_previous_position = position;
 }
 
 
@@ -164,6 +179,11 @@ glm::vec3 Camera::getPosition() const
 	return m_position;
 }
 
+glm::vec3 Camera::getPosition(float const& alpha) const
+{
+	return glm::mix(m_previous_position, m_position, alpha);
+}
+
 glm::vec3 Camera::getOrientation() const
 {
 	return m_front;
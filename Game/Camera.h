@@ -17,11 +17,13 @@ public:
 	Camera(glm::vec3 position, glm::vec3 target, glm::vec3 world_up, float sensitivity = 0.85f, float speed = 0.25f);
 	~Camera();
 
-	void orientate(int const& rel_x, int const& rel_y, float const& delta_time);
+	void orientate(int const& rel_x, int const& rel_y);
 	void shift(Input const& input, std::map<std::string, SDL_Scancode> const& keys, float const& delta_time);
 	glm::mat4 lookAt() const;
+	glm::mat4 lookAt(float const& alpha) const;
 
 	void setTarget();
+	void setTarget(glm::vec3 const& target);
 	void setPosition(glm::vec3 const& position);
 
 	float getSensitivity() const;
@@ -31,6 +33,7 @@ public:
 	void setSpeed(float const& speed);
 
 	glm::vec3 getPosition() const;
+	glm::vec3 getPosition(float const& alpha) const;
 	glm::vec3 getOrientation() const;
 
 
@@ -41,10 +44,11 @@ private:
 	const glm::vec3 m_world_up;
 
 	glm::vec3 m_position;
+	glm::vec3 m_previous_position; // before the last shift(), for interpolation
 	glm::vec3 m_front;
 	glm::vec3 m_right;
 	glm::vec3 m_up;
 
-	float m_sensitivity;
-	float m_speed;
+	float m_sensitivity; // degrees per mouse count
+	float m_speed; // units per second
 };
@@ -0,0 +1,179 @@
+#include "CascadedShadowMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Profiler.h"
+
+
+CascadedShadowMap::CascadedShadowMap(unsigned int const& resolution, unsigned int const& cascade_count, float const& shadow_distance, std::string const& shaders_directory) :
+	m_depth(0), m_framebuffers(), m_valid(false),
+	m_resolution(resolution), m_cascade_count(std::min(std::max(cascade_count, 1u), static_cast<unsigned int>(MAX_SHADOW_CASCADES))), m_shadow_distance(shadow_distance),
+	m_drawn(), m_drawn_version(0), m_drawn_valid(false),
+	m_depth_shader(shaders_directory + "basic.vert", shaders_directory + "depth_only.frag", "#define DEPTH_ONLY\n")
+{
+	// Hardware comparison with linear filtering gives 2x2 PCF for every tap of the shader
+	glGenTextures(1, &m_depth);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_depth);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, m_resolution, m_resolution, m_cascade_count, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	m_valid = true;
+	glGenFramebuffers(m_cascade_count, m_framebuffers.data());
+	for (unsigned int cascade = 0; cascade < m_cascade_count; cascade++) {
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[cascade]);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depth, 0, cascade);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		m_valid = m_valid && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	}
+
+	if (!m_valid)
+		std::cerr << "Error: shadow map framebuffers are incomplete." << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+CascadedShadowMap::~CascadedShadowMap()
+{
+	glDeleteFramebuffers(m_cascade_count, m_framebuffers.data());
+	glDeleteTextures(1, &m_depth);
+}
+
+
+bool CascadedShadowMap::valid() const
+{
+	return m_valid;
+}
+
+// Sets the cascades of commands, flagging those to draw again, and returns the block the lighting shaders sample them with.
+// Must be called once per built frame, after the camera and projection of commands are set.
+ShadowBlock CascadedShadowMap::fit(glm::vec3 const& light_direction, unsigned long long const& scene_version, FrameCommands& commands)
+{
+	// Camera parameters recovered from the perspective projection
+	glm::mat4 const& projection(commands.projection);
+	const float near_plane(projection[3][2] / (projection[2][2] - 1.f));
+	const float far_plane(projection[3][2] / (projection[2][2] + 1.f));
+	const float tan_half_fov(1.f / projection[1][1]);
+	const float aspect(projection[1][1] / projection[0][0]);
+	const float corner_slope(tan_half_fov * tan_half_fov * (1.f + aspect * aspect)); // squared distance of a corner to the view axis, per squared depth
+
+	const float distance(std::min(m_shadow_distance, far_plane));
+	const glm::vec3 front(glm::normalize(commands.camera_front));
+
+	// The light's orientation only depends on its direction, so the texel grid stays put while the camera moves
+	const glm::vec3 direction(glm::normalize(light_direction));
+	const glm::mat4 light_view(glm::lookAt(glm::vec3(0.f), direction, std::abs(direction.y) > .99f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f)));
+
+	// Any moved object may change the shadows of every cascade
+	const bool stale(!m_drawn_valid || scene_version != m_drawn_version);
+	m_drawn_valid = true;
+	m_drawn_version = scene_version;
+
+	ShadowBlock block{};
+	block.camera_front = front;
+	block.cascade_count = static_cast<GLint>(m_cascade_count);
+	commands.cascade_count = m_cascade_count;
+	commands.cascade_redraw = 0;
+
+	float slice_near(near_plane);
+	for (unsigned int cascade = 0; cascade < m_cascade_count; cascade++) {
+		const float ratio(static_cast<float>(cascade + 1) / m_cascade_count);
+		const float slice_far(s_split_lambda * near_plane * std::pow(distance / near_plane, ratio) + (1.f - s_split_lambda) * (near_plane + (distance - near_plane) * ratio));
+
+		// Smallest sphere around the slice, centered on the view axis. Its radius doesn't change with the camera's orientation,
+		// rounding it up keeps float noise out of the texel size.
+		const float center_depth(std::min((slice_near + slice_far) * .5f * (1.f + corner_slope), slice_far));
+		float radius(std::sqrt((slice_far - center_depth) * (slice_far - center_depth) + slice_far * slice_far * corner_slope));
+		radius = std::ceil(radius * 16.f) / 16.f;
+
+		// Moving the projection by whole texels only, every texel keeps covering the same area of the world
+		const float texel(2.f * radius / m_resolution);
+		glm::vec3 center(light_view * glm::vec4(commands.camera_position + front * center_depth, 1.f));
+		center = glm::floor(center / texel) * texel;
+
+		// Casters up to shadow_distance in front of the sphere are kept in the depth range
+		const glm::mat4 cascade_projection(glm::ortho(center.x - radius, center.x + radius, center.y - radius, center.y + radius,
+			-center.z - radius - m_shadow_distance, -center.z + radius));
+		const glm::mat4 view_projection(cascade_projection * light_view);
+
+		commands.cascade_view_projs[cascade] = view_projection;
+		if (stale || view_projection != m_drawn[cascade]) {
+			commands.cascade_redraw |= 1u << cascade;
+			m_drawn[cascade] = view_projection;
+		}
+
+		block.view_projs[cascade] = view_projection;
+		block.splits[cascade] = slice_far;
+		slice_near = slice_far;
+	}
+
+	return block;
+}
+
+// Draws every cascade again on the next fit(), e.g. after the depth shader got reloaded
+void CascadedShadowMap::invalidate()
+{
+	m_drawn_valid = false;
+}
+
+
+// Draws the casters of the cascades flagged by fit(), leaving the last shadow framebuffer bound with the viewport set to its size
+void CascadedShadowMap::render(FrameCommands const& commands, DynamicRingBuffer const& uniforms) const
+{
+	// The profiler keeps the name pointers
+	static const char* const pass_names[] = { "Shadow cascade 0", "Shadow cascade 1", "Shadow cascade 2", "Shadow cascade 3" };
+	static_assert(sizeof(pass_names) / sizeof(pass_names[0]) == MAX_SHADOW_CASCADES, "Every cascade needs a pass name");
+
+	glViewport(0, 0, m_resolution, m_resolution);
+	glDisable(GL_BLEND);
+	glEnable(GL_CULL_FACE);
+	glDepthMask(GL_TRUE);
+	glStencilMask(0x00);
+
+	// Slope scaled bias against shadow acne
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.f, 4.f);
+	m_depth_shader.use();
+
+	for (unsigned int cascade = 0; cascade < commands.cascade_count; cascade++) {
+		if (!(commands.cascade_redraw & (1u << cascade)))
+			continue;
+
+		PROFILE_PASS(pass_names[cascade]);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[cascade]);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		m_depth_shader.setUni("light_view_proj", commands.cascade_view_projs[cascade]);
+
+		for (DrawPacket const& packet : commands.cascades[cascade]) {
+			uniforms.bindRange(OBJECT_BLOCK_BINDING, packet.object);
+			packet.model->Draw(m_depth_shader, false);
+		}
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+}
+
+void CascadedShadowMap::bindTexture(GLuint const& unit) const
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_depth);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+
+// Exposed for hot reloading
+Shader& CascadedShadowMap::depthShader()
+{
+	return m_depth_shader;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <string>
+
+#include <GL/glew.h>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "DynamicRingBuffer.h"
+#include "Scene.h"
+#include "Shader.h"
+#include "UniformBlocks.h"
+
+
+// Shadows of a directional light over the first shadow_distance units of the camera frustum, split into cascades
+// with the practical scheme (logarithmic and uniform splits blended). Each cascade is an orthographic projection
+// bounding a sphere around its slice of the frustum, snapped to its texels so shadows don't shimmer as the camera moves.
+// A cascade whose projection and casters haven't changed since it was drawn keeps its map from the previous frames.
+class CascadedShadowMap
+{
+public:
+	CascadedShadowMap(unsigned int const& resolution, unsigned int const& cascade_count, float const& shadow_distance, std::string const& shaders_directory);
+	~CascadedShadowMap();
+
+	bool valid() const;
+
+	ShadowBlock fit(glm::vec3 const& light_direction, unsigned long long const& scene_version, FrameCommands& commands);
+	void invalidate();
+
+	void render(FrameCommands const& commands, DynamicRingBuffer const& uniforms) const;
+	void bindTexture(GLuint const& unit) const;
+
+	Shader& depthShader();
+
+private:
+	static constexpr float s_split_lambda = .75f; // 0 = uniform splits, 1 = logarithmic splits
+
+	GLuint m_depth; // GL_TEXTURE_2D_ARRAY, a layer per cascade
+	std::array<GLuint, MAX_SHADOW_CASCADES> m_framebuffers;
+	bool m_valid;
+
+	unsigned int const m_resolution;
+	unsigned int const m_cascade_count;
+	float const m_shadow_distance;
+
+	std::array<glm::mat4, MAX_SHADOW_CASCADES> m_drawn; // projections of the maps last drawn, or queued to be
+	unsigned long long m_drawn_version;
+	bool m_drawn_valid;
+
+	Shader m_depth_shader;
+};
@@ -0,0 +1,112 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "Profiler.h"
+
+
+DynamicResolution::DynamicResolution(unsigned int const& width, unsigned int const& height, double const& budget_ms, float const& min_scale, float const& sharpness,
+	std::string const& shaders_directory) :
+	m_window_width(width), m_window_height(height), m_budget_ms(budget_ms), m_min_scale(std::min(std::max(min_scale, s_scale_step), 1.f)), m_sharpness(sharpness),
+	m_scale(1.f), m_average_ms(0.0), m_fixed_ms(0.0), m_frames(0), m_empty_vao(0),
+	m_upscale_shader(shaders_directory + "fullscreen.vert", shaders_directory + "upscale.frag")
+{
+	glGenVertexArrays(1, &m_empty_vao);
+}
+
+DynamicResolution::~DynamicResolution()
+{
+	glDeleteVertexArrays(1, &m_empty_vao);
+}
+
+
+// Takes the GPU time of the passes drawn at the rendering resolution and of the whole frame, both from a recent frame
+// and 0 when not completely measured
+void DynamicResolution::update(double const& scaled_ms, double const& frame_ms)
+{
+	if (scaled_ms <= 0.0)
+		return;
+
+	m_average_ms = m_average_ms == 0.0 ? scaled_ms : m_average_ms + (scaled_ms - m_average_ms) * .1;
+	if (frame_ms >= scaled_ms)
+		m_fixed_ms = m_fixed_ms == 0.0 ? frame_ms - scaled_ms : m_fixed_ms + (frame_ms - scaled_ms - m_fixed_ms) * .1;
+	if (++m_frames < s_adjust_interval)
+		return;
+
+	// Rounded down to a step, so the scale only grows once a whole step fits in the budget
+	const double budget(std::max(m_budget_ms * s_headroom - m_fixed_ms, 0.0));
+	const float desired(m_scale * static_cast<float>(std::sqrt(budget / m_average_ms)));
+	const float scale(std::min(std::max(std::floor(desired / s_scale_step + 1e-3f) * s_scale_step, m_min_scale), 1.f));
+	if (std::abs(scale - m_scale) < s_scale_step * .5f)
+		return;
+
+	// Timings still in flight were measured at the previous scale, the fixed cost doesn't depend on it
+	m_scale = scale;
+	m_average_ms = 0.0;
+	m_frames = 0;
+}
+
+float DynamicResolution::scale() const
+{
+	return m_scale;
+}
+
+unsigned int DynamicResolution::width() const
+{
+	return std::max(static_cast<unsigned int>(std::lround(m_window_width * m_scale)), 1u);
+}
+
+unsigned int DynamicResolution::height() const
+{
+	return std::max(static_cast<unsigned int>(std::lround(m_window_height * m_scale)), 1u);
+}
+
+
+// Stretches the rendered corner of the scene target over the default framebuffer, which is left bound
+void DynamicResolution::present(GLuint const& scene_framebuffer, GLuint const& scene_texture) const
+{
+	const unsigned int render_width(width()), render_height(height());
+
+	if (render_width == m_window_width && render_height == m_window_height) {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, scene_framebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, render_width, render_height, 0, 0, m_window_width, m_window_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return;
+	}
+
+	// Even without sharpening: a bilinear blit of the corner would filter in the texels past its right and top edges
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, m_window_width, m_window_height);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_BLEND);
+
+	m_upscale_shader.use();
+	m_upscale_shader.setUni("scene", 0);
+	m_upscale_shader.setUni("render_size", glm::ivec2(render_width, render_height));
+	m_upscale_shader.setUni("output_size", glm::ivec2(m_window_width, m_window_height));
+	m_upscale_shader.setUni("sharpness", m_sharpness);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, scene_texture);
+
+	glBindVertexArray(m_empty_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	Profiler::countDraw(3);
+
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glEnable(GL_STENCIL_TEST);
+	glEnable(GL_DEPTH_TEST);
+}
+
+
+// Exposed for hot reloading
+Shader& DynamicResolution::upscaleShader()
+{
+	return m_upscale_shader;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+
+#include <GL/glew.h>
+
+#include "Shader.h"
+
+
+// Scales the rendering resolution to keep the GPU time of a frame under a budget: the scene is drawn into the bottom-left
+// corner of the full size offscreen target, then stretched over the window by a bilinear pass clamped to that corner,
+// optionally sharpening.
+// The GPU time of the passes drawn at that resolution is assumed proportional to its pixel count, the rest of the frame
+// (shadows, culling, presenting...) is taken off the budget. The scale moves by steps and at most every few frames.
+class DynamicResolution
+{
+public:
+	DynamicResolution(unsigned int const& width, unsigned int const& height, double const& budget_ms, float const& min_scale, float const& sharpness,
+		std::string const& shaders_directory);
+	~DynamicResolution();
+
+	void update(double const& scaled_ms, double const& frame_ms);
+
+	float scale() const;
+	unsigned int width() const;
+	unsigned int height() const;
+
+	void present(GLuint const& scene_framebuffer, GLuint const& scene_texture) const;
+
+	Shader& upscaleShader();
+
+private:
+	static constexpr float s_scale_step = .05f;
+	static constexpr unsigned int s_adjust_interval = 30; // frames, GPU timings lag a couple of frames behind
+	static constexpr double s_headroom = .9; // fraction of the budget aimed at
+
+	unsigned int const m_window_width;
+	unsigned int const m_window_height;
+	double const m_budget_ms;
+	float const m_min_scale;
+	float const m_sharpness; // 0 = plain bilinear
+
+	float m_scale;
+	double m_average_ms; // of the scaled passes, 0 until a timing at the current scale is known
+	double m_fixed_ms; // rest of the frame, 0 until known
+	unsigned int m_frames;
+
+	GLuint m_empty_vao;
+	Shader m_upscale_shader;
+};
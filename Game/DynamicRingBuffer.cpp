@@ -0,0 +1,152 @@
+#include "DynamicRingBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "Profiler.h"
+
+
+DynamicRingBuffer::DynamicRingBuffer(GLenum const& target, GLsizeiptr const& region_size) : m_target(target), m_region_size(region_size), m_alignment(16),
+	m_buffer(0), m_mapping(nullptr), m_shadow(), m_fences(), m_used(), m_overflows(0), m_current(s_regions - 1)
+{
+	// Slices bound with glBindBufferRange() must start on the implementation's offset alignment
+	if (m_target == GL_UNIFORM_BUFFER) {
+		GLint alignment(0);
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		m_alignment = std::max<GLsizeiptr>(m_alignment, alignment);
+	}
+	m_region_size = (m_region_size + m_alignment - 1) / m_alignment * m_alignment;
+
+	for (size_t i = 0; i < s_regions; i++) {
+		m_fences[i] = nullptr;
+		m_used[i] = 0;
+	}
+
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(m_target, m_buffer);
+
+	const GLsizeiptr total_size(m_region_size * s_regions);
+	if (GLEW_ARB_buffer_storage) {
+		const GLbitfield flags(GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+		glBufferStorage(m_target, total_size, nullptr, flags);
+		m_mapping = static_cast<unsigned char*>(glMapBufferRange(m_target, 0, total_size, flags));
+		if (!m_mapping)
+			std::cerr << "Failed to persistently map the dynamic buffer, falling back to per-frame uploads." << std::endl;
+	}
+	if (!m_mapping) {
+		// Immutable storage can't be respecified, start over from a mutable buffer
+		if (GLEW_ARB_buffer_storage) {
+			glBindBuffer(m_target, 0);
+			glDeleteBuffers(1, &m_buffer);
+			glGenBuffers(1, &m_buffer);
+			glBindBuffer(m_target, m_buffer);
+		}
+		glBufferData(m_target, total_size, nullptr, GL_STREAM_DRAW);
+		m_shadow.resize(static_cast<size_t>(total_size));
+	}
+
+	glBindBuffer(m_target, 0);
+}
+
+DynamicRingBuffer::~DynamicRingBuffer()
+{
+	for (GLsync const& fence : m_fences)
+		if (fence)
+			glDeleteSync(fence);
+
+	if (m_mapping) {
+		glBindBuffer(m_target, m_buffer);
+		glUnmapBuffer(m_target);
+		glBindBuffer(m_target, 0);
+	}
+	glDeleteBuffers(1, &m_buffer);
+}
+
+
+// Moves to the next region, blocking only if the GPU still reads from it (more than s_regions - 1 frames behind)
+unsigned int DynamicRingBuffer::beginFrame()
+{
+	m_current = (m_current + 1) % s_regions;
+
+	if (m_fences[m_current]) {
+		PROFILE_SCOPE("Ring buffer wait");
+
+		GLenum status(glClientWaitSync(m_fences[m_current], 0, 0));
+		while (status == GL_TIMEOUT_EXPIRED)
+			status = glClientWaitSync(m_fences[m_current], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		if (status == GL_WAIT_FAILED)
+			std::cerr << "Failed to wait for a dynamic buffer region." << std::endl;
+
+		glDeleteSync(m_fences[m_current]);
+		m_fences[m_current] = nullptr;
+	}
+
+	const unsigned int overflows(m_overflows.exchange(0));
+	if (overflows > 0)
+		std::cerr << overflows << " dynamic buffer allocation(s) failed last frame, the region size (" << m_region_size << " bytes) is too small." << std::endl;
+
+	m_used[m_current] = 0;
+	return m_current;
+}
+
+// Lock-free, callable from any thread between beginFrame() and commit() of the region. Returns a null slice when the region is full.
+DynamicSlice DynamicRingBuffer::allocate(unsigned int const& region, size_t const& size)
+{
+	const GLsizeiptr aligned_size((static_cast<GLsizeiptr>(size) + m_alignment - 1) / m_alignment * m_alignment);
+	const GLsizeiptr offset(m_used[region].fetch_add(aligned_size, std::memory_order_relaxed));
+
+	if (offset + aligned_size > m_region_size) {
+		m_overflows.fetch_add(1, std::memory_order_relaxed);
+		return { nullptr, 0, 0 };
+	}
+
+	const GLintptr buffer_offset(static_cast<GLintptr>(region) * m_region_size + offset);
+	unsigned char* const base(m_mapping ? m_mapping : m_shadow.data());
+	return { base + buffer_offset, buffer_offset, static_cast<GLsizeiptr>(size) };
+}
+
+// Makes the writes of the region visible to the GPU, nothing to do with a coherent persistent mapping
+void DynamicRingBuffer::commit(unsigned int const& region)
+{
+	const GLsizeiptr used(std::min(m_used[region].load(), m_region_size));
+	if (m_mapping || used == 0)
+		return;
+
+	// The fence waited on in beginFrame() guarantees the GPU is done with the range, no need for the driver to synchronize
+	const GLintptr offset(static_cast<GLintptr>(region) * m_region_size);
+	glBindBuffer(m_target, m_buffer);
+	void* const data(glMapBufferRange(m_target, offset, used, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+	if (data) {
+		std::memcpy(data, m_shadow.data() + offset, static_cast<size_t>(used));
+		glUnmapBuffer(m_target);
+	}
+	else
+		std::cerr << "Failed to map a dynamic buffer region." << std::endl;
+	glBindBuffer(m_target, 0);
+}
+
+// To be called once every draw reading from the region has been submitted
+void DynamicRingBuffer::fence(unsigned int const& region)
+{
+	if (m_fences[region])
+		glDeleteSync(m_fences[region]);
+	m_fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+
+void DynamicRingBuffer::bindRange(GLuint const& binding, DynamicSlice const& slice) const
+{
+	glBindBufferRange(m_target, binding, m_buffer, slice.offset, slice.size);
+	Profiler::countStateChange();
+}
+
+GLuint DynamicRingBuffer::id() const
+{
+	return m_buffer;
+}
+
+bool DynamicRingBuffer::persistent() const
+{
+	return m_mapping != nullptr;
+}
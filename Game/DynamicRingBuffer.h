@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+
+// Per-frame slice of the ring, data is only valid until the frame region is committed
+struct DynamicSlice {
+	void* data;
+	GLintptr offset; // from the start of the buffer, for glBindBufferRange()
+	GLsizeiptr size;
+};
+
+
+// Buffer split in one region per frame in flight, each region being fenced once the GPU has been given its draws:
+//   region = ring.beginFrame();                   (GL thread, waits for the GPU to release the region)
+//   slice = ring.allocate(region, size);          (any thread)
+//   ring.commit(region); draws...; ring.fence(region);   (GL thread)
+// With GL_ARB_buffer_storage the buffer stays persistently mapped and slices point straight into it,
+// otherwise slices point to a CPU copy uploaded by commit() through an unsynchronized mapping.
+class DynamicRingBuffer
+{
+public:
+	static constexpr unsigned int s_regions = 3;
+
+	DynamicRingBuffer(GLenum const& target, GLsizeiptr const& region_size);
+	~DynamicRingBuffer();
+
+	unsigned int beginFrame();
+	DynamicSlice allocate(unsigned int const& region, size_t const& size);
+	void commit(unsigned int const& region);
+	void fence(unsigned int const& region);
+
+	void bindRange(GLuint const& binding, DynamicSlice const& slice) const;
+
+	GLuint id() const;
+	bool persistent() const;
+
+private:
+	const GLenum m_target;
+	GLsizeiptr m_region_size;
+	GLsizeiptr m_alignment;
+
+	GLuint m_buffer;
+	unsigned char* m_mapping; // persistent mapping, nullptr on the fallback path
+	std::vector<unsigned char> m_shadow; // CPU copy written by slices on the fallback path
+
+	std::array<GLsync, s_regions> m_fences;
+	std::array<std::atomic<GLsizeiptr>, s_regions> m_used;
+	std::atomic<unsigned int> m_overflows;
+	unsigned int m_current;
+};
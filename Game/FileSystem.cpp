@@ -0,0 +1,145 @@
+#include "FileSystem.h"
+
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+#include "Archive.h"
+
+
+FileData::FileData() : m_storage(), m_data(nullptr), m_size(0), m_valid(false)
+{
+}
+
+FileData::FileData(unsigned char const* data, size_t const& size) : m_storage(), m_data(data), m_size(size), m_valid(true)
+{
+}
+
+// Moving the vector keeps its buffer, m_data stays valid when the FileData is moved
+FileData::FileData(std::vector<unsigned char>&& storage) : m_storage(std::move(storage)), m_data(m_storage.data()), m_size(m_storage.size()), m_valid(true)
+{
+}
+
+bool FileData::valid() const
+{
+	return m_valid;
+}
+
+unsigned char const* FileData::data() const
+{
+	return m_data;
+}
+
+size_t FileData::size() const
+{
+	return m_size;
+}
+
+
+std::unique_ptr<Archive> FileSystem::s_archive;
+std::string FileSystem::s_root;
+std::atomic<unsigned int> FileSystem::s_archive_reads(0), FileSystem::s_disk_reads(0);
+
+bool FileSystem::mount(std::string const& archive_file, std::string const& root)
+{
+	std::unique_ptr<Archive> archive(new Archive());
+	if (!archive->open(archive_file))
+		return false;
+
+	std::cout << "Mounted \"" << archive_file << "\" (" << archive->entryCount() << " files)." << std::endl;
+	s_archive = std::move(archive);
+	s_root = normalize(root);
+	return true;
+}
+
+bool FileSystem::mounted()
+{
+	return s_archive != nullptr;
+}
+
+bool FileSystem::exists(std::string const& path)
+{
+	std::string archive_path;
+	if (inArchive(path, archive_path))
+		return true;
+
+	return std::ifstream(path).good();
+}
+
+FileData FileSystem::read(std::string const& path)
+{
+	std::string archive_path;
+	if (inArchive(path, archive_path)) {
+		s_archive_reads++;
+		return s_archive->read(archive_path);
+	}
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return FileData();
+
+	std::vector<unsigned char> contents(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	if (!file.read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size())))
+		return FileData();
+
+	s_disk_reads++;
+	return FileData(std::move(contents));
+}
+
+std::string FileSystem::normalize(std::string const& path)
+{
+	const bool absolute(!path.empty() && (path[0] == '/' || path[0] == '\\'));
+
+	std::vector<std::string> components;
+	size_t start(0);
+	while (start <= path.size()) {
+		size_t end(path.find_first_of("/\\", start));
+		if (end == std::string::npos)
+			end = path.size();
+
+		const std::string component(path.substr(start, end - start));
+		if (component == "..") {
+			if (!components.empty() && components.back() != "..")
+				components.pop_back();
+			else if (!absolute)
+				components.push_back(component);
+		}
+		else if (!component.empty() && component != ".")
+			components.push_back(component);
+
+		start = end + 1;
+	}
+
+	std::string normalized(absolute ? "/" : "");
+	for (size_t i = 0; i < components.size(); i++)
+		normalized += (i > 0 ? "/" : "") + components[i];
+	return normalized;
+}
+
+unsigned int FileSystem::archiveReads()
+{
+	return s_archive_reads;
+}
+
+unsigned int FileSystem::diskReads()
+{
+	return s_disk_reads;
+}
+
+
+// archive_path is relative to the root, as packed
+bool FileSystem::inArchive(std::string const& path, std::string& archive_path)
+{
+	if (!s_archive)
+		return false;
+
+	archive_path = normalize(path);
+	if (!s_root.empty()) {
+		if (archive_path.compare(0, s_root.size(), s_root) != 0 || archive_path.size() <= s_root.size() || archive_path[s_root.size()] != '/')
+			return false;
+		archive_path.erase(0, s_root.size() + 1);
+	}
+
+	return s_archive->contains(archive_path);
+}
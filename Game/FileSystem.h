@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Archive;
+
+
+// Contents of a file read through the FileSystem: points into the mapped archive for entries stored as is, otherwise
+// owns the decompressed entry or the loose file
+class FileData
+{
+public:
+	FileData();
+	FileData(unsigned char const* data, size_t const& size);
+	explicit FileData(std::vector<unsigned char>&& storage);
+	FileData(FileData&&) = default;
+	FileData& operator=(FileData&&) = default;
+
+	FileData(FileData const&) = delete;
+	FileData& operator=(FileData const&) = delete;
+
+	bool valid() const;
+	unsigned char const* data() const;
+	size_t size() const;
+
+private:
+	std::vector<unsigned char> m_storage;
+	unsigned char const* m_data;
+	size_t m_size;
+	bool m_valid;
+};
+
+
+// Reads the assets from a mounted archive when they are packed in it, from the disk otherwise. Mounting happens
+// once at startup, reads are then safe from any thread.
+class FileSystem
+{
+public:
+	// Serves the files under root (the data directory) from the archive
+	static bool mount(std::string const& archive_file, std::string const& root);
+	static bool mounted();
+
+	static bool exists(std::string const& path);
+	static FileData read(std::string const& path);
+
+	// Forward slashes, without empty, "." nor resolvable ".." components
+	static std::string normalize(std::string const& path);
+
+	static unsigned int archiveReads();
+	static unsigned int diskReads();
+
+private:
+	static bool inArchive(std::string const& path, std::string& archive_path);
+
+	static std::unique_ptr<Archive> s_archive;
+	static std::string s_root; // normalized
+	static std::atomic<unsigned int> s_archive_reads, s_disk_reads;
+};
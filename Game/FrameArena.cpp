@@ -0,0 +1,91 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+
+constexpr size_t FrameArena::s_default_capacity;
+std::mutex FrameArena::s_arenas_mutex;
+std::vector<FrameArena*> FrameArena::s_arenas = {};
+
+namespace
+{
+	unsigned char* alignUp(unsigned char* const pointer, size_t const& alignment)
+	{
+		const uintptr_t address(reinterpret_cast<uintptr_t>(pointer));
+		return pointer + ((alignment - address % alignment) % alignment);
+	}
+}
+
+
+FrameArena::FrameArena(size_t const& capacity) : m_block(new unsigned char[capacity]), m_capacity(capacity), m_offset(0), m_overflow(), m_overflow_size(0)
+{
+}
+
+FrameArena::~FrameArena()
+{
+	std::lock_guard<std::mutex> lock(s_arenas_mutex);
+	s_arenas.erase(std::remove(s_arenas.begin(), s_arenas.end(), this), s_arenas.end());
+}
+
+
+void* FrameArena::allocate(size_t const& size, size_t const& alignment)
+{
+	unsigned char* const begin(m_block.get());
+	unsigned char* const aligned(alignUp(begin + m_offset, alignment));
+	if (aligned + size <= begin + m_capacity) {
+		m_offset = static_cast<size_t>(aligned + size - begin);
+		return aligned;
+	}
+
+	m_overflow.emplace_back(new unsigned char[size + alignment]);
+	m_overflow_size += size + alignment;
+	return alignUp(m_overflow.back().get(), alignment);
+}
+
+// Invalidates everything allocated since the last reset
+void FrameArena::reset()
+{
+	if (!m_overflow.empty()) {
+		m_capacity = std::max(m_capacity * 2, m_offset + m_overflow_size);
+		m_block.reset(new unsigned char[m_capacity]);
+		m_overflow.clear();
+		m_overflow_size = 0;
+	}
+
+	m_offset = 0;
+}
+
+
+size_t FrameArena::used() const
+{
+	return m_offset + m_overflow_size;
+}
+
+size_t FrameArena::capacity() const
+{
+	return m_capacity;
+}
+
+
+FrameArena& FrameArena::local()
+{
+	thread_local FrameArena arena;
+	thread_local bool registered(false);
+
+	if (!registered) {
+		std::lock_guard<std::mutex> lock(s_arenas_mutex);
+		s_arenas.push_back(&arena);
+		registered = true;
+	}
+
+	return arena;
+}
+
+// Only safe once no thread uses memory from its arena anymore, e.g. when the frame's jobs have all been released
+void FrameArena::resetAll()
+{
+	std::lock_guard<std::mutex> lock(s_arenas_mutex);
+	for (FrameArena* const arena : s_arenas)
+		arena->reset();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+
+// Linear allocator for data that only lives during a frame: allocations bump an offset, nothing is freed individually
+// and reset() makes the whole block available again. Allocations that don't fit in the block take heap blocks until
+// the next reset(), which grows the block so that the same frame fits in it from then on.
+// Each thread allocates from its own arena, only resetAll() touches the arenas of other threads.
+class FrameArena
+{
+public:
+	explicit FrameArena(size_t const& capacity = s_default_capacity);
+	~FrameArena();
+
+	FrameArena(FrameArena const&) = delete;
+	FrameArena& operator=(FrameArena const&) = delete;
+
+	void* allocate(size_t const& size, size_t const& alignment = alignof(std::max_align_t));
+	template <typename T, typename... Args>
+	T* create(Args&&... args);
+
+	void reset();
+
+	size_t used() const;
+	size_t capacity() const;
+
+	static FrameArena& local();
+	static void resetAll();
+
+private:
+	static constexpr size_t s_default_capacity = 64 * 1024;
+
+	std::unique_ptr<unsigned char[]> m_block;
+	size_t m_capacity;
+	size_t m_offset;
+	std::vector<std::unique_ptr<unsigned char[]>> m_overflow; // freed by reset()
+	size_t m_overflow_size;
+
+	static std::mutex s_arenas_mutex;
+	static std::vector<FrameArena*> s_arenas; // every thread's local() arena
+};
+
+
+// Objects are constructed in place, their destructor is never called by the arena
+template <typename T, typename... Args>
+T* FrameArena::create(Args&&... args)
+{
+	return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+}
+
+
+// STL allocator adaptor, deallocating is a no-op: the memory comes back with the arena's reset()
+template <typename T>
+class ArenaAllocator
+{
+public:
+	using value_type = T;
+
+	explicit ArenaAllocator(FrameArena& arena) : m_arena(&arena) {}
+	template <typename U>
+	ArenaAllocator(ArenaAllocator<U> const& other) : m_arena(other.arena()) {}
+
+	T* allocate(size_t const count) { return static_cast<T*>(m_arena->allocate(count * sizeof(T), alignof(T))); }
+	void deallocate(T*, size_t const) {}
+
+	FrameArena* arena() const { return m_arena; }
+
+private:
+	FrameArena* m_arena;
+};
+
+template <typename T, typename U>
+bool operator==(ArenaAllocator<T> const& a, ArenaAllocator<U> const& b) { return a.arena() == b.arena(); }
+template <typename T, typename U>
+bool operator!=(ArenaAllocator<T> const& a, ArenaAllocator<U> const& b) { return a.arena() != b.arena(); }
+
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,91 @@
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+
+FrameScheduler::FrameScheduler(CSimpleIniA const& ini_file) : m_frequency(SDL_GetPerformanceFrequency()),
+	m_tick_duration(), m_frame_duration(), m_spin_threshold(),
+	m_last_frame(SDL_GetPerformanceCounter()), m_next_frame(m_last_frame), m_accumulator(0), m_frame_time(0)
+{
+	const int tick_rate(std::max(1, std::stoi(ini_file.GetValue("Simulation", "TickRate", "120"))));
+	const int frame_cap(std::max(0, std::stoi(ini_file.GetValue("Video", "FrameCap", "0"))));
+
+	m_tick_duration = m_frequency / static_cast<Uint64>(tick_rate);
+	m_frame_duration = (frame_cap > 0) ? m_frequency / static_cast<Uint64>(frame_cap) : 0;
+	// SDL_Delay() can overshoot by a scheduler quantum, the last 2 ms are spent spinning
+	m_spin_threshold = m_frequency / 500;
+}
+
+FrameScheduler::~FrameScheduler()
+{
+}
+
+
+void FrameScheduler::beginFrame()
+{
+	const Uint64 now(SDL_GetPerformanceCounter());
+	m_frame_time = now - m_last_frame;
+	m_last_frame = now;
+
+	// After a long stall (loading, debugger...), only a quarter of a second is simulated to avoid spiraling
+	m_accumulator += std::min(m_frame_time, m_frequency / 4);
+}
+
+// Returns true while a fixed simulation step is due
+bool FrameScheduler::step()
+{
+	if (m_accumulator < m_tick_duration)
+		return false;
+
+	m_accumulator -= m_tick_duration;
+	return true;
+}
+
+// Waits for the next frame slot when a frame cap is set, sleeping first then spinning to reduce jitter
+void FrameScheduler::endFrame()
+{
+	if (m_frame_duration == 0)
+		return;
+
+	m_next_frame += m_frame_duration;
+
+	Uint64 now(SDL_GetPerformanceCounter());
+	if (now >= m_next_frame) {
+		// Already late, realign the schedule instead of trying to catch up
+		if (now - m_next_frame > m_frame_duration)
+			m_next_frame = now;
+		return;
+	}
+
+	while (now < m_next_frame) {
+		const Uint64 remaining(m_next_frame - now);
+
+		if (remaining > m_spin_threshold)
+			SDL_Delay(static_cast<Uint32>((remaining - m_spin_threshold) * 1000 / m_frequency));
+		else
+			std::this_thread::yield();
+
+		now = SDL_GetPerformanceCounter();
+	}
+}
+
+
+// Duration of a simulation step, in seconds
+float FrameScheduler::fixedDelta() const
+{
+	return static_cast<float>(static_cast<double>(m_tick_duration) / static_cast<double>(m_frequency));
+}
+
+// Progression between the last two simulation states, used to interpolate what gets rendered
+float FrameScheduler::alpha() const
+{
+	return static_cast<float>(static_cast<double>(m_accumulator) / static_cast<double>(m_tick_duration));
+}
+
+// Duration of the last frame, in seconds
+double FrameScheduler::frameTime() const
+{
+	return static_cast<double>(m_frame_time) / static_cast<double>(m_frequency);
+}
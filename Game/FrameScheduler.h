@@ -0,0 +1,36 @@
+#pragma once
+
+#include <SDL.h>
+#include <SimpleIni.h>
+
+
+// Drives a fixed-timestep simulation decoupled from rendering:
+//   scheduler.beginFrame();
+//   while (scheduler.step()) { update(scheduler.fixedDelta()); }
+//   render(scheduler.alpha());
+//   scheduler.endFrame();
+class FrameScheduler
+{
+public:
+	explicit FrameScheduler(CSimpleIniA const& ini_file);
+	~FrameScheduler();
+
+	void beginFrame();
+	bool step();
+	void endFrame();
+
+	float fixedDelta() const;
+	float alpha() const;
+	double frameTime() const;
+
+private:
+	const Uint64 m_frequency;
+	Uint64 m_tick_duration; // counter ticks per simulation step
+	Uint64 m_frame_duration; // counter ticks per frame, 0 when uncapped
+	Uint64 m_spin_threshold; // remaining counter ticks below which pacing busy-waits instead of sleeping
+
+	Uint64 m_last_frame;
+	Uint64 m_next_frame;
+	Uint64 m_accumulator;
+	Uint64 m_frame_time;
+};
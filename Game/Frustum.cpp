@@ -0,0 +1,40 @@
+#include "Frustum.h"
+
+#include <glm/glm.hpp>
+
+
+Frustum::Frustum() : m_planes()
+{
+	m_planes.fill(glm::vec4(0.f));
+}
+
+// Gribb/Hartmann plane extraction from the combined matrix
+Frustum::Frustum(glm::mat4 const& view_projection) : m_planes()
+{
+	for (int i = 0; i < 3; i++) {
+		for (int side = 0; side < 2; side++) {
+			glm::vec4& plane(m_planes[i * 2 + side]);
+			const float sign(side == 0 ? 1.f : -1.f);
+
+			for (int column = 0; column < 4; column++)
+				plane[column] = view_projection[column][3] + sign * view_projection[column][i];
+
+			plane = plane / glm::length(glm::vec3(plane));
+		}
+	}
+}
+
+
+bool Frustum::intersects(glm::vec3 const& center, float const& radius) const
+{
+	for (glm::vec4 const& plane : m_planes)
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			return false;
+
+	return true;
+}
+
+std::array<glm::vec4, 6> const& Frustum::planes() const
+{
+	return m_planes;
+}
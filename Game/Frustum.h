@@ -0,0 +1,21 @@
+#pragma once
+
+#include <array>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+
+class Frustum
+{
+public:
+	Frustum();
+	explicit Frustum(glm::mat4 const& view_projection);
+
+	bool intersects(glm::vec3 const& center, float const& radius) const;
+	std::array<glm::vec4, 6> const& planes() const;
+
+private:
+	std::array<glm::vec4, 6> m_planes; // normalized, pointing inwards
+};
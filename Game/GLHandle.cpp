@@ -0,0 +1,45 @@
+#include "GLHandle.h"
+
+#include <iostream>
+
+
+std::array<long, GL_OBJECT_TYPE_COUNT> GLObjects::s_live = {};
+
+void GLObjects::created(GLObjectType const& type)
+{
+	s_live[type]++;
+}
+
+void GLObjects::destroyed(GLObjectType const& type)
+{
+	s_live[type]--;
+}
+
+
+long GLObjects::live(GLObjectType const& type)
+{
+	return s_live[type];
+}
+
+const char* GLObjects::name(GLObjectType const& type)
+{
+	static const char* const names[] = { "buffers", "vertex arrays", "textures", "samplers", "programs", "framebuffers", "renderbuffers" };
+	static_assert(sizeof(names) / sizeof(names[0]) == GL_OBJECT_TYPE_COUNT, "Every object type needs a name");
+
+	return names[type];
+}
+
+// Prints the types that still have live objects, returns true when there are none
+bool GLObjects::reportLeaks()
+{
+	bool clean(true);
+	for (int type = 0; type < GL_OBJECT_TYPE_COUNT; type++) {
+		if (s_live[type] == 0)
+			continue;
+
+		std::cerr << "Warning: " << s_live[type] << " GL " << name(static_cast<GLObjectType>(type)) << " still alive." << std::endl;
+		clean = false;
+	}
+
+	return clean;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+
+#include <GL/glew.h>
+
+
+enum GLObjectType {
+	GL_OBJECT_BUFFER,
+	GL_OBJECT_VERTEX_ARRAY,
+	GL_OBJECT_TEXTURE,
+	GL_OBJECT_SAMPLER,
+	GL_OBJECT_PROGRAM,
+	GL_OBJECT_FRAMEBUFFER,
+	GL_OBJECT_RENDERBUFFER,
+	GL_OBJECT_TYPE_COUNT
+};
+
+
+// Number of objects currently owned by GLHandles, per type. GL thread only.
+class GLObjects
+{
+public:
+	static void created(GLObjectType const& type);
+	static void destroyed(GLObjectType const& type);
+
+	static long live(GLObjectType const& type);
+	static const char* name(GLObjectType const& type);
+	static bool reportLeaks();
+
+private:
+	static std::array<long, GL_OBJECT_TYPE_COUNT> s_live;
+};
+
+
+template <GLObjectType Type>
+struct GLObjectTraits;
+
+template <>
+struct GLObjectTraits<GL_OBJECT_BUFFER> {
+	static GLuint generate() { GLuint id(0); glGenBuffers(1, &id); return id; }
+	static void destroy(GLuint const& id) { glDeleteBuffers(1, &id); }
+};
+
+template <>
+struct GLObjectTraits<GL_OBJECT_VERTEX_ARRAY> {
+	static GLuint generate() { GLuint id(0); glGenVertexArrays(1, &id); return id; }
+	static void destroy(GLuint const& id) { glDeleteVertexArrays(1, &id); }
+};
+
+template <>
+struct GLObjectTraits<GL_OBJECT_TEXTURE> {
+	static GLuint generate() { GLuint id(0); glGenTextures(1, &id); return id; }
+	static void destroy(GLuint const& id) { glDeleteTextures(1, &id); }
+};
+
+template <>
+struct GLObjectTraits<GL_OBJECT_SAMPLER> {
+	static GLuint generate() { GLuint id(0); glGenSamplers(1, &id); return id; }
+	static void destroy(GLuint const& id) { glDeleteSamplers(1, &id); }
+};
+
+template <>
+struct GLObjectTraits<GL_OBJECT_PROGRAM> {
+	static GLuint generate() { return glCreateProgram(); }
+	static void destroy(GLuint const& id) { glDeleteProgram(id); }
+};
+
+template <>
+struct GLObjectTraits<GL_OBJECT_FRAMEBUFFER> {
+	static GLuint generate() { GLuint id(0); glGenFramebuffers(1, &id); return id; }
+	static void destroy(GLuint const& id) { glDeleteFramebuffers(1, &id); }
+};
+
+template <>
+struct GLObjectTraits<GL_OBJECT_RENDERBUFFER> {
+	static GLuint generate() { GLuint id(0); glGenRenderbuffers(1, &id); return id; }
+	static void destroy(GLuint const& id) { glDeleteRenderbuffers(1, &id); }
+};
+
+
+// Move-only owner of a GL object name, deleted with the handle. An empty handle holds 0.
+template <GLObjectType Type>
+class GLHandle
+{
+public:
+	GLHandle() : m_id(0) {}
+	explicit GLHandle(GLuint const& id) : m_id(0) { reset(id); }
+	GLHandle(GLHandle&& other) noexcept : m_id(other.m_id) { other.m_id = 0; }
+	GLHandle(GLHandle const&) = delete;
+	~GLHandle() { reset(); }
+
+	GLHandle& operator=(GLHandle&& other) noexcept
+	{
+		if (this != &other) {
+			reset();
+			m_id = other.m_id;
+			other.m_id = 0;
+		}
+		return *this;
+	}
+	GLHandle& operator=(GLHandle const&) = delete;
+
+	static GLHandle generate() { return GLHandle(GLObjectTraits<Type>::generate()); }
+
+	GLuint id() const { return m_id; }
+	explicit operator bool() const { return m_id != 0; }
+
+	// Deletes the owned object, then adopts id
+	void reset(GLuint const& id = 0)
+	{
+		if (m_id != 0) {
+			GLObjectTraits<Type>::destroy(m_id);
+			GLObjects::destroyed(Type);
+		}
+		m_id = id;
+		if (m_id != 0)
+			GLObjects::created(Type);
+	}
+
+private:
+	GLuint m_id;
+};
+
+using GLBuffer = GLHandle<GL_OBJECT_BUFFER>;
+using GLVertexArray = GLHandle<GL_OBJECT_VERTEX_ARRAY>;
+using GLTexture = GLHandle<GL_OBJECT_TEXTURE>;
+using GLSampler = GLHandle<GL_OBJECT_SAMPLER>;
+using GLProgram = GLHandle<GL_OBJECT_PROGRAM>;
+using GLFramebuffer = GLHandle<GL_OBJECT_FRAMEBUFFER>;
+using GLRenderbuffer = GLHandle<GL_OBJECT_RENDERBUFFER>;
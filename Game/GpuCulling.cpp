@@ -0,0 +1,190 @@
+#include "GpuCulling.h"
+
+#include <array>
+#include <iostream>
+
+#include "Frustum.h"
+#include "Profiler.h"
+
+
+GpuCulling::GpuCulling(std::string const& shaders_directory) :
+	m_cull_shader(GL_COMPUTE_SHADER, shaders_directory + "gpu_culling.comp"),
+	m_draw_shader(shaders_directory + "basic_indirect.vert", shaders_directory + "basic.frag"),
+	m_depth_shader(shaders_directory + "basic_indirect.vert", shaders_directory + "depth_only.frag", "#define DEPTH_PREPASS\n"),
+	m_batches(), m_object_count(0),
+	m_objects(GLBuffer::generate()), m_records(GLBuffer::generate()), m_command_template(GLBuffer::generate()), m_commands(GLBuffer::generate()), m_instances(GLBuffer::generate())
+{
+}
+
+
+// Blocks until every program is linked
+bool GpuCulling::valid() const
+{
+	if (m_cull_shader.id() == 0 || m_draw_shader.id() == 0 || m_depth_shader.id() == 0) {
+		std::cerr << "Error: GPU culling programs failed to build." << std::endl;
+		return false;
+	}
+
+	// GL 4.3 only requires storage blocks in compute shaders, the drawing shaders read the instance list from one
+	GLint vertex_storage_blocks(0);
+	glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertex_storage_blocks);
+	if (vertex_storage_blocks < 1) {
+		std::cerr << "Error: GPU culling needs shader storage blocks in vertex shaders." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Uploads the objects of the frame and fills the indirect commands, the batches are rebuilt when objects were added.
+// Commands must have been built with gpu_culling set.
+void GpuCulling::cull(Scene const& scene, FrameCommands const& commands)
+{
+	if (scene.objects().size() != m_object_count)
+		build(scene);
+	if (m_batches.empty() || commands.gpu_objects.size() != m_object_count)
+		return;
+
+	// Orphaned, the draws of the previous frame may still read the old storage
+	const GLsizeiptr objects_size(static_cast<GLsizeiptr>(m_object_count * sizeof(GpuObjectBlock)));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objects.id());
+	glBufferData(GL_SHADER_STORAGE_BUFFER, objects_size, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, objects_size, commands.gpu_objects.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, m_command_template.id());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_commands.id());
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(m_batches.size() * sizeof(DrawCommand)));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, s_objects_binding, m_objects.id());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, s_records_binding, m_records.id());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, s_commands_binding, m_commands.id());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, s_instances_binding, m_instances.id());
+
+	const Frustum frustum(commands.projection * commands.view);
+	m_cull_shader.use();
+	glUniform4fv(glGetUniformLocation(m_cull_shader.id(), "frustum_planes"), 6, &frustum.planes()[0].x);
+	m_cull_shader.setUni("object_count", static_cast<unsigned int>(m_object_count));
+	glDispatchCompute(static_cast<GLuint>((m_object_count + s_group_size - 1) / s_group_size), 1, 1);
+
+	// The commands are read as indirect parameters, the instances by the vertex shader
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+// Issues every batch, with drawShader() in use and the opaque pass' state set. Batches with no visible instance cost
+// an empty indirect draw.
+void GpuCulling::draw() const
+{
+	if (m_batches.empty())
+		return;
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commands.id());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, s_objects_binding, m_objects.id());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, s_instances_binding, m_instances.id());
+
+	const GLint instance_offset(glGetUniformLocation(m_draw_shader.id(), "instance_offset"));
+	Profiler::beginIndirectCount();
+	for (size_t i = 0; i < m_batches.size(); i++) {
+		glUniform1ui(instance_offset, m_batches[i].first_instance);
+		m_batches[i].mesh->DrawIndirect(m_draw_shader, static_cast<GLintptr>(i * sizeof(DrawCommand)));
+	}
+	Profiler::endIndirectCount();
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+// Same batches for the depth pre-pass, with depthShader() in use
+void GpuCulling::drawDepth() const
+{
+	if (m_batches.empty())
+		return;
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commands.id());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, s_objects_binding, m_objects.id());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, s_instances_binding, m_instances.id());
+
+	const GLint instance_offset(glGetUniformLocation(m_depth_shader.id(), "instance_offset"));
+	Profiler::beginIndirectCount();
+	for (size_t i = 0; i < m_batches.size(); i++) {
+		glUniform1ui(instance_offset, m_batches[i].first_instance);
+		m_batches[i].mesh->DrawDepthIndirect(static_cast<GLintptr>(i * sizeof(DrawCommand)));
+	}
+	Profiler::endIndirectCount();
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+
+Shader& GpuCulling::cullShader()
+{
+	return m_cull_shader;
+}
+
+Shader& GpuCulling::drawShader()
+{
+	return m_draw_shader;
+}
+
+Shader& GpuCulling::depthShader()
+{
+	return m_depth_shader;
+}
+
+
+// Every mesh of a model drawn by the pass is a batch, with room in the instance list for every object using the model
+void GpuCulling::build(Scene const& scene)
+{
+	std::vector<SceneObject> const& objects(scene.objects());
+	m_object_count = objects.size();
+	m_batches.clear();
+
+	std::vector<Model const*> models;
+	std::vector<GLuint> model_objects;
+	std::vector<size_t> object_models(objects.size(), 0);
+	for (size_t i = 0; i < objects.size(); i++) {
+		if (!gpuDrawn(objects[i]))
+			continue;
+
+		size_t model(0);
+		while (model < models.size() && models[model] != objects[i].model)
+			model++;
+		if (model == models.size()) {
+			models.push_back(objects[i].model);
+			model_objects.push_back(0);
+		}
+		model_objects[model]++;
+		object_models[i] = model;
+	}
+
+	std::vector<GLuint> model_batches(models.size());
+	std::vector<DrawCommand> commands;
+	GLuint instance_count(0);
+	for (size_t model = 0; model < models.size(); model++) {
+		model_batches[model] = static_cast<GLuint>(m_batches.size());
+		for (Mesh const& mesh : models[model]->meshes()) {
+			m_batches.push_back({ &mesh, instance_count });
+			commands.push_back({ static_cast<GLuint>(mesh.indexCount()), 0, 0, 0, instance_count });
+			instance_count += model_objects[model];
+		}
+	}
+
+	std::vector<std::array<GLuint, 2>> records(objects.size(), { 0, 0 });
+	for (size_t i = 0; i < objects.size(); i++)
+		if (gpuDrawn(objects[i]))
+			records[i] = { model_batches[object_models[i]], static_cast<GLuint>(models[object_models[i]]->meshes().size()) };
+
+	const auto upload = [](GLBuffer const& buffer, GLsizeiptr const& size, void const* data, GLenum const& usage) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer.id());
+		glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, usage);
+	};
+	upload(m_records, static_cast<GLsizeiptr>(records.size() * sizeof(records[0])), records.data(), GL_STATIC_DRAW);
+	upload(m_command_template, static_cast<GLsizeiptr>(commands.size() * sizeof(DrawCommand)), commands.data(), GL_STATIC_DRAW);
+	upload(m_commands, static_cast<GLsizeiptr>(commands.size() * sizeof(DrawCommand)), nullptr, GL_DYNAMIC_COPY);
+	upload(m_instances, static_cast<GLsizeiptr>(instance_count * sizeof(GLuint)), nullptr, GL_DYNAMIC_COPY);
+	upload(m_objects, static_cast<GLsizeiptr>(m_object_count * sizeof(GpuObjectBlock)), nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	std::cout << "GPU culling: " << m_batches.size() << " batches, " << instance_count << " instances." << std::endl;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GLHandle.h"
+#include "Mesh.h"
+#include "Scene.h"
+#include "Shader.h"
+
+
+// GPU-driven opaque pass (GL 4.3): the objects drawn by gpuDrawn() are uploaded every frame along with their bounds,
+// a compute shader frustum culls them and appends the visible ones to an instance list per mesh while counting them in
+// that mesh's indirect command. Submission is then one glDrawElementsIndirect per mesh, whatever the number of objects.
+class GpuCulling
+{
+public:
+	explicit GpuCulling(std::string const& shaders_directory);
+
+	bool valid() const;
+
+	void cull(Scene const& scene, FrameCommands const& commands);
+	void draw() const;
+	void drawDepth() const;
+
+	// Exposed for hot reloading
+	Shader& cullShader();
+	Shader& drawShader(); // the opaque pass' uniforms and blocks must be set on it as on the CPU path's program
+	Shader& depthShader();
+
+private:
+	struct Batch {
+		Mesh const* mesh;
+		GLuint first_instance; // in the instance list, also the command's baseInstance
+	};
+
+	// Mirrors DrawElementsIndirectCommand, and DrawCommand in gpu_culling.comp
+	struct DrawCommand {
+		GLuint count;
+		GLuint instance_count;
+		GLuint first_index;
+		GLint base_vertex;
+		GLuint base_instance;
+	};
+
+	static constexpr GLuint s_objects_binding = 0, s_records_binding = 1, s_commands_binding = 2, s_instances_binding = 3;
+	static constexpr GLuint s_group_size = 64; // local_size_x of gpu_culling.comp
+
+	void build(Scene const& scene);
+
+	Shader m_cull_shader;
+	Shader m_draw_shader;
+	Shader m_depth_shader;
+
+	std::vector<Batch> m_batches; // the meshes of a model are consecutive
+	size_t m_object_count; // of the scene when the batches were built
+
+	GLBuffer m_objects; // GpuObjectBlock per scene object, uploaded every frame
+	GLBuffer m_records; // first batch and batch count per scene object, 0 batches for the ones not drawn here
+	GLBuffer m_command_template; // every command with no instance, copied over m_commands before culling
+	GLBuffer m_commands;
+	GLBuffer m_instances; // visible object indices, grouped by batch
+};
@@ -0,0 +1,223 @@
+#include "JobSystem.h"
+
+#include <iostream>
+
+
+namespace
+{
+	// Index of the worker running on this thread, -1 for other threads
+	thread_local int t_worker_index(-1);
+
+	constexpr size_t QUEUE_CAPACITY = 256; // grown when needed
+}
+
+
+Job::Job(void (*const run)(void*), void (*const destroy)(void*), void* const task) : m_run(run), m_destroy(destroy), m_task(task),
+	m_pending(1), m_done(false), m_mutex(), m_dependents(nullptr)
+{
+}
+
+Job::~Job()
+{
+	for (Dependent* dependent = m_dependents; dependent; dependent = dependent->next)
+		dependent->~Dependent();
+	m_destroy(m_task);
+}
+
+bool Job::done() const
+{
+	return m_done.load(std::memory_order_acquire);
+}
+
+
+JobSystem::WorkerQueue::WorkerQueue() : mutex(), jobs(QUEUE_CAPACITY), head(0), count(0)
+{
+}
+
+void JobSystem::WorkerQueue::pushBack(std::shared_ptr<Job> const& job)
+{
+	if (count == jobs.size()) {
+		std::vector<std::shared_ptr<Job>> grown(jobs.size() * 2);
+		for (size_t i = 0; i < count; i++)
+			grown[i] = std::move(jobs[(head + i) % jobs.size()]);
+		jobs.swap(grown);
+		head = 0;
+	}
+
+	jobs[(head + count++) % jobs.size()] = job;
+}
+
+std::shared_ptr<Job> JobSystem::WorkerQueue::popBack()
+{
+	if (count == 0)
+		return nullptr;
+
+	return std::move(jobs[(head + --count) % jobs.size()]);
+}
+
+std::shared_ptr<Job> JobSystem::WorkerQueue::popFront()
+{
+	if (count == 0)
+		return nullptr;
+
+	std::shared_ptr<Job> job(std::move(jobs[head]));
+	head = (head + 1) % jobs.size();
+	count--;
+	return job;
+}
+
+
+// With no worker count given, uses every core but the one running the calling thread
+JobSystem::JobSystem(unsigned int const& worker_count) : m_queues(), m_workers(), m_running(true), m_queued(0), m_live_jobs(0), m_sleep_mutex(), m_wake()
+{
+	unsigned int count(worker_count);
+	if (count == 0)
+		count = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+	for (unsigned int i = 0; i <= count; i++)
+		m_queues.emplace_back(new WorkerQueue());
+
+	for (unsigned int i = 0; i < count; i++)
+		m_workers.emplace_back(&JobSystem::workerLoop, this, i);
+
+	std::cout << "Job system started with " << count << " worker thread(s)." << std::endl;
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleep_mutex);
+		m_running = false;
+	}
+	m_wake.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+
+// Runs queued jobs on the calling thread until the given one is done
+void JobSystem::wait(std::shared_ptr<Job> const& job)
+{
+	const size_t index(queueIndex());
+
+	while (!job->done()) {
+		std::shared_ptr<Job> other(pop(index));
+		if (other)
+			execute(other);
+		else
+			std::this_thread::yield();
+	}
+}
+
+// Returns once every job has been destroyed and deallocated, the workers may still hold the last references of finished jobs
+// for a moment. Afterwards, the frame arenas the jobs were scheduled from can be reset.
+void JobSystem::waitReleased()
+{
+	while (m_live_jobs.load(std::memory_order_acquire) > 0)
+		std::this_thread::yield();
+}
+
+
+unsigned int JobSystem::workerCount() const
+{
+	return static_cast<unsigned int>(m_workers.size());
+}
+
+
+void JobSystem::addDependency(std::shared_ptr<Job> const& job, std::shared_ptr<Job> const& dependency)
+{
+	if (!dependency)
+		return;
+
+	std::lock_guard<std::mutex> lock(dependency->m_mutex);
+	if (!dependency->done()) {
+		job->m_pending.fetch_add(1, std::memory_order_relaxed);
+		dependency->m_dependents = FrameArena::local().create<Job::Dependent>(Job::Dependent{ job, dependency->m_dependents });
+	}
+}
+
+void JobSystem::submit(std::shared_ptr<Job> const& job)
+{
+	if (job->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		enqueue(job);
+}
+
+
+void JobSystem::workerLoop(unsigned int const& index)
+{
+	t_worker_index = static_cast<int>(index);
+
+	while (m_running.load(std::memory_order_acquire)) {
+		std::shared_ptr<Job> job(pop(index));
+		if (job) {
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleep_mutex);
+		m_wake.wait(lock, [this]() { return m_queued.load(std::memory_order_acquire) > 0 || !m_running.load(std::memory_order_acquire); });
+	}
+}
+
+void JobSystem::enqueue(std::shared_ptr<Job> const& job)
+{
+	WorkerQueue& queue(*m_queues[queueIndex()]);
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.pushBack(job);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_sleep_mutex);
+		m_queued.fetch_add(1, std::memory_order_release);
+	}
+	m_wake.notify_one();
+}
+
+// Newest job of our own queue first (better cache locality), otherwise the oldest job of another queue
+std::shared_ptr<Job> JobSystem::pop(size_t const& index)
+{
+	std::shared_ptr<Job> job;
+
+	{
+		WorkerQueue& queue(*m_queues[index]);
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		job = queue.popBack();
+	}
+
+	for (size_t i = 1; !job && i < m_queues.size(); i++) {
+		WorkerQueue& victim(*m_queues[(index + i) % m_queues.size()]);
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		job = victim.popFront();
+	}
+
+	if (job)
+		m_queued.fetch_sub(1, std::memory_order_acq_rel);
+
+	return job;
+}
+
+void JobSystem::execute(std::shared_ptr<Job> const& job)
+{
+	job->m_run(job->m_task);
+
+	Job::Dependent* dependents(nullptr);
+	{
+		std::lock_guard<std::mutex> lock(job->m_mutex);
+		job->m_done.store(true, std::memory_order_release);
+		std::swap(dependents, job->m_dependents);
+	}
+
+	// The links stay in the arena, only their references are released
+	for (Job::Dependent* dependent = dependents; dependent; dependent = dependent->next) {
+		if (dependent->job->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			enqueue(dependent->job);
+		dependent->~Dependent();
+	}
+}
+
+size_t JobSystem::queueIndex() const
+{
+	return t_worker_index >= 0 ? static_cast<size_t>(t_worker_index) : m_queues.size() - 1;
+}
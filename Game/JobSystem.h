@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "FrameArena.h"
+
+
+// Unit of work, only queued once every job it depends on has completed.
+// Jobs, their tasks and their dependency links live in the frame arena of the thread that scheduled them.
+class Job
+{
+public:
+	Job(void (*const run)(void*), void (*const destroy)(void*), void* const task);
+	~Job();
+
+	bool done() const;
+
+private:
+	friend class JobSystem;
+
+	struct Dependent {
+		std::shared_ptr<Job> job;
+		Dependent* next;
+	};
+
+	void (*m_run)(void*);
+	void (*m_destroy)(void*);
+	void* m_task;
+	std::atomic<int> m_pending; // unfinished dependencies, plus one until scheduling is over
+	std::atomic<bool> m_done;
+
+	std::mutex m_mutex; // guards m_dependents against this job completing while a dependent registers
+	Dependent* m_dependents;
+};
+
+
+// Work-stealing job system: each worker owns a queue it pops from the back, idle workers steal from the front of the others.
+// Threads that aren't workers push to a shared queue and help executing jobs while they wait().
+class JobSystem
+{
+public:
+	explicit JobSystem(unsigned int const& worker_count = 0);
+	~JobSystem();
+
+	template <typename Task>
+	std::shared_ptr<Job> schedule(Task&& task, std::initializer_list<std::shared_ptr<Job>> const& dependencies = {});
+	template <typename Task>
+	std::shared_ptr<Job> parallelFor(size_t const& count, size_t const& chunk_size, Task&& task, std::initializer_list<std::shared_ptr<Job>> const& dependencies = {});
+	void wait(std::shared_ptr<Job> const& job);
+	void waitReleased();
+
+	unsigned int workerCount() const;
+
+private:
+	// Frame arena allocator that counts the blocks not deallocated yet, the last use of a job's memory being its deallocation
+	template <typename T>
+	class JobAllocator : public ArenaAllocator<T>
+	{
+	public:
+		JobAllocator(FrameArena& arena, std::atomic<int>& live) : ArenaAllocator<T>(arena), m_live(&live) {}
+		template <typename U>
+		JobAllocator(JobAllocator<U> const& other) : ArenaAllocator<T>(other), m_live(other.m_live) {}
+
+		T* allocate(size_t const count) { m_live->fetch_add(1, std::memory_order_relaxed); return ArenaAllocator<T>::allocate(count); }
+		void deallocate(T* const pointer, size_t const count) { ArenaAllocator<T>::deallocate(pointer, count); m_live->fetch_sub(1, std::memory_order_release); }
+
+	private:
+		template <typename U>
+		friend class JobAllocator;
+
+		std::atomic<int>* m_live;
+	};
+
+	// A ring rather than a std::deque, which allocates and frees its blocks as jobs go through it
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::vector<std::shared_ptr<Job>> jobs;
+		size_t head;
+		size_t count;
+
+		WorkerQueue();
+		void pushBack(std::shared_ptr<Job> const& job);
+		std::shared_ptr<Job> popBack();
+		std::shared_ptr<Job> popFront();
+	};
+
+	template <typename Task>
+	struct RangeTask {
+		Task task;
+		void operator()() const {}
+	};
+
+	template <typename Task>
+	std::shared_ptr<Job> create(Task&& task);
+	void addDependency(std::shared_ptr<Job> const& job, std::shared_ptr<Job> const& dependency);
+	void submit(std::shared_ptr<Job> const& job);
+
+	void workerLoop(unsigned int const& index);
+	void enqueue(std::shared_ptr<Job> const& job);
+	std::shared_ptr<Job> pop(size_t const& index);
+	void execute(std::shared_ptr<Job> const& job);
+	size_t queueIndex() const;
+
+	std::vector<std::unique_ptr<WorkerQueue>> m_queues; // one per worker, the last one being shared by other threads
+	std::vector<std::thread> m_workers;
+
+	std::atomic<bool> m_running;
+	std::atomic<int> m_queued;
+	std::atomic<int> m_live_jobs; // allocated and not released yet
+	std::mutex m_sleep_mutex;
+	std::condition_variable m_wake;
+};
+
+
+template <typename Task>
+std::shared_ptr<Job> JobSystem::schedule(Task&& task, std::initializer_list<std::shared_ptr<Job>> const& dependencies)
+{
+	std::shared_ptr<Job> job(create(std::forward<Task>(task)));
+
+	for (std::shared_ptr<Job> const& dependency : dependencies)
+		addDependency(job, dependency);
+	submit(job);
+
+	return job;
+}
+
+// Splits [0, count) in chunks processed in parallel, the returned job completes once every chunk is done.
+// The task is called as task(begin, end).
+template <typename Task>
+std::shared_ptr<Job> JobSystem::parallelFor(size_t const& count, size_t const& chunk_size, Task&& task, std::initializer_list<std::shared_ptr<Job>> const& dependencies)
+{
+	// The chunks call the task kept by the returned job, which outlives them as their dependent
+	using Range = RangeTask<typename std::decay<Task>::type>;
+	std::shared_ptr<Job> join(create(Range{ std::forward<Task>(task) }));
+	Range const* const range(static_cast<Range const*>(join->m_task));
+	const size_t size(std::max<size_t>(1, chunk_size));
+
+	for (size_t begin = 0; begin < count; begin += size) {
+		const size_t end(std::min(count, begin + size));
+		std::shared_ptr<Job> chunk(create([range, begin, end]() { range->task(begin, end); }));
+
+		for (std::shared_ptr<Job> const& dependency : dependencies)
+			addDependency(chunk, dependency);
+		addDependency(join, chunk);
+		submit(chunk);
+	}
+
+	if (count == 0)
+		for (std::shared_ptr<Job> const& dependency : dependencies)
+			addDependency(join, dependency);
+	submit(join);
+
+	return join;
+}
+
+// The job isn't queued until submit()
+template <typename Task>
+std::shared_ptr<Job> JobSystem::create(Task&& task)
+{
+	using Stored = typename std::decay<Task>::type;
+
+	FrameArena& arena(FrameArena::local());
+	Stored* const stored(arena.create<Stored>(std::forward<Task>(task)));
+
+	return std::allocate_shared<Job>(JobAllocator<Job>(arena, m_live_jobs),
+		[](void* const pointer) { (*static_cast<Stored*>(pointer))(); },
+		[](void* const pointer) { static_cast<Stored*>(pointer)->~Stored(); },
+		stored);
+}
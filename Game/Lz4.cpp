@@ -0,0 +1,161 @@
+#include "Lz4.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+namespace
+{
+	constexpr size_t MIN_MATCH = 4;
+	constexpr size_t LAST_LITERALS = 5; // the block always ends with literals
+	constexpr size_t MATCH_START_LIMIT = 12; // no match starts in the last 12 bytes
+	constexpr size_t MAX_OFFSET = 65535;
+	constexpr unsigned int HASH_BITS = 16;
+
+	inline uint32_t read32(unsigned char const* bytes)
+	{
+		uint32_t value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	inline uint32_t hash(uint32_t const& sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	// Lengths past the 4 bits of the token continue as bytes of 255 and a last smaller one
+	inline unsigned char* writeLength(unsigned char* output, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+			*output++ = 255;
+		*output++ = static_cast<unsigned char>(length);
+		return output;
+	}
+
+	inline bool readLength(unsigned char const*& input, unsigned char const* const end, size_t& length)
+	{
+		unsigned char byte;
+		do {
+			if (input == end)
+				return false;
+			byte = *input++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+
+	unsigned char* writeSequence(unsigned char* output, unsigned char const* literals, size_t const& literal_count, size_t const& offset, size_t const& match_length)
+	{
+		unsigned char* const token(output++);
+		*token = static_cast<unsigned char>(std::min<size_t>(literal_count, 15) << 4);
+		if (literal_count >= 15)
+			output = writeLength(output, literal_count - 15);
+		if (literal_count > 0)
+			std::memcpy(output, literals, literal_count);
+		output += literal_count;
+
+		// The last sequence has no match
+		if (match_length == 0)
+			return output;
+
+		*output++ = static_cast<unsigned char>(offset & 0xFF);
+		*output++ = static_cast<unsigned char>(offset >> 8);
+		const size_t length(match_length - MIN_MATCH);
+		*token |= static_cast<unsigned char>(std::min<size_t>(length, 15));
+		if (length >= 15)
+			output = writeLength(output, length - 15);
+		return output;
+	}
+}
+
+
+size_t Lz4::bound(size_t const& size)
+{
+	return size + size / 255 + 16;
+}
+
+size_t Lz4::compress(unsigned char const* source, size_t const& size, unsigned char* destination)
+{
+	unsigned char* output(destination);
+	unsigned char const* anchor(source); // first byte not encoded yet
+
+	if (size > MATCH_START_LIMIT) {
+		std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0); // last position of each hashed sequence
+		unsigned char const* const match_end_limit(source + size - LAST_LITERALS);
+		unsigned char const* const match_start_limit(source + size - MATCH_START_LIMIT);
+
+		unsigned char const* position(source);
+		while (position <= match_start_limit) {
+			const uint32_t sequence(read32(position));
+			uint32_t& slot(table[hash(sequence)]);
+			unsigned char const* const candidate(source + slot);
+			slot = static_cast<uint32_t>(position - source);
+
+			if (candidate >= position || static_cast<size_t>(position - candidate) > MAX_OFFSET || read32(candidate) != sequence) {
+				position++;
+				continue;
+			}
+
+			unsigned char const* match_end(position + MIN_MATCH);
+			while (match_end < match_end_limit && *match_end == candidate[match_end - position])
+				match_end++;
+
+			output = writeSequence(output, anchor, static_cast<size_t>(position - anchor), static_cast<size_t>(position - candidate), static_cast<size_t>(match_end - position));
+			position = match_end;
+			anchor = position;
+		}
+	}
+
+	output = writeSequence(output, anchor, static_cast<size_t>(source + size - anchor), 0, 0);
+	return static_cast<size_t>(output - destination);
+}
+
+bool Lz4::decompress(unsigned char const* source, size_t const& size, unsigned char* destination, size_t const& destination_size)
+{
+	unsigned char const* input(source);
+	unsigned char const* const input_end(source + size);
+	unsigned char* output(destination);
+	unsigned char* const output_end(destination + destination_size);
+
+	while (input != input_end) {
+		const unsigned char token(*input++);
+
+		size_t literal_count(token >> 4);
+		if (literal_count == 15 && !readLength(input, input_end, literal_count))
+			return false;
+		if (static_cast<size_t>(input_end - input) < literal_count || static_cast<size_t>(output_end - output) < literal_count)
+			return false;
+		if (literal_count > 0)
+			std::memcpy(output, input, literal_count);
+		input += literal_count;
+		output += literal_count;
+
+		if (input == input_end)
+			break;
+
+		if (input_end - input < 2)
+			return false;
+		const size_t offset(static_cast<size_t>(input[0]) | (static_cast<size_t>(input[1]) << 8));
+		input += 2;
+		if (offset == 0 || offset > static_cast<size_t>(output - destination))
+			return false;
+
+		size_t match_length(token & 15);
+		if (match_length == 15 && !readLength(input, input_end, match_length))
+			return false;
+		match_length += MIN_MATCH;
+		if (static_cast<size_t>(output_end - output) < match_length)
+			return false;
+
+		// Byte by byte, the match may overlap the bytes it produces
+		unsigned char const* match(output - offset);
+		for (size_t i = 0; i < match_length; i++)
+			output[i] = match[i];
+		output += match_length;
+	}
+
+	return output == output_end;
+}
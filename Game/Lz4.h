@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+
+// LZ4 block format (no frame header nor checksum), for the compressed entries of packed archives. The compressor is the
+// simple greedy one: fast enough when packing, and the output is decoded by any LZ4 implementation.
+namespace Lz4
+{
+	// Largest compressed size of size bytes
+	size_t bound(size_t const& size);
+
+	// A decompressed block is less than this many times larger than its compressed size: at best, every byte of a match
+	// length extension adds 255 bytes
+	constexpr size_t MAX_EXPANSION = 255;
+
+	// destination must hold bound(size) bytes, returns the compressed size
+	size_t compress(unsigned char const* source, size_t const& size, unsigned char* destination);
+
+	// Fails on malformed input or when the output doesn't exactly fill destination_size bytes
+	bool decompress(unsigned char const* source, size_t const& size, unsigned char* destination, size_t const& destination_size);
+}
@@ -0,0 +1,51 @@
+#include "Material.h"
+
+#include "Profiler.h"
+
+
+uint32_t Material::s_next_id = 0;
+
+
+Material::Material(Texture const* diffuse, Texture const* specular, GLuint const& sampler, float const& shininess) : m_id(s_next_id++),
+	m_diffuse(diffuse ? diffuse->id() : 0), m_specular(specular ? specular->id() : 0), m_sampler(sampler), m_shininess(shininess)
+{
+}
+
+Material::~Material()
+{
+}
+
+
+// Shader must be in use
+void Material::bind(Shader const& shader) const
+{
+	glActiveTexture(GL_TEXTURE0 + MATERIAL_DIFFUSE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, m_diffuse);
+	glBindSampler(MATERIAL_DIFFUSE_UNIT, m_sampler);
+
+	glActiveTexture(GL_TEXTURE0 + MATERIAL_SPECULAR_UNIT);
+	glBindTexture(GL_TEXTURE_2D, m_specular);
+	glBindSampler(MATERIAL_SPECULAR_UNIT, m_sampler);
+	glActiveTexture(GL_TEXTURE0);
+
+	// -1 for programs without the uniform, which GL ignores
+	glUniform1f(shader.materialSlots().shininess, m_shininess);
+
+	Profiler::countStateChange(2);
+}
+
+// Releases the material units, whose sampler objects would otherwise override the filtering of the textures bound there afterwards
+void Material::unbind()
+{
+	for (GLuint unit : { MATERIAL_DIFFUSE_UNIT, MATERIAL_SPECULAR_UNIT }) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindSampler(unit, 0);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
+
+uint32_t Material::id() const
+{
+	return m_id;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+#include <GL/glew.h>
+
+#include "Shader.h"
+#include "Texture.h"
+
+
+// Texture units of the material samplers, assigned to the programs once when they're set up
+constexpr GLuint MATERIAL_DIFFUSE_UNIT = 0, MATERIAL_SPECULAR_UNIT = 1;
+
+
+// Textures and parameters of a surface, resolved when the model is loaded and shared by its meshes.
+// Binding one only issues integer GL calls; ids are unique, so materials can be compared and sorted by id.
+class Material
+{
+public:
+	Material(Texture const* diffuse, Texture const* specular, GLuint const& sampler, float const& shininess);
+	~Material();
+
+	void bind(Shader const& shader) const;
+	static void unbind();
+
+	uint32_t id() const;
+
+private:
+	static uint32_t s_next_id;
+
+	uint32_t const m_id;
+	GLuint const m_diffuse; // texture names, 0 when missing
+	GLuint const m_specular;
+	GLuint const m_sampler;
+	float const m_shininess;
+};
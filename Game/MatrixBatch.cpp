@@ -0,0 +1,129 @@
+#include "MatrixBatch.h"
+
+#include <initializer_list>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MATRIX_BATCH_SSE
+#include <xmmintrin.h>
+#endif
+
+
+namespace
+{
+	// Columns of the cofactor matrix divided by the determinant, the inverse transpose of m
+	void normalMatrix(glm::mat4 const& m, std::array<glm::vec4, 3>& out)
+	{
+		const glm::vec3 c0(m[0]), c1(m[1]), c2(m[2]);
+		const glm::vec3 n0(glm::cross(c1, c2)), n1(glm::cross(c2, c0)), n2(glm::cross(c0, c1));
+		const float inv_det(1.f / glm::dot(c0, n0));
+
+		out[0] = glm::vec4(n0 * inv_det, 0.f);
+		out[1] = glm::vec4(n1 * inv_det, 0.f);
+		out[2] = glm::vec4(n2 * inv_det, 0.f);
+	}
+
+#ifdef MATRIX_BATCH_SSE
+	struct Vec3x4 {
+		__m128 x, y, z;
+	};
+
+	inline Vec3x4 cross(Vec3x4 const& a, Vec3x4 const& b)
+	{
+		return {
+			_mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+			_mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+			_mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x))
+		};
+	}
+
+	// Column `column` of four matrices, one object per lane
+	inline Vec3x4 loadColumns(glm::mat4 const* models, int const& column)
+	{
+		__m128 c0(_mm_loadu_ps(&models[0][column][0])), c1(_mm_loadu_ps(&models[1][column][0])),
+			c2(_mm_loadu_ps(&models[2][column][0])), c3(_mm_loadu_ps(&models[3][column][0]));
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		return { c0, c1, c2 };
+	}
+
+	inline void storeColumns(Vec3x4 const& column, std::array<glm::vec4, 3>* out, int const& index)
+	{
+		__m128 x(column.x), y(column.y), z(column.z), w(_mm_setzero_ps());
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_storeu_ps(&out[0][index][0], x);
+		_mm_storeu_ps(&out[1][index][0], y);
+		_mm_storeu_ps(&out[2][index][0], z);
+		_mm_storeu_ps(&out[3][index][0], w);
+	}
+#endif
+}
+
+
+void MatrixBatch::multiply(glm::mat4 const& lhs, glm::mat4 const* rhs, glm::mat4* out, size_t const& count)
+{
+#ifdef MATRIX_BATCH_SSE
+	const __m128 l0(_mm_loadu_ps(&lhs[0][0])), l1(_mm_loadu_ps(&lhs[1][0])), l2(_mm_loadu_ps(&lhs[2][0])), l3(_mm_loadu_ps(&lhs[3][0]));
+
+	for (size_t i = 0; i < count; i++) {
+		for (int column = 0; column < 4; column++) {
+			const float* const r(&rhs[i][column][0]);
+			__m128 result(_mm_mul_ps(l0, _mm_set1_ps(r[0])));
+			result = _mm_add_ps(result, _mm_mul_ps(l1, _mm_set1_ps(r[1])));
+			result = _mm_add_ps(result, _mm_mul_ps(l2, _mm_set1_ps(r[2])));
+			result = _mm_add_ps(result, _mm_mul_ps(l3, _mm_set1_ps(r[3])));
+			_mm_storeu_ps(&out[i][column][0], result);
+		}
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+		out[i] = lhs * rhs[i];
+#endif
+}
+
+void MatrixBatch::normalMatrices(glm::mat4 const* models, std::array<glm::vec4, 3>* out, size_t const& count)
+{
+	size_t i(0);
+
+#ifdef MATRIX_BATCH_SSE
+	for (; i + 4 <= count; i += 4) {
+		const Vec3x4 c0(loadColumns(models + i, 0)), c1(loadColumns(models + i, 1)), c2(loadColumns(models + i, 2));
+		Vec3x4 n0(cross(c1, c2)), n1(cross(c2, c0)), n2(cross(c0, c1));
+
+		const __m128 det(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c0.x, n0.x), _mm_mul_ps(c0.y, n0.y)), _mm_mul_ps(c0.z, n0.z)));
+		const __m128 inv_det(_mm_div_ps(_mm_set1_ps(1.f), det));
+		for (Vec3x4* n : { &n0, &n1, &n2 }) {
+			n->x = _mm_mul_ps(n->x, inv_det);
+			n->y = _mm_mul_ps(n->y, inv_det);
+			n->z = _mm_mul_ps(n->z, inv_det);
+		}
+
+		storeColumns(n0, out + i, 0);
+		storeColumns(n1, out + i, 1);
+		storeColumns(n2, out + i, 2);
+	}
+#endif
+
+	for (; i < count; i++)
+		normalMatrix(models[i], out[i]);
+}
+
+void MatrixBatch::squaredDistances(glm::mat4 const* models, glm::vec3 const& point, float* out, size_t const& count)
+{
+	size_t i(0);
+
+#ifdef MATRIX_BATCH_SSE
+	const __m128 px(_mm_set1_ps(point.x)), py(_mm_set1_ps(point.y)), pz(_mm_set1_ps(point.z));
+
+	for (; i + 4 <= count; i += 4) {
+		const Vec3x4 translations(loadColumns(models + i, 3));
+		const __m128 dx(_mm_sub_ps(translations.x, px)), dy(_mm_sub_ps(translations.y, py)), dz(_mm_sub_ps(translations.z, pz));
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+	}
+#endif
+
+	for (; i < count; i++) {
+		const glm::vec3 offset(glm::vec3(models[i][3]) - point);
+		out[i] = glm::dot(offset, offset);
+	}
+}
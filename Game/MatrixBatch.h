@@ -0,0 +1,23 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+
+// SSE implementations of the per-object matrix work, with scalar fallbacks on other architectures
+namespace MatrixBatch
+{
+	// out[i] = lhs * rhs[i], lhs being kept in registers for the whole batch
+	void multiply(glm::mat4 const& lhs, glm::mat4 const* rhs, glm::mat4* out, size_t const& count);
+
+	// Inverse transpose of the upper 3x3 of models[i], written as 3 std140 (vec4-padded) columns.
+	// Four matrices are transposed into SoA registers and inverted at once through their cofactors.
+	void normalMatrices(glm::mat4 const* models, std::array<glm::vec4, 3>* out, size_t const& count);
+
+	// Squared distance between point and the translation of models[i], four objects at a time
+	void squaredDistances(glm::mat4 const* models, glm::vec3 const& point, float* out, size_t const& count);
+}
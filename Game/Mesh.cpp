@@ -1,49 +1,131 @@
 #include "Mesh.h"
 
-Mesh::Mesh(std::vector<VertexStruct> const& vertices, std::vector<unsigned int> const& indices, std::vector<Texture *> const& textures) : m_vertices(vertices), m_indices(indices), m_textures(textures)
+#include <initializer_list>
+#include <utility>
+
+#include "Profiler.h"
+
+Mesh::Mesh(std::vector<VertexStruct> const& vertices, std::vector<unsigned int> const& indices, std::vector<Meshlet>&& meshlets, Material const* material,
+	bool const& position_stream, std::vector<SkinVertex> const& skin) :
+	m_index_count(static_cast<GLsizei>(indices.size())), m_material(material), m_meshlets(std::move(meshlets)), m_vao(), m_vbo(), m_ebo(), m_position_vao(), m_position_vbo(), m_skin_vbo()
 {
-	setupMesh();
+	setupMesh(vertices, indices);
+	if (position_stream)
+		setupPositionStream(vertices);
+	if (!skin.empty())
+		setupSkinStream(skin);
 }
 
 void Mesh::Draw(Shader const& shader, bool const& textures) const
 {
-	if (textures) {
-		unsigned int diffuse_nb = 1, specular_nb = 1;
-		for (size_t i = 0; i < m_textures.size(); i++) {
-			glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
-
-			unsigned int number;
-			std::string name = m_textures[i]->type();
-			if (name == "diffuse")
-				number = diffuse_nb++;
-			else if (name == "specular")
-				number = specular_nb++;
-
-			shader.setUni(("material." + name/* + std::to_string(number) */), static_cast<int>(i));
-			glBindTexture(GL_TEXTURE_2D, m_textures[i]->id());
-		}
-		glActiveTexture(GL_TEXTURE0);
-	}
+	if (textures && m_material)
+		m_material->bind(shader);
+
+	glBindVertexArray(m_vao.id());
+	glDrawElements(GL_TRIANGLES, m_index_count, GL_UNSIGNED_INT, 0);
+	glBindVertexArray(0);
+
+	Profiler::countStateChange();
+	Profiler::countDraw(m_index_count);
+}
+
+// Only the index ranges left by meshlet culling, nothing is bound when every meshlet was culled
+void Mesh::Draw(Shader const& shader, MeshletRanges const& ranges, MeshRanges const& mesh_ranges, bool const& textures) const
+{
+	if (mesh_ranges.count == 0)
+		return;
+
+	if (textures && m_material)
+		m_material->bind(shader);
+
+	glBindVertexArray(m_vao.id());
+	glMultiDrawElements(GL_TRIANGLES, &ranges.counts[mesh_ranges.first], GL_UNSIGNED_INT, &ranges.offsets[mesh_ranges.first], mesh_ranges.count);
+	glBindVertexArray(0);
+
+	GLsizei index_count(0);
+	for (GLsizei i = 0; i < mesh_ranges.count; i++)
+		index_count += ranges.counts[mesh_ranges.first + i];
+	Profiler::countStateChange();
+	Profiler::countDraw(index_count);
+}
+
+// The command is read from the buffer bound to GL_DRAW_INDIRECT_BUFFER, its instance count is only known by the GPU.
+// Its triangles are counted by the caller with Profiler::beginIndirectCount().
+void Mesh::DrawIndirect(Shader const& shader, GLintptr const& command_offset, bool const& textures) const
+{
+	if (textures && m_material)
+		m_material->bind(shader);
+
+	glBindVertexArray(m_vao.id());
+	glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<void const*>(command_offset));
+	glBindVertexArray(0);
 
+	Profiler::countStateChange();
+	Profiler::countDraw(0);
+}
 
-	glBindVertexArray(m_vao);
-	glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_indices.size()), GL_UNSIGNED_INT, 0);
+void Mesh::DrawDepth() const
+{
+	glBindVertexArray(depthVao());
+	glDrawElements(GL_TRIANGLES, m_index_count, GL_UNSIGNED_INT, 0);
 	glBindVertexArray(0);
+
+	Profiler::countDraw(m_index_count);
 }
 
+void Mesh::DrawDepth(MeshletRanges const& ranges, MeshRanges const& mesh_ranges) const
+{
+	if (mesh_ranges.count == 0)
+		return;
 
-void Mesh::setupMesh()
+	glBindVertexArray(depthVao());
+	glMultiDrawElements(GL_TRIANGLES, &ranges.counts[mesh_ranges.first], GL_UNSIGNED_INT, &ranges.offsets[mesh_ranges.first], mesh_ranges.count);
+	glBindVertexArray(0);
+
+	GLsizei index_count(0);
+	for (GLsizei i = 0; i < mesh_ranges.count; i++)
+		index_count += ranges.counts[mesh_ranges.first + i];
+	Profiler::countDraw(index_count);
+}
+
+void Mesh::DrawDepthIndirect(GLintptr const& command_offset) const
 {
-	glGenVertexArrays(1, &m_vao);
-	glBindVertexArray(m_vao);
+	glBindVertexArray(depthVao());
+	glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<void const*>(command_offset));
+	glBindVertexArray(0);
 
-	glGenBuffers(1, &m_vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(VertexStruct), m_vertices.data(), GL_STATIC_DRAW);
+	Profiler::countDraw(0);
+}
 
-	glGenBuffers(1, &m_ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(GLuint), m_indices.data(), GL_STATIC_DRAW);
+GLsizei Mesh::indexCount() const
+{
+	return m_index_count;
+}
+
+std::vector<Meshlet> const& Mesh::meshlets() const
+{
+	return m_meshlets;
+}
+
+
+GLuint Mesh::depthVao() const
+{
+	return m_position_vao ? m_position_vao.id() : m_vao.id();
+}
+
+
+void Mesh::setupMesh(std::vector<VertexStruct> const& vertices, std::vector<unsigned int> const& indices)
+{
+	m_vao = GLVertexArray::generate();
+	glBindVertexArray(m_vao.id());
+
+	m_vbo = GLBuffer::generate();
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo.id());
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(VertexStruct), vertices.data(), GL_STATIC_DRAW);
+
+	m_ebo = GLBuffer::generate();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo.id());
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
 
 	glVertexAttribPointer(VERTEX_POS_ATTR, 3, GL_FLOAT, GL_FALSE, sizeof(VertexStruct), reinterpret_cast<GLvoid*>(offsetof(VertexStruct, position)));
 	glEnableVertexAttribArray(VERTEX_POS_ATTR);
@@ -54,3 +136,46 @@ void Mesh::setupMesh()
 
 	glBindVertexArray(0);
 }
+
+// Only the position attribute is enabled, the interleaved stream would fetch the normal and texture coordinates for nothing
+void Mesh::setupPositionStream(std::vector<VertexStruct> const& vertices)
+{
+	std::vector<glm::vec3> positions;
+	positions.reserve(vertices.size());
+	for (VertexStruct const& vertex : vertices)
+		positions.push_back(vertex.position);
+
+	m_position_vao = GLVertexArray::generate();
+	glBindVertexArray(m_position_vao.id());
+
+	m_position_vbo = GLBuffer::generate();
+	glBindBuffer(GL_ARRAY_BUFFER, m_position_vbo.id());
+	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo.id());
+
+	glVertexAttribPointer(VERTEX_POS_ATTR, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), reinterpret_cast<GLvoid*>(0));
+	glEnableVertexAttribArray(VERTEX_POS_ATTR);
+
+	glBindVertexArray(0);
+}
+
+// Separate from the interleaved stream so that static meshes don't carry it. Bone indices stay integers in the shader.
+void Mesh::setupSkinStream(std::vector<SkinVertex> const& skin)
+{
+	m_skin_vbo = GLBuffer::generate();
+	glBindBuffer(GL_ARRAY_BUFFER, m_skin_vbo.id());
+	glBufferData(GL_ARRAY_BUFFER, skin.size() * sizeof(SkinVertex), skin.data(), GL_STATIC_DRAW);
+
+	for (GLuint const vao : { m_vao.id(), m_position_vao.id() }) {
+		if (!vao)
+			continue;
+
+		glBindVertexArray(vao);
+		glVertexAttribIPointer(VERTEX_BONES_ATTR, 4, GL_UNSIGNED_BYTE, sizeof(SkinVertex), reinterpret_cast<GLvoid*>(offsetof(SkinVertex, bones)));
+		glEnableVertexAttribArray(VERTEX_BONES_ATTR);
+		glVertexAttribPointer(VERTEX_WEIGHTS_ATTR, 4, GL_FLOAT, GL_FALSE, sizeof(SkinVertex), reinterpret_cast<GLvoid*>(offsetof(SkinVertex, weights)));
+		glEnableVertexAttribArray(VERTEX_WEIGHTS_ATTR);
+	}
+
+	glBindVertexArray(0);
+}
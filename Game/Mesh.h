@@ -5,8 +5,10 @@
 
 #include <glm\common.hpp>
 
+#include "GLHandle.h"
+#include "Material.h"
+#include "Meshlet.h"
 #include "Shader.h"
-#include "Texture.h"
 
 
 struct VertexStruct {
@@ -15,20 +17,47 @@ struct VertexStruct {
 	glm::vec2 tex_coords;
 };
 
-constexpr GLuint VERTEX_POS_ATTR = 0, VERTEX_NORMAL_ATTR = 1, VERTEX_TEX_ATTR = 2;
+// Second stream of the rigged meshes, the 4 most influential bones of the vertex with weights summing to 1
+struct SkinVertex {
+	GLubyte bones[4];
+	GLfloat weights[4];
+};
+
+constexpr GLuint VERTEX_POS_ATTR = 0, VERTEX_NORMAL_ATTR = 1, VERTEX_TEX_ATTR = 2, VERTEX_BONES_ATTR = 3, VERTEX_WEIGHTS_ATTR = 4;
 
 
+// Move-only, the vertices and indices only live in the GPU buffers once uploaded
 class Mesh {
 public:
-	Mesh(std::vector<VertexStruct> const& vertices, std::vector<unsigned int> const& indices, std::vector<Texture *> const& textures);
+	Mesh(std::vector<VertexStruct> const& vertices, std::vector<unsigned int> const& indices, std::vector<Meshlet>&& meshlets, Material const* material,
+		bool const& position_stream = false, std::vector<SkinVertex> const& skin = {});
 	void Draw(Shader const& shader, bool const& textures = true) const;
+	void Draw(Shader const& shader, MeshletRanges const& ranges, MeshRanges const& mesh_ranges, bool const& textures = true) const;
+	void DrawIndirect(Shader const& shader, GLintptr const& command_offset, bool const& textures = true) const;
+
+	// Depth only passes, from the position stream when the mesh has one
+	void DrawDepth() const;
+	void DrawDepth(MeshletRanges const& ranges, MeshRanges const& mesh_ranges) const;
+	void DrawDepthIndirect(GLintptr const& command_offset) const;
+
+	GLsizei indexCount() const;
+
+	std::vector<Meshlet> const& meshlets() const;
 
 private:
-	std::vector<VertexStruct> const m_vertices;
-	std::vector<GLuint> const m_indices;
-	std::vector<Texture *> const m_textures;
+	GLsizei m_index_count;
+	Material const* m_material; // owned by the model, nullptr when the mesh has none
+	std::vector<Meshlet> m_meshlets; // covering the whole index buffer
+
+	GLVertexArray m_vao;
+	GLBuffer m_vbo, m_ebo;
+	GLVertexArray m_position_vao; // tightly packed positions sharing m_ebo, fewer bytes fetched per vertex in depth only passes
+	GLBuffer m_position_vbo;
+	GLBuffer m_skin_vbo; // bound to both vertex arrays
 
-	unsigned int m_vao, m_vbo, m_ebo;
+	GLuint depthVao() const;
 
-	void setupMesh();
+	void setupMesh(std::vector<VertexStruct> const& vertices, std::vector<unsigned int> const& indices);
+	void setupPositionStream(std::vector<VertexStruct> const& vertices);
+	void setupSkinStream(std::vector<SkinVertex> const& skin);
 };
@@ -0,0 +1,233 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+
+MeshletRanges::MeshletRanges() : meshes(), counts(), offsets(), tested(0), visible(0)
+{
+}
+
+void MeshletRanges::clear()
+{
+	meshes.clear();
+	counts.clear();
+	offsets.clear();
+	tested = 0;
+	visible = 0;
+}
+
+// Returns the index of the first appended mesh
+size_t MeshletRanges::append(MeshletRanges const& other)
+{
+	const size_t first_mesh(meshes.size());
+	const size_t first_range(counts.size());
+
+	for (MeshRanges const& mesh : other.meshes)
+		meshes.push_back({ first_range + mesh.first, mesh.count });
+	counts.insert(counts.end(), other.counts.begin(), other.counts.end());
+	offsets.insert(offsets.end(), other.offsets.begin(), other.offsets.end());
+	tested += other.tested;
+	visible += other.visible;
+
+	return first_mesh;
+}
+
+
+namespace
+{
+	glm::vec3 triangleNormal(std::vector<VertexStruct> const& vertices, unsigned int const* triangle)
+	{
+		glm::vec3 const& a(vertices[triangle[0]].position);
+		const glm::vec3 normal(glm::cross(vertices[triangle[1]].position - a, vertices[triangle[2]].position - a));
+		const float length(glm::length(normal));
+		return length > 0.f ? normal / length : glm::vec3(0.f);
+	}
+
+	void computeBounds(Meshlet& meshlet, std::vector<VertexStruct> const& vertices, std::vector<unsigned int> const& indices)
+	{
+		unsigned int const* const begin(indices.data() + meshlet.first_index);
+		unsigned int const* const end(begin + meshlet.index_count);
+
+		glm::vec3 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+		for (unsigned int const* index = begin; index != end; index++) {
+			min = glm::min(min, vertices[*index].position);
+			max = glm::max(max, vertices[*index].position);
+		}
+		meshlet.center = (min + max) * .5f;
+		meshlet.radius = 0.f;
+		for (unsigned int const* index = begin; index != end; index++)
+			meshlet.radius = std::max(meshlet.radius, glm::length(vertices[*index].position - meshlet.center));
+
+		// Degenerate triangles aren't rasterized, they don't widen the cone
+		glm::vec3 normal_sum(0.f);
+		for (unsigned int const* triangle = begin; triangle != end; triangle += 3)
+			normal_sum += triangleNormal(vertices, triangle);
+		const float length(glm::length(normal_sum));
+		meshlet.cone_axis = length > 0.f ? normal_sum / length : glm::vec3(0.f, 0.f, 1.f);
+		meshlet.cone_cos = length > 0.f ? 1.f : -1.f;
+		for (unsigned int const* triangle = begin; triangle != end; triangle += 3) {
+			const glm::vec3 normal(triangleNormal(vertices, triangle));
+			if (normal != glm::vec3(0.f))
+				meshlet.cone_cos = std::min(meshlet.cone_cos, glm::dot(normal, meshlet.cone_axis));
+		}
+		meshlet.cone_sin = meshlet.cone_cos > 0.f ? std::sqrt(1.f - meshlet.cone_cos * meshlet.cone_cos) : 1.f;
+	}
+}
+
+
+// Greedy clustering: a meshlet grows by the neighbouring triangle adding the fewest vertices and closest to its average
+// facing, which keeps both its bounding sphere and its normal cone tight. When no neighbour fits anymore, it continues
+// with the next triangle in the original order, and a new meshlet starts when the vertex or triangle limit is reached.
+std::vector<Meshlet> Meshlets::build(std::vector<VertexStruct> const& vertices, std::vector<unsigned int>& indices)
+{
+	const size_t triangle_count(indices.size() / 3);
+	std::vector<Meshlet> meshlets;
+	if (triangle_count == 0)
+		return meshlets;
+
+	// Triangles using each vertex
+	std::vector<unsigned int> adjacency_offsets(vertices.size() + 1, 0);
+	for (size_t i = 0; i < triangle_count * 3; i++)
+		adjacency_offsets[indices[i] + 1]++;
+	for (size_t i = 0; i < vertices.size(); i++)
+		adjacency_offsets[i + 1] += adjacency_offsets[i];
+	std::vector<unsigned int> adjacency(triangle_count * 3);
+	{
+		std::vector<unsigned int> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+		for (size_t i = 0; i < triangle_count * 3; i++)
+			adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+	}
+
+	std::vector<glm::vec3> normals(triangle_count);
+	for (size_t i = 0; i < triangle_count; i++)
+		normals[i] = triangleNormal(vertices, &indices[i * 3]);
+
+	std::vector<bool> assigned(triangle_count, false);
+	std::vector<unsigned int> vertex_meshlet(vertices.size(), UINT32_MAX); // last meshlet using the vertex
+	std::vector<unsigned int> candidates; // unassigned neighbours of the current meshlet, possibly repeated
+	std::vector<unsigned int> ordered;
+	ordered.reserve(triangle_count * 3);
+	size_t next(0); // every triangle before it is assigned
+
+	const auto new_vertices = [&](unsigned int const& triangle, unsigned int const& meshlet) {
+		unsigned int count(0);
+		for (size_t k = 0; k < 3; k++)
+			if (vertex_meshlet[indices[triangle * 3 + k]] != meshlet)
+				count++;
+		return count;
+	};
+
+	while (true) {
+		while (next < triangle_count && assigned[next])
+			next++;
+		if (next == triangle_count)
+			break;
+
+		const unsigned int id(static_cast<unsigned int>(meshlets.size()));
+		Meshlet meshlet{};
+		meshlet.first_index = static_cast<GLuint>(ordered.size());
+		unsigned int vertex_count(0), meshlet_triangles(0);
+		glm::vec3 normal_sum(0.f);
+		candidates.clear();
+
+		unsigned int triangle(static_cast<unsigned int>(next));
+		while (true) {
+			assigned[triangle] = true;
+			for (size_t k = 0; k < 3; k++) {
+				const unsigned int vertex(indices[triangle * 3 + k]);
+				ordered.push_back(vertex);
+				if (vertex_meshlet[vertex] == id)
+					continue;
+
+				vertex_meshlet[vertex] = id;
+				vertex_count++;
+				for (unsigned int i = adjacency_offsets[vertex]; i < adjacency_offsets[vertex + 1]; i++)
+					if (!assigned[adjacency[i]])
+						candidates.push_back(adjacency[i]);
+			}
+			normal_sum += normals[triangle];
+			if (++meshlet_triangles == MAX_TRIANGLES)
+				break;
+
+			const float length(glm::length(normal_sum));
+			const glm::vec3 axis(length > 0.f ? normal_sum / length : glm::vec3(0.f));
+			unsigned int best(UINT32_MAX);
+			float best_score(std::numeric_limits<float>::max());
+			for (size_t i = 0; i < candidates.size();) {
+				const unsigned int candidate(candidates[i]);
+				if (assigned[candidate]) {
+					candidates[i] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+
+				const unsigned int added(new_vertices(candidate, id));
+				const float score(added + 1.f - glm::dot(normals[candidate], axis));
+				if (vertex_count + added <= MAX_VERTICES && score < best_score) {
+					best = candidate;
+					best_score = score;
+				}
+				i++;
+			}
+
+			if (best == UINT32_MAX) {
+				while (next < triangle_count && assigned[next])
+					next++;
+				if (next == triangle_count || vertex_count + new_vertices(static_cast<unsigned int>(next), id) > MAX_VERTICES)
+					break;
+				best = static_cast<unsigned int>(next);
+			}
+			triangle = best;
+		}
+
+		meshlet.index_count = static_cast<GLsizei>(ordered.size() - meshlet.first_index);
+		meshlets.push_back(meshlet);
+	}
+
+	indices.swap(ordered);
+	for (Meshlet& meshlet : meshlets)
+		computeBounds(meshlet, vertices, indices);
+
+	return meshlets;
+}
+
+
+// A meshlet is back-facing when the eye is behind the plane of each of its triangles, i.e. dot(n, p - eye) > 0 for every
+// normal n of its cone and point p of its sphere. The smallest value is d * cos(angle(axis, center - eye) + cone angle) - radius.
+unsigned int Meshlets::cull(std::vector<Meshlet> const& meshlets, Frustum const& frustum, glm::vec3 const& eye, bool const& cull_backfaces,
+	std::vector<GLsizei>& counts, std::vector<void const*>& offsets)
+{
+	unsigned int visible(0);
+	GLuint range_end(UINT32_MAX); // one past the last index of the last appended range
+
+	for (Meshlet const& meshlet : meshlets) {
+		if (!frustum.intersects(meshlet.center, meshlet.radius))
+			continue;
+
+		if (cull_backfaces && meshlet.cone_cos > 0.f) {
+			const glm::vec3 to_center(meshlet.center - eye);
+			const float along(glm::dot(to_center, meshlet.cone_axis));
+			const float across(std::sqrt(std::max(0.f, glm::dot(to_center, to_center) - along * along)));
+			if (along * meshlet.cone_cos - across * meshlet.cone_sin > meshlet.radius)
+				continue;
+		}
+
+		visible++;
+		if (meshlet.first_index == range_end)
+			counts.back() += meshlet.index_count;
+		else {
+			counts.push_back(meshlet.index_count);
+			offsets.push_back(reinterpret_cast<void const*>(static_cast<uintptr_t>(meshlet.first_index) * sizeof(GLuint)));
+		}
+		range_end = meshlet.first_index + static_cast<GLuint>(meshlet.index_count);
+	}
+
+	return visible;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/vec3.hpp>
+
+#include "Frustum.h"
+
+struct VertexStruct;
+
+
+// Cluster of neighbouring triangles, contiguous in the index buffer of its mesh
+struct Meshlet {
+	glm::vec3 center; // bounding sphere, in model space
+	float radius;
+	glm::vec3 cone_axis; // average facing of the triangles
+	float cone_cos, cone_sin; // of the widest angle between the axis and a triangle normal, cone_cos <= 0 when the cluster can't be entirely back-facing
+	GLuint first_index;
+	GLsizei index_count;
+};
+
+// Index ranges of a mesh left by meshlet culling, in MeshletRanges::counts and offsets
+struct MeshRanges {
+	size_t first;
+	GLsizei count;
+};
+
+// Culling output of a set of packets, each culled mesh being drawn by a single glMultiDrawElements
+struct MeshletRanges {
+	std::vector<MeshRanges> meshes;
+	std::vector<GLsizei> counts;
+	std::vector<void const*> offsets; // in bytes, into the element buffer
+	unsigned int tested, visible; // meshlets
+
+	MeshletRanges();
+
+	void clear();
+	size_t append(MeshletRanges const& other);
+};
+
+
+namespace Meshlets
+{
+	constexpr unsigned int MAX_VERTICES = 64, MAX_TRIANGLES = 124;
+
+	// Reorders the triangles so that every meshlet is contiguous in indices
+	std::vector<Meshlet> build(std::vector<VertexStruct> const& vertices, std::vector<unsigned int>& indices);
+
+	// Appends the index ranges of the meshlets intersecting the frustum and, when cull_backfaces, facing the eye, both in model space.
+	// Consecutive visible meshlets are merged into one range. Returns the number of visible meshlets.
+	unsigned int cull(std::vector<Meshlet> const& meshlets, Frustum const& frustum, glm::vec3 const& eye, bool const& cull_backfaces,
+		std::vector<GLsizei>& counts, std::vector<void const*>& offsets);
+}
@@ -1,10 +1,154 @@
 #include "Model.h"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+
 #include <assimp/Importer.hpp>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "FileSystem.h"
+#include "TextureStreamer.h"
+
+
+namespace
+{
+	// Assimp reads from the file, a copy is unavoidable but it doesn't open it anymore
+	class FileDataStream : public Assimp::IOStream
+	{
+	public:
+		explicit FileDataStream(FileData&& data) : m_data(std::move(data)), m_position(0)
+		{
+		}
+
+		size_t Read(void* buffer, size_t size, size_t count) override
+		{
+			if (size == 0)
+				return 0;
+
+			count = std::min(count, (m_data.size() - m_position) / size);
+			if (count > 0)
+				std::memcpy(buffer, m_data.data() + m_position, size * count);
+			m_position += size * count;
+			return count;
+		}
+
+		size_t Write(void const*, size_t, size_t) override
+		{
+			return 0;
+		}
+
+		aiReturn Seek(size_t offset, aiOrigin origin) override
+		{
+			const size_t base(origin == aiOrigin_SET ? 0 : origin == aiOrigin_CUR ? m_position : m_data.size());
+			if (base + offset > m_data.size())
+				return aiReturn_FAILURE;
+
+			m_position = base + offset;
+			return aiReturn_SUCCESS;
+		}
+
+		size_t Tell() const override
+		{
+			return m_position;
+		}
+
+		size_t FileSize() const override
+		{
+			return m_data.size();
+		}
+
+		void Flush() override
+		{
+		}
+
+	private:
+		FileData m_data;
+		size_t m_position;
+	};
+
+	// Lets Assimp open the model and the files it references (e.g. the .mtl of an .obj) through the FileSystem
+	class FileSystemIO : public Assimp::IOSystem
+	{
+	public:
+		bool Exists(char const* file) const override
+		{
+			return FileSystem::exists(file);
+		}
+
+		char getOsSeparator() const override
+		{
+			return '/';
+		}
+
+		Assimp::IOStream* Open(char const* file, char const* mode) override
+		{
+			if (std::strchr(mode, 'w') || std::strchr(mode, 'a'))
+				return nullptr;
+
+			FileData data(FileSystem::read(file));
+			return data.valid() ? new FileDataStream(std::move(data)) : nullptr;
+		}
+
+		void Close(Assimp::IOStream* file) override
+		{
+			delete file;
+		}
+	};
+
+	// Assimp matrices are row major
+	glm::mat4 toMat4(aiMatrix4x4 const& matrix)
+	{
+		return glm::transpose(glm::make_mat4(&matrix.a1));
+	}
+
+	// Index of the last key at or before time and the progress towards the next one, clamped to the first and last keys
+	template <typename Key>
+	size_t findKey(Key const* keys, unsigned int const& count, double const& time, float& alpha)
+	{
+		Key const* const next(std::upper_bound(keys, keys + count, time, [](double const& value, Key const& key) { return value < key.mTime; }));
+		alpha = 0.f;
+		if (next == keys)
+			return 0;
+		if (next == keys + count)
+			return count - 1;
+
+		Key const& previous(*(next - 1));
+		alpha = static_cast<float>((time - previous.mTime) / (next->mTime - previous.mTime));
+		return static_cast<size_t>(next - keys) - 1;
+	}
+
+	glm::vec3 sampleKeys(aiVectorKey const* keys, unsigned int const& count, double const& time, glm::vec3 const& fallback)
+	{
+		if (count == 0)
+			return fallback;
+
+		float alpha;
+		const size_t key(findKey(keys, count, time, alpha));
+		aiVector3D const& a(keys[key].mValue);
+		aiVector3D const& b(keys[std::min<size_t>(key + 1, count - 1)].mValue);
+		return glm::mix(glm::vec3(a.x, a.y, a.z), glm::vec3(b.x, b.y, b.z), alpha);
+	}
+
+	glm::quat sampleKeys(aiQuatKey const* keys, unsigned int const& count, double const& time, glm::quat const& fallback)
+	{
+		if (count == 0)
+			return fallback;
+
+		float alpha;
+		const size_t key(findKey(keys, count, time, alpha));
+		aiQuaternion const& a(keys[key].mValue);
+		aiQuaternion const& b(keys[std::min<size_t>(key + 1, count - 1)].mValue);
+		return glm::slerp(glm::quat(a.w, a.x, a.y, a.z), glm::quat(b.w, b.x, b.y, b.z), alpha);
+	}
+}
 
-#include "Texture.h"
 
 
 void Model::Draw(Shader const& shader, bool const& textures) const
@@ -13,10 +157,62 @@ void Model::Draw(Shader const& shader, bool const& textures) const
 		mesh.Draw(shader, textures);
 }
 
+// Meshlet culling output, ranges holds a MeshRanges per mesh from first_mesh on
+void Model::Draw(Shader const& shader, MeshletRanges const& ranges, size_t const& first_mesh, bool const& textures) const
+{
+	for (size_t i = 0; i < m_meshes.size(); i++)
+		m_meshes[i].Draw(shader, ranges, ranges.meshes[first_mesh + i], textures);
+}
+
+void Model::DrawDepth() const
+{
+	for (Mesh const& mesh : m_meshes)
+		mesh.DrawDepth();
+}
+
+void Model::DrawDepth(MeshletRanges const& ranges, size_t const& first_mesh) const
+{
+	for (size_t i = 0; i < m_meshes.size(); i++)
+		m_meshes[i].DrawDepth(ranges, ranges.meshes[first_mesh + i]);
+}
+
+
+glm::vec3 Model::center() const
+{
+	return m_center;
+}
+
+float Model::radius() const
+{
+	return m_radius;
+}
+
+std::vector<Mesh> const& Model::meshes() const
+{
+	return m_meshes;
+}
+
+std::vector<std::unique_ptr<Texture>> const& Model::textures() const
+{
+	return m_textures_loaded;
+}
+
+Skeleton const* Model::skeleton() const
+{
+	return m_skeleton.get();
+}
+
+std::vector<AnimationClip> const& Model::animations() const
+{
+	return m_animations;
+}
+
 void Model::loadModel(std::string const& path, GLuint const& texture_wrapping)
 {
 	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+	if (FileSystem::mounted())
+		importer.SetIOHandler(new FileSystemIO()); // owned by the importer
+	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_LimitBoneWeights);
 
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
 	{
@@ -24,7 +220,42 @@ void Model::loadModel(std::string const& path, GLuint const& texture_wrapping)
 		return;
 	}
 
+	// Overrides the parameters of the textures while they're bound to the material units
+	m_sampler = GLSampler::generate();
+	glSamplerParameteri(m_sampler.id(), GL_TEXTURE_WRAP_S, texture_wrapping);
+	glSamplerParameteri(m_sampler.id(), GL_TEXTURE_WRAP_T, texture_wrapping);
+	glSamplerParameteri(m_sampler.id(), GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glSamplerParameteri(m_sampler.id(), GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	float aniso(0.f);
+	glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &aniso);
+	glSamplerParameterf(m_sampler.id(), GL_TEXTURE_MAX_ANISOTROPY_EXT, aniso);
+	m_scene_materials.assign(scene->mNumMaterials, nullptr);
+
+	m_bounds_min = glm::vec3(std::numeric_limits<float>::max());
+	m_bounds_max = glm::vec3(std::numeric_limits<float>::lowest());
+
+	// Every node is a joint, bones are then picked by name among them
+	for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+		if (scene->mMeshes[i]->HasBones()) {
+			m_skeleton.reset(new Skeleton());
+			m_skeleton->root_inverse = glm::inverse(toMat4(scene->mRootNode->mTransformation));
+			addJoints(scene->mRootNode, -1);
+			break;
+		}
+	}
+
+	m_meshes.reserve(scene->mNumMeshes);
 	processNode(scene->mRootNode, scene, texture_wrapping);
+
+	if (m_skeleton && m_skeleton->bone_joints.empty())
+		m_skeleton.reset();
+	if (m_skeleton)
+		loadAnimations(scene);
+
+	if (m_meshes.empty())
+		return;
+	m_center = (m_bounds_min + m_bounds_max) * 0.5f;
+	m_radius = glm::length(m_bounds_max - m_center);
 }
 
 void Model::processNode(aiNode* const& node, const aiScene* scene, GLuint const& texture_wrapping)
@@ -43,7 +274,7 @@ Mesh Model::processMesh(aiMesh* const& mesh, const aiScene* scene, GLuint const&
 {
 	std::vector<VertexStruct> vertices;
 	std::vector<unsigned int> indices;
-	std::vector<Texture *> textures;
+	Material const* material(nullptr);
 
 
 	for (size_t i = 0; i < mesh->mNumVertices; i++)
@@ -55,6 +286,8 @@ Mesh Model::processMesh(aiMesh* const& mesh, const aiScene* scene, GLuint const&
 		vector.y = mesh->mVertices[i].y;
 		vector.z = mesh->mVertices[i].z;
 		vertex.position = vector;
+		m_bounds_min = glm::min(m_bounds_min, vector);
+		m_bounds_max = glm::max(m_bounds_max, vector);
 
 		vector.x = mesh->mNormals[i].x;
 		vector.y = mesh->mNormals[i].y;
@@ -83,22 +316,118 @@ Mesh Model::processMesh(aiMesh* const& mesh, const aiScene* scene, GLuint const&
 
 
 	if (mesh->mMaterialIndex > 0)
-	{
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+		material = loadMaterial(scene, mesh->mMaterialIndex, texture_wrapping);
 
-		std::vector<Texture *> const& diffuse_maps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "diffuse", texture_wrapping);
-		textures.insert(textures.end(), diffuse_maps.begin(), diffuse_maps.end());
+	std::vector<Meshlet> meshlets(Meshlets::build(vertices, indices));
+	return Mesh(vertices, indices, std::move(meshlets), material, m_position_stream, loadSkin(mesh));
+}
+
+// Depth first, so that parents come before their children
+void Model::addJoints(aiNode const* node, int const& parent)
+{
+	const size_t joint(m_skeleton->addJoint(node->mName.C_Str(), parent, toMat4(node->mTransformation)));
+	for (unsigned int i = 0; i < node->mNumChildren; i++)
+		addJoints(node->mChildren[i], static_cast<int>(joint));
+}
+
+// Keeps the 4 largest weights of every vertex and normalizes them, vertices without any follow the first bone
+std::vector<SkinVertex> Model::loadSkin(aiMesh const* mesh)
+{
+	std::vector<SkinVertex> skin;
+	if (!m_skeleton || !mesh->HasBones())
+		return skin;
+
+	skin.assign(mesh->mNumVertices, SkinVertex{ { 0, 0, 0, 0 }, { 0.f, 0.f, 0.f, 0.f } });
+	for (unsigned int i = 0; i < mesh->mNumBones; i++) {
+		aiBone const* const bone(mesh->mBones[i]);
+		const int joint(m_skeleton->find(bone->mName.C_Str()));
+		if (joint < 0)
+			continue;
+
+		const size_t index(m_skeleton->addBone(static_cast<size_t>(joint), toMat4(bone->mOffsetMatrix)));
+		if (index >= MAX_SKELETON_BONES) {
+			std::cout << "Bone \"" << bone->mName.C_Str() << "\" ignored, a skeleton can't have more than " << MAX_SKELETON_BONES << " bones." << std::endl;
+			continue;
+		}
+
+		for (unsigned int j = 0; j < bone->mNumWeights; j++) {
+			aiVertexWeight const& weight(bone->mWeights[j]);
+			SkinVertex& vertex(skin[weight.mVertexId]);
+			const size_t smallest(static_cast<size_t>(std::min_element(vertex.weights, vertex.weights + 4) - vertex.weights));
+			if (weight.mWeight > vertex.weights[smallest]) {
+				vertex.bones[smallest] = static_cast<GLubyte>(index);
+				vertex.weights[smallest] = weight.mWeight;
+			}
+		}
+	}
+
+	for (SkinVertex& vertex : skin) {
+		const float total(vertex.weights[0] + vertex.weights[1] + vertex.weights[2] + vertex.weights[3]);
+		if (total <= 0.f) {
+			vertex.weights[0] = 1.f;
+			continue;
+		}
+		for (GLfloat& weight : vertex.weights)
+			weight /= total;
+	}
+
+	return skin;
+}
+
+// Clips are resampled at a fixed rate, between keys positions and scales are interpolated linearly and rotations spherically
+void Model::loadAnimations(const aiScene* scene)
+{
+	for (unsigned int i = 0; i < scene->mNumAnimations; i++) {
+		aiAnimation const* const animation(scene->mAnimations[i]);
+		double ticks_per_second(animation->mTicksPerSecond);
+		if (ticks_per_second <= 0.)
+			ticks_per_second = s_default_ticks_per_second;
+		AnimationClip clip(animation->mName.C_Str(), *m_skeleton, static_cast<float>(animation->mDuration / ticks_per_second));
+
+		for (unsigned int j = 0; j < animation->mNumChannels; j++) {
+			aiNodeAnim const* const channel(animation->mChannels[j]);
+			const int found(m_skeleton->find(channel->mNodeName.C_Str()));
+			if (found < 0)
+				continue;
+
+			const size_t joint(static_cast<size_t>(found));
+			for (size_t frame = 0; frame < clip.frameCount(); frame++) {
+				const double ticks(clip.frameTime(frame) * ticks_per_second);
+				clip.setKey(frame, joint,
+					sampleKeys(channel->mPositionKeys, channel->mNumPositionKeys, ticks, m_skeleton->bind_translations[joint]),
+					sampleKeys(channel->mRotationKeys, channel->mNumRotationKeys, ticks, m_skeleton->bind_rotations[joint]),
+					sampleKeys(channel->mScalingKeys, channel->mNumScalingKeys, ticks, m_skeleton->bind_scales[joint]));
+			}
+		}
 
-		std::vector<Texture *> const& specular_maps = loadMaterialTextures(material, aiTextureType_SPECULAR, "specular", texture_wrapping);
-		textures.insert(textures.end(), specular_maps.begin(), specular_maps.end());
+		m_animations.push_back(std::move(clip));
 	}
+}
+
+// Meshes sharing an assimp material share the Material. The shader samples a single diffuse and specular map.
+Material const* Model::loadMaterial(const aiScene* scene, unsigned int const& index, GLuint const& texture_wrapping)
+{
+	if (m_scene_materials[index])
+		return m_scene_materials[index];
+
+	aiMaterial* material = scene->mMaterials[index];
+	std::vector<Texture const*> const diffuse_maps(loadMaterialTextures(material, aiTextureType_DIFFUSE, texture_wrapping));
+	std::vector<Texture const*> const specular_maps(loadMaterialTextures(material, aiTextureType_SPECULAR, texture_wrapping));
+
+	float shininess(0.f);
+	if (material->Get(AI_MATKEY_SHININESS, shininess) != AI_SUCCESS || shininess <= 0.f)
+		shininess = s_default_shininess;
+
+	m_materials.emplace_back(new Material(diffuse_maps.empty() ? nullptr : diffuse_maps.front(), specular_maps.empty() ? nullptr : specular_maps.front(),
+		m_sampler.id(), shininess));
+	m_scene_materials[index] = m_materials.back().get();
 
-	return Mesh(vertices, indices, textures);
+	return m_scene_materials[index];
 }
 
-std::vector<Texture *> Model::loadMaterialTextures(aiMaterial* const& material, aiTextureType const& type, std::string const& type_name, GLuint const& texture_wrapping)
+std::vector<Texture const*> Model::loadMaterialTextures(aiMaterial* const& material, aiTextureType const& type, GLuint const& texture_wrapping)
 {
-	std::vector<Texture *> textures;
+	std::vector<Texture const*> textures;
 
 	for (unsigned int i = 0; i < material->GetTextureCount(type); i++)
 	{
@@ -107,9 +436,9 @@ std::vector<Texture *> Model::loadMaterialTextures(aiMaterial* const& material,
 		std::string file_loc = m_directory + path.C_Str();
 
 		bool skip = false;
-		for (Texture * const& texture_loaded : m_textures_loaded) {
+		for (std::unique_ptr<Texture> const& texture_loaded : m_textures_loaded) {
 			if (std::strcmp(texture_loaded->path().c_str(), file_loc.c_str()) == 0) {
-				textures.push_back(texture_loaded);
+				textures.push_back(texture_loaded.get());
 				skip = true;
 				break;
 			}
@@ -117,15 +446,15 @@ std::vector<Texture *> Model::loadMaterialTextures(aiMaterial* const& material,
 
 		if (!skip) {
 
-			Texture *texture = new Texture(file_loc);
+			std::unique_ptr<Texture> texture(new Texture(file_loc));
 
-			if (!texture->load(texture_wrapping))
+			if (!(m_texture_streamer ? m_texture_streamer->load(*texture, texture_wrapping) : texture->load(texture_wrapping)))
 				std::cout << "Texture \"" << file_loc << "\" failed loading." << std::endl;
 
 			//std::cout << texture.id() << " - " << type_name << " - " << file_loc << std::endl;
 
-			textures.push_back(texture);
-			m_textures_loaded.push_back(texture);
+			textures.push_back(texture.get());
+			m_textures_loaded.push_back(std::move(texture));
 		}
 	}
 
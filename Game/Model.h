@@ -1,31 +1,77 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 
 #include <assimp/scene.h>
+#include <glm/vec3.hpp>
 
+#include "Animation.h"
+#include "GLHandle.h"
+#include "Material.h"
 #include "Mesh.h"
 #include "Shader.h"
+#include "Texture.h"
+
+class TextureStreamer;
 
 
 class Model
 {
 public:
-	explicit Model(std::string const& path, GLuint const& texture_wrapping = GL_REPEAT) : m_directory(path.substr(0, path.find_last_of('/')) + "/")
+	// position_stream keeps a position only copy of the vertices for the depth pre-pass
+	explicit Model(std::string const& path, GLuint const& texture_wrapping = GL_REPEAT, TextureStreamer* const texture_streamer = nullptr, bool const& position_stream = false) :
+		m_directory(path.substr(0, path.find_last_of('/')) + "/"), m_texture_streamer(texture_streamer), m_position_stream(position_stream), m_sampler(), m_materials(), m_scene_materials(), m_bounds_min(0.f), m_bounds_max(0.f), m_center(0.f), m_radius(0.f),
+		m_skeleton(), m_animations()
 	{
 		loadModel(path, texture_wrapping);
 	}
+	Model(Model&&) = default;
 
 	void Draw(Shader const& shader, bool const& textures = true) const;
+	void Draw(Shader const& shader, MeshletRanges const& ranges, size_t const& first_mesh, bool const& textures = true) const;
+	void DrawDepth() const;
+	void DrawDepth(MeshletRanges const& ranges, size_t const& first_mesh) const;
+
+	// Bounding sphere, in model space
+	glm::vec3 center() const;
+	float radius() const;
+
+	std::vector<Mesh> const& meshes() const;
+	std::vector<std::unique_ptr<Texture>> const& textures() const;
+
+	// nullptr when no mesh is rigged, the clips are only loaded along with a skeleton
+	Skeleton const* skeleton() const;
+	std::vector<AnimationClip> const& animations() const;
 
 private:
 	std::vector<Mesh> m_meshes;
-	std::vector<Texture *> m_textures_loaded;
+	std::vector<std::unique_ptr<Texture>> m_textures_loaded;
 	std::string const m_directory;
+	TextureStreamer* m_texture_streamer; // nullptr to load every mip level up front
+	bool m_position_stream;
+
+	GLSampler m_sampler; // shared by every material texture
+	std::vector<std::unique_ptr<Material>> m_materials;
+	std::vector<Material const*> m_scene_materials; // by assimp material index, created on first use
+
+	static constexpr float s_default_shininess = 32.f;
+	static constexpr double s_default_ticks_per_second = 25.;
+
+	glm::vec3 m_bounds_min, m_bounds_max;
+	glm::vec3 m_center;
+	float m_radius;
+
+	std::unique_ptr<Skeleton> m_skeleton;
+	std::vector<AnimationClip> m_animations;
 
 	void loadModel(std::string const& path, GLuint const& texture_wrapping);
 	void processNode(aiNode* const& node, const aiScene* scene, GLuint const& texture_wrapping);
 	Mesh processMesh(aiMesh* const& mesh, const aiScene* scene, GLuint const& texture_wrapping);
-	std::vector<Texture *> loadMaterialTextures(aiMaterial* const& material, aiTextureType const& type, std::string const& type_name, GLuint const& texture_wrapping);
+	void addJoints(aiNode const* node, int const& parent);
+	std::vector<SkinVertex> loadSkin(aiMesh const* mesh);
+	void loadAnimations(const aiScene* scene);
+	Material const* loadMaterial(const aiScene* scene, unsigned int const& index, GLuint const& texture_wrapping);
+	std::vector<Texture const*> loadMaterialTextures(aiMaterial* const& material, aiTextureType const& type, GLuint const& texture_wrapping);
 };
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "ParticleSystem.h"
+
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+#include "Profiler.h"
+
+
+constexpr GLuint ParticleSystem::s_position_attribute;
+constexpr GLuint ParticleSystem::s_velocity_attribute;
+
+ParticleSystem::ParticleSystem(size_t const& count, glm::vec3 const& emitter, float const& size, float const& lifetime,
+	unsigned int const& width, unsigned int const& height, std::string const& shaders_directory) :
+	m_count(count), m_emitter(emitter), m_size(size), m_lifetime(lifetime), m_reset(true), m_seed(0), m_current(0),
+	m_buffers{ { GLBuffer::generate(), GLBuffer::generate() } },
+	m_update_vaos{ { GLVertexArray::generate(), GLVertexArray::generate() } },
+	m_draw_vaos{ { GLVertexArray::generate(), GLVertexArray::generate() } },
+	m_depth_framebuffer(GLFramebuffer::generate()), m_depth(GLTexture::generate()), m_valid(false),
+	m_update_shader(shaders_directory + "particles_update.vert", std::vector<std::string>{ "position_age", "velocity_lifetime" }),
+	m_draw_shader(shaders_directory + "particles.vert", shaders_directory + "particles.frag"),
+	m_oit_draw_shader(shaders_directory + "particles.vert", shaders_directory + "particles.frag", "#define WEIGHTED_BLENDED_OIT\n")
+{
+	// Left uninitialized, the first update writes every particle
+	for (size_t i = 0; i < m_buffers.size(); i++) {
+		glBindBuffer(GL_ARRAY_BUFFER, m_buffers[i].id());
+		glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_count * sizeof(Particle)), nullptr, GL_DYNAMIC_COPY);
+
+		for (GLVertexArray const* vao : { &m_update_vaos[i], &m_draw_vaos[i] }) {
+			glBindVertexArray(vao->id());
+			glEnableVertexAttribArray(s_position_attribute);
+			glVertexAttribPointer(s_position_attribute, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), reinterpret_cast<GLvoid*>(offsetof(Particle, position)));
+			glEnableVertexAttribArray(s_velocity_attribute);
+			glVertexAttribPointer(s_velocity_attribute, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), reinterpret_cast<GLvoid*>(offsetof(Particle, velocity)));
+		}
+		// The drawing vertex array is still bound
+		glVertexAttribDivisor(s_position_attribute, 1);
+		glVertexAttribDivisor(s_velocity_attribute, 1);
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindTexture(GL_TEXTURE_2D, m_depth.id());
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_depth_framebuffer.id());
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_depth.id(), 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	m_valid = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	if (!m_valid)
+		std::cerr << "Error: particles depth framebuffer is incomplete." << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+
+// Blocks until every program is linked
+bool ParticleSystem::valid() const
+{
+	if (m_update_shader.id() == 0 || m_draw_shader.id() == 0 || m_oit_draw_shader.id() == 0) {
+		std::cerr << "Error: particle programs failed to build." << std::endl;
+		return false;
+	}
+
+	return m_valid;
+}
+
+// Runs the simulation from the current buffer into the other one, which then becomes current. Nothing is rasterized.
+void ParticleSystem::update(float const& delta_time)
+{
+	const size_t next(1 - m_current);
+
+	// Uniforms are set on every use so that hot reloads need no extra setup
+	m_update_shader.use();
+	m_update_shader.setUni("reset", m_reset);
+	m_update_shader.setUni("delta_time", delta_time);
+	m_update_shader.setUni("seed", m_seed++);
+	m_update_shader.setUni("emitter_position", m_emitter);
+	m_update_shader.setUni("max_lifetime", m_lifetime);
+
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBindVertexArray(m_update_vaos[m_current].id());
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_buffers[next].id());
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(m_count));
+	glEndTransformFeedback();
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glBindVertexArray(0);
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	m_current = next;
+	m_reset = false;
+}
+
+void ParticleSystem::copyDepth(GLuint const& scene_framebuffer, unsigned int const& width, unsigned int const& height) const
+{
+	// The scene's depth can't be sampled while it is tested against, a copy of it is
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, scene_framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_depth_framebuffer.id());
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, scene_framebuffer);
+}
+
+// Expects the transparent pass' state: depth test on, depth writes and face culling off. Blending is left to the default function.
+void ParticleSystem::draw(glm::mat4 const& view, glm::mat4 const& projection) const
+{
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+
+	drawQuads(m_draw_shader, view, projection);
+
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+// WeightedBlendedOit::begin already turned depth writes off and set the blending
+void ParticleSystem::drawOit(glm::mat4 const& view, glm::mat4 const& projection) const
+{
+	drawQuads(m_oit_draw_shader, view, projection);
+}
+
+glm::vec3 const& ParticleSystem::emitter() const
+{
+	return m_emitter;
+}
+
+// Exposed for hot reloading
+Shader& ParticleSystem::updateShader()
+{
+	return m_update_shader;
+}
+
+Shader& ParticleSystem::drawShader()
+{
+	return m_draw_shader;
+}
+
+Shader& ParticleSystem::oitDrawShader()
+{
+	return m_oit_draw_shader;
+}
+
+
+void ParticleSystem::drawQuads(Shader const& shader, glm::mat4 const& view, glm::mat4 const& projection) const
+{
+	shader.use();
+	shader.setUni("view", view);
+	shader.setUni("projection", projection);
+	shader.setUni("particle_size", m_size);
+	shader.setUni("scene_depth", 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_depth.id());
+
+	glBindVertexArray(m_draw_vaos[m_current].id());
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(m_count));
+	Profiler::countDraw(static_cast<GLsizei>(6 * m_count)); // two triangles per particle
+
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
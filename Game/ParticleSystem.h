@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <string>
+
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+
+#include "GLHandle.h"
+#include "Shader.h"
+
+
+// Particles living entirely on the GPU: every frame a vertex shader reads the state of each particle from one buffer,
+// integrates it, respawns the dead ones at the emitter, and transform feedback writes the result to the other buffer.
+// They are drawn as camera facing quads instanced from the latest buffer, faded where they get close to the scene's
+// depth (soft particles) and blended additively so that their order doesn't matter, or accumulated with the transparent
+// surfaces when these are order independent. The CPU only issues a few calls.
+class ParticleSystem
+{
+public:
+	// lifetime is the longest one in seconds, particles live between half of it and all of it
+	ParticleSystem(size_t const& count, glm::vec3 const& emitter, float const& size, float const& lifetime,
+		unsigned int const& width, unsigned int const& height, std::string const& shaders_directory);
+
+	bool valid() const;
+
+	void update(float const& delta_time);
+	// Copies the depth of scene_framebuffer for the soft fade, which then stays bound. Must come before the framebuffer the
+	// particles are drawn in is bound, when it tests against the same depth.
+	void copyDepth(GLuint const& scene_framebuffer, unsigned int const& width, unsigned int const& height) const;
+	// Blends additively over the bound framebuffer, whose depth writes must be off
+	void draw(glm::mat4 const& view, glm::mat4 const& projection) const;
+	// Accumulates into the targets of WeightedBlendedOit, between its begin() and composite() and with its blend state
+	void drawOit(glm::mat4 const& view, glm::mat4 const& projection) const;
+
+	glm::vec3 const& emitter() const;
+
+	// Exposed for hot reloading
+	Shader& updateShader();
+	Shader& drawShader();
+	Shader& oitDrawShader();
+
+private:
+	// Mirrors the inputs and the captured outputs of particles_update.vert
+	struct Particle {
+		glm::vec3 position;
+		float age; // seconds, negative while waiting to be emitted for the first time
+		glm::vec3 velocity;
+		float lifetime;
+	};
+
+	static constexpr GLuint s_position_attribute = 0, s_velocity_attribute = 1;
+
+	size_t m_count;
+	glm::vec3 m_emitter;
+	float m_size;
+	float m_lifetime;
+	bool m_reset; // the buffers have no particles yet, the first update spreads their emission over a lifetime
+	unsigned int m_seed;
+	size_t m_current; // buffer holding the latest state
+
+	std::array<GLBuffer, 2> m_buffers;
+	std::array<GLVertexArray, 2> m_update_vaos; // per vertex attributes, read by the simulation
+	std::array<GLVertexArray, 2> m_draw_vaos; // per instance attributes, read by the billboards
+
+	GLFramebuffer m_depth_framebuffer;
+	GLTexture m_depth; // same format as the scene's depth renderbuffer, which blits require
+	bool m_valid;
+
+	Shader m_update_shader;
+	Shader m_draw_shader;
+	Shader m_oit_draw_shader;
+
+	void drawQuads(Shader const& shader, glm::mat4 const& view, glm::mat4 const& projection) const;
+};
@@ -0,0 +1,88 @@
+#include "PostProcessChain.h"
+
+#include "Profiler.h"
+
+
+PostProcessChain::PostProcessChain(unsigned int const& width, unsigned int const& height) :
+	m_width(width), m_height(height), m_render_width(width), m_render_height(height),
+	m_passes(), m_pool(), m_output(nullptr), m_empty_vao(0)
+{
+	glGenVertexArrays(1, &m_empty_vao);
+}
+
+PostProcessChain::~PostProcessChain()
+{
+	glDeleteVertexArrays(1, &m_empty_vao);
+}
+
+
+void PostProcessChain::addPass(const char* name, Pass const& pass)
+{
+	m_passes.push_back({ name, pass });
+}
+
+// Returns the last pass' output, or scene itself without any pass. Depth and stencil tests are left enabled, blending disabled.
+RenderTarget const& PostProcessChain::run(RenderTarget const& scene, unsigned int const& render_width, unsigned int const& render_height)
+{
+	if (m_output)
+		m_pool.release(*m_output);
+	m_render_width = render_width;
+	m_render_height = render_height;
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_BLEND);
+
+	RenderTarget const* current(&scene);
+	for (NamedPass const& pass : m_passes) {
+		PROFILE_PASS(pass.name);
+
+		RenderTarget const& output(pass.run(*this, *current));
+		if (&output != current)
+			m_pool.release(*current);
+		current = &output;
+	}
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glEnable(GL_STENCIL_TEST);
+	glEnable(GL_DEPTH_TEST);
+
+	m_output = current;
+	return *current;
+}
+
+
+RenderTargetPool& PostProcessChain::pool()
+{
+	return m_pool;
+}
+
+unsigned int PostProcessChain::width() const
+{
+	return m_width;
+}
+
+unsigned int PostProcessChain::height() const
+{
+	return m_height;
+}
+
+unsigned int PostProcessChain::renderWidth() const
+{
+	return m_render_width;
+}
+
+unsigned int PostProcessChain::renderHeight() const
+{
+	return m_render_height;
+}
+
+// Fullscreen triangle over the bound framebuffer's viewport (fullscreen.vert)
+void PostProcessChain::drawFullscreen() const
+{
+	glBindVertexArray(m_empty_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	Profiler::countDraw(3);
+	glBindVertexArray(0);
+}
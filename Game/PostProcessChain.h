@@ -0,0 +1,49 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "RenderTargetPool.h"
+
+
+// Full-screen passes run one after the other over the HDR scene, each timed as its own profiler pass.
+// A pass reads the previous output and returns its own, taking any target it needs from the pool; the chain hands
+// the input back to the pool once the pass is done. Targets are full size, passes only fill the rendered corner
+// (see DynamicResolution) of renderWidth() x renderHeight() texels.
+class PostProcessChain
+{
+public:
+	using Pass = std::function<RenderTarget const&(PostProcessChain& chain, RenderTarget const& input)>;
+
+	PostProcessChain(unsigned int const& width, unsigned int const& height);
+	~PostProcessChain();
+
+	void addPass(const char* name, Pass const& pass);
+	RenderTarget const& run(RenderTarget const& scene, unsigned int const& render_width, unsigned int const& render_height);
+
+	RenderTargetPool& pool();
+	unsigned int width() const;
+	unsigned int height() const;
+	unsigned int renderWidth() const;
+	unsigned int renderHeight() const;
+
+	void drawFullscreen() const;
+
+private:
+	struct NamedPass {
+		const char* name; // string literal, kept by the profiler
+		Pass run;
+	};
+
+	unsigned int const m_width;
+	unsigned int const m_height;
+	unsigned int m_render_width;
+	unsigned int m_render_height;
+
+	std::vector<NamedPass> m_passes;
+	RenderTargetPool m_pool;
+	RenderTarget const* m_output; // returned by the last run, still read by the caller until the next one
+	GLuint m_empty_vao;
+};
@@ -0,0 +1,466 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+#include <imgui.h>
+
+#include "AllocationCounter.h"
+#include "FrameArena.h"
+#include "GLHandle.h"
+
+
+namespace
+{
+	// Only taken when a thread records its first event and when the main thread drains the buffers
+	std::mutex s_threads_mutex;
+	std::atomic<uint32_t> s_next_thread_id(0);
+
+	thread_local uint32_t t_depth(0);
+	unsigned long long s_allocations_mark(0); // AllocationCounter::count() at the start of the frame
+
+	constexpr uint32_t GPU_THREAD_ID = 0xFFFFFFFF;
+	constexpr size_t TRACE_CAPACITY = 1 << 16;
+
+	double toMilliseconds(Uint64 const& ticks)
+	{
+		return static_cast<double>(ticks) * 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+	}
+}
+
+
+std::vector<std::unique_ptr<Profiler::ThreadEvents>> Profiler::s_threads = {};
+std::vector<Profiler::PassTiming> Profiler::s_passes = {};
+std::vector<CpuEvent> Profiler::s_trace = {};
+size_t Profiler::s_trace_next = 0;
+std::array<float, 240> Profiler::s_frame_times = {};
+size_t Profiler::s_frame_index = 0;
+FrameCounters Profiler::s_counters = {};
+FrameCounters Profiler::s_last_counters = {};
+int Profiler::s_active_gpu_pass = -1;
+GLenum Profiler::s_fragment_query_target = 0;
+std::array<GLuint, 2> Profiler::s_fragment_queries = {};
+std::array<bool, 2> Profiler::s_fragment_issued = {};
+std::array<unsigned long long, 2> Profiler::s_fragment_pixels = {};
+std::array<std::vector<GLuint>, 2> Profiler::s_primitive_queries = {};
+std::array<size_t, 2> Profiler::s_primitive_issued = {};
+unsigned long long Profiler::s_indirect_triangles = 0;
+std::atomic<uint32_t> Profiler::s_dropped_events(0);
+
+
+// Called by the main thread at the start of each frame, makes the last frame's data available to the overlay
+void Profiler::newFrame(double const& frame_time)
+{
+	s_frame_times[s_frame_index % s_frame_times.size()] = static_cast<float>(frame_time * 1000.0);
+	s_frame_index++;
+
+	collectGpuQueries();
+	collectCpuEvents();
+
+	const unsigned long long allocations(AllocationCounter::count());
+	s_counters.allocations = allocations - s_allocations_mark;
+	s_allocations_mark = allocations;
+
+	s_last_counters = s_counters;
+	s_counters = {};
+	for (PassTiming& timing : s_passes) {
+		timing.draw_calls = timing.pending_draw_calls;
+		timing.pending_draw_calls = 0;
+	}
+}
+
+void Profiler::drawOverlay()
+{
+	const float frame_ms(s_frame_times[(s_frame_index + s_frame_times.size() - 1) % s_frame_times.size()]);
+
+	ImGui::SetNextWindowPos(ImVec2(10.f, 10.f), ImGuiCond_Always);
+	ImGui::SetNextWindowBgAlpha(0.6f);
+	if (ImGui::Begin("Profiler", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav))
+	{
+		ImGui::Text("Frame: %.2f ms (%.0f FPS)", frame_ms, frame_ms > 0.f ? 1000.f / frame_ms : 0.f);
+		ImGui::PlotHistogram("##frame_times", s_frame_times.data(), static_cast<int>(s_frame_times.size()), static_cast<int>(s_frame_index % s_frame_times.size()),
+			nullptr, 0.f, 33.3f, ImVec2(240.f, 60.f));
+
+		ImGui::Text("Draw calls: %u", s_last_counters.draw_calls);
+		ImGui::Text("Triangles: %llu", s_last_counters.triangles);
+		ImGui::Text("State changes: %u", s_last_counters.state_changes);
+		if (s_last_counters.gpu_complete)
+			ImGui::Text("GPU time: %.3f ms", s_last_counters.gpu_ms);
+		else
+			ImGui::Text("GPU time: - (timings not ready)");
+		ImGui::Text("Heap allocations: %llu", s_last_counters.allocations);
+		if (s_last_counters.texture_budget_bytes > 0)
+			ImGui::Text("Textures: %.1f / %.1f MB, %u loading", s_last_counters.texture_bytes / (1024.f * 1024.f), s_last_counters.texture_budget_bytes / (1024.f * 1024.f),
+				s_last_counters.textures_loading);
+		if (s_last_counters.opaque_pixels > 0)
+			ImGui::Text("Opaque fragments: %.2fM, %.2f per pixel (%s)", s_last_counters.opaque_fragments / 1e6, static_cast<double>(s_last_counters.opaque_fragments) / s_last_counters.opaque_pixels,
+				fragmentCountSource());
+		if (s_last_counters.meshlets_tested > 0)
+			ImGui::Text("Meshlets: %u / %u visible", s_last_counters.meshlets_visible, s_last_counters.meshlets_tested);
+		if (s_last_counters.posed_instances > 0)
+			ImGui::Text("Animation: %u instances, %u bones, %.3f ms CPU", s_last_counters.posed_instances, s_last_counters.posed_bones, s_last_counters.pose_cpu_ms);
+		ImGui::Text("Frame arena: %.1f / %.1f KB", FrameArena::local().used() / 1024.f, FrameArena::local().capacity() / 1024.f);
+		ImGui::Text("GL objects: %ld buffers, %ld VAOs, %ld textures, %ld samplers, %ld programs, %ld framebuffers, %ld renderbuffers", GLObjects::live(GL_OBJECT_BUFFER),
+			GLObjects::live(GL_OBJECT_VERTEX_ARRAY), GLObjects::live(GL_OBJECT_TEXTURE), GLObjects::live(GL_OBJECT_SAMPLER), GLObjects::live(GL_OBJECT_PROGRAM),
+			GLObjects::live(GL_OBJECT_FRAMEBUFFER), GLObjects::live(GL_OBJECT_RENDERBUFFER));
+		if (s_dropped_events.load(std::memory_order_relaxed) > 0)
+			ImGui::Text("Dropped markers: %u", s_dropped_events.load(std::memory_order_relaxed));
+
+		ImGui::Separator();
+		ImGui::Columns(4, "passes");
+		ImGui::Text("Pass"); ImGui::NextColumn();
+		ImGui::Text("CPU (ms)"); ImGui::NextColumn();
+		ImGui::Text("GPU (ms)"); ImGui::NextColumn();
+		ImGui::Text("Draws"); ImGui::NextColumn();
+		ImGui::Separator();
+		for (PassTiming const& timing : s_passes) {
+			ImGui::Text("%s", timing.name); ImGui::NextColumn();
+			ImGui::Text("%.3f", timing.cpu_ms); ImGui::NextColumn();
+			if (timing.queries[0] != 0) {
+				if (timing.gpu_fresh)
+					ImGui::Text("%.3f", timing.gpu_ms);
+				else
+					ImGui::Text("-");
+				ImGui::NextColumn();
+				ImGui::Text("%u", timing.draw_calls); ImGui::NextColumn();
+			}
+			else {
+				ImGui::Text("-"); ImGui::NextColumn();
+				ImGui::Text("-"); ImGui::NextColumn();
+			}
+		}
+		ImGui::Columns(1);
+	}
+	ImGui::End();
+}
+
+// Writes the captured markers in the Trace Event Format, readable by chrome://tracing or Perfetto
+bool Profiler::exportChromeTrace(std::string const& file_path)
+{
+	std::ofstream file(file_path);
+	if (!file) {
+		std::cerr << "Error: could not open \"" << file_path << "\" to export the trace." << std::endl;
+		return false;
+	}
+
+	const double frequency(static_cast<double>(SDL_GetPerformanceFrequency()));
+	const size_t count(std::min(s_trace.size(), TRACE_CAPACITY));
+	const size_t first(s_trace.size() < TRACE_CAPACITY ? 0 : s_trace_next);
+
+	file << "{\"traceEvents\":[";
+	for (size_t i = 0; i < count; i++) {
+		CpuEvent const& event(s_trace[(first + i) % s_trace.size()]);
+
+		file << (i ? ",\n" : "\n") << "{\"name\":\"" << event.name << "\",\"cat\":\"" << (event.thread_id == GPU_THREAD_ID ? "gpu" : "cpu")
+			<< "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << (event.thread_id == GPU_THREAD_ID ? -1 : static_cast<long long>(event.thread_id))
+			<< ",\"ts\":" << static_cast<double>(event.start) * 1e6 / frequency
+			<< ",\"dur\":" << static_cast<double>(event.end - event.start) * 1e6 / frequency << "}";
+	}
+	file << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+
+	std::cout << "Exported " << count << " profiler events to \"" << file_path << "\"." << std::endl;
+	return true;
+}
+
+
+void Profiler::countDraw(GLsizei const& index_count)
+{
+	s_counters.draw_calls++;
+	s_counters.triangles += static_cast<unsigned long long>(index_count) / 3;
+	if (s_active_gpu_pass >= 0)
+		s_passes[s_active_gpu_pass].pending_draw_calls++;
+}
+
+void Profiler::countStateChange(unsigned int const& count)
+{
+	s_counters.state_changes += count;
+}
+
+void Profiler::countTextures(size_t const& resident_bytes, size_t const& budget_bytes, unsigned int const& loading)
+{
+	s_counters.texture_bytes = resident_bytes;
+	s_counters.texture_budget_bytes = budget_bytes;
+	s_counters.textures_loading = loading;
+}
+
+void Profiler::countMeshlets(unsigned int const& tested, unsigned int const& visible)
+{
+	s_counters.meshlets_tested = tested;
+	s_counters.meshlets_visible = visible;
+}
+
+void Profiler::countPoses(unsigned int const& instances, unsigned int const& bones, double const& cpu_ms)
+{
+	s_counters.posed_instances = instances;
+	s_counters.posed_bones = bones;
+	s_counters.pose_cpu_ms = cpu_ms;
+}
+
+// Counters of the last completed frame
+FrameCounters const& Profiler::counters()
+{
+	return s_last_counters;
+}
+
+std::vector<Profiler::PassTiming> const& Profiler::passes()
+{
+	return s_passes;
+}
+
+double Profiler::gpuTime(std::initializer_list<const char*> const& names)
+{
+	double gpu_ms(0.0);
+	for (PassTiming const& timing : s_passes) {
+		if (std::none_of(names.begin(), names.end(), [&timing](const char* name) { return std::strcmp(timing.name, name) == 0; }))
+			continue;
+		if (!timing.gpu_fresh)
+			return 0.0;
+		gpu_ms += timing.gpu_ms;
+	}
+
+	return gpu_ms;
+}
+
+
+// Lock-free for the calling thread: single producer ring buffer, the main thread being the only consumer
+void Profiler::record(CpuEvent const& event)
+{
+	ThreadEvents& buffer(threadEvents());
+
+	const uint32_t head(buffer.head.load(std::memory_order_relaxed));
+	if (head - buffer.tail.load(std::memory_order_acquire) >= ThreadEvents::s_capacity) {
+		s_dropped_events.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	buffer.events[head % ThreadEvents::s_capacity] = event;
+	buffer.head.store(head + 1, std::memory_order_release);
+}
+
+uint32_t Profiler::threadId()
+{
+	thread_local const uint32_t id(s_next_thread_id.fetch_add(1, std::memory_order_relaxed));
+	return id;
+}
+
+
+void Profiler::beginGpu(const char* name)
+{
+	PassTiming& timing(pass(name));
+	if (timing.queries[0] == 0)
+		glGenQueries(static_cast<GLsizei>(timing.queries.size()), timing.queries.data());
+
+	// Queries alternate between two objects so that the previous frame's result is read without waiting on the GPU
+	const size_t slot(s_frame_index % timing.queries.size());
+	glBeginQuery(GL_TIME_ELAPSED, timing.queries[slot]);
+	timing.issued[slot] = true;
+	timing.gpu_start = SDL_GetPerformanceCounter();
+
+	s_active_gpu_pass = static_cast<int>(&timing - s_passes.data());
+}
+
+void Profiler::endGpu()
+{
+	if (s_active_gpu_pass < 0)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	s_active_gpu_pass = -1;
+}
+
+
+// Counts the fragments of the opaque pass over the given render area. Queries alternate like the pass timings.
+void Profiler::beginFragmentCount(unsigned long long const& pixels)
+{
+	if (s_fragment_queries[0] == 0) {
+		s_fragment_query_target = GLEW_ARB_pipeline_statistics_query ? GL_FRAGMENT_SHADER_INVOCATIONS_ARB : GL_SAMPLES_PASSED;
+		glGenQueries(static_cast<GLsizei>(s_fragment_queries.size()), s_fragment_queries.data());
+	}
+
+	const size_t slot(s_frame_index % s_fragment_queries.size());
+	glBeginQuery(s_fragment_query_target, s_fragment_queries[slot]);
+	s_fragment_issued[slot] = true;
+	s_fragment_pixels[slot] = pixels;
+}
+
+void Profiler::endFragmentCount()
+{
+	glEndQuery(s_fragment_query_target);
+}
+
+const char* Profiler::fragmentCountSource()
+{
+	return s_fragment_query_target == GL_SAMPLES_PASSED ? "samples passed" : "shader invocations";
+}
+
+
+// Queries alternate like the pass timings, each slot holding one per use during its frame
+void Profiler::beginIndirectCount()
+{
+	const size_t slot(s_frame_index % s_primitive_queries.size());
+	std::vector<GLuint>& queries(s_primitive_queries[slot]);
+	if (s_primitive_issued[slot] == queries.size()) {
+		GLuint query(0);
+		glGenQueries(1, &query);
+		queries.push_back(query);
+	}
+
+	glBeginQuery(GL_PRIMITIVES_GENERATED, queries[s_primitive_issued[slot]++]);
+}
+
+void Profiler::endIndirectCount()
+{
+	glEndQuery(GL_PRIMITIVES_GENERATED);
+}
+
+
+Profiler::ThreadEvents& Profiler::threadEvents()
+{
+	thread_local ThreadEvents* buffer(nullptr);
+
+	if (!buffer) {
+		std::unique_ptr<ThreadEvents> events(new ThreadEvents());
+		events->head.store(0);
+		events->tail.store(0);
+		buffer = events.get();
+
+		std::lock_guard<std::mutex> lock(s_threads_mutex);
+		s_threads.push_back(std::move(events));
+	}
+
+	return *buffer;
+}
+
+Profiler::PassTiming& Profiler::pass(const char* name)
+{
+	for (PassTiming& timing : s_passes)
+		if (timing.name == name || std::strcmp(timing.name, name) == 0)
+			return timing;
+
+	s_passes.push_back({ name, 0.0, 0.0, false, 0.0, {{ 0, 0 }}, {{ false, false }}, 0, 0, 0 });
+	return s_passes.back();
+}
+
+void Profiler::collectCpuEvents()
+{
+	std::lock_guard<std::mutex> lock(s_threads_mutex);
+	for (std::unique_ptr<ThreadEvents> const& buffer : s_threads) {
+		const uint32_t tail(buffer->tail.load(std::memory_order_relaxed));
+		const uint32_t head(buffer->head.load(std::memory_order_acquire));
+
+		for (uint32_t i = tail; i != head; i++) {
+			CpuEvent const& event(buffer->events[i % ThreadEvents::s_capacity]);
+
+			// Nested markers are already accounted for by their parent
+			if (event.depth == 0)
+				pass(event.name).accumulated_cpu_ms += toMilliseconds(event.end - event.start);
+
+			appendTrace(event);
+		}
+
+		buffer->tail.store(head, std::memory_order_release);
+	}
+
+	for (PassTiming& timing : s_passes) {
+		timing.cpu_ms = timing.accumulated_cpu_ms;
+		timing.accumulated_cpu_ms = 0.0;
+	}
+}
+
+void Profiler::collectGpuQueries()
+{
+	const size_t slot(s_frame_index % 2);
+	double gpu_ms(0.0);
+	bool complete(true);
+
+	for (PassTiming& timing : s_passes) {
+		// Skipped that frame (e.g. a cached shadow cascade), it cost nothing
+		if (!timing.issued[slot]) {
+			timing.gpu_ms = 0.0;
+			timing.gpu_fresh = true;
+			continue;
+		}
+
+		// Not waited for, the sample is dropped. The query gets issued again by the pass' next use of the slot.
+		GLint available(GL_FALSE);
+		glGetQueryObjectiv(timing.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+		timing.issued[slot] = false;
+		if (available != GL_TRUE) {
+			timing.gpu_fresh = false;
+			complete = false;
+			continue;
+		}
+
+		GLuint64 elapsed(0);
+		glGetQueryObjectui64v(timing.queries[slot], GL_QUERY_RESULT, &elapsed);
+		timing.gpu_ms = static_cast<double>(elapsed) / 1e6;
+		timing.gpu_fresh = true;
+		gpu_ms += timing.gpu_ms;
+
+		const Uint64 duration(static_cast<Uint64>(static_cast<double>(elapsed) * static_cast<double>(SDL_GetPerformanceFrequency()) / 1e9));
+		appendTrace({ timing.name, timing.gpu_start, timing.gpu_start + duration, GPU_THREAD_ID, 0 });
+	}
+
+	// A partial sum would under-report the frame
+	s_counters.gpu_ms = complete ? gpu_ms : 0.0;
+	s_counters.gpu_complete = complete;
+
+	GLint available(GL_FALSE);
+	if (s_fragment_issued[slot])
+		glGetQueryObjectiv(s_fragment_queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (available == GL_TRUE) {
+		GLuint64 fragments(0);
+		glGetQueryObjectui64v(s_fragment_queries[slot], GL_QUERY_RESULT, &fragments);
+		s_counters.opaque_fragments = fragments;
+		s_counters.opaque_pixels = s_fragment_pixels[slot];
+		s_fragment_issued[slot] = false;
+	}
+
+	// A partial sum is dropped, the last complete one stands in for it
+	std::vector<GLuint> const& primitive_queries(s_primitive_queries[slot]);
+	if (s_primitive_issued[slot] > 0) {
+		bool ready(true);
+		for (size_t i = 0; i < s_primitive_issued[slot] && ready; i++) {
+			GLint query_available(GL_FALSE);
+			glGetQueryObjectiv(primitive_queries[i], GL_QUERY_RESULT_AVAILABLE, &query_available);
+			ready = query_available == GL_TRUE;
+		}
+
+		if (ready) {
+			s_indirect_triangles = 0;
+			for (size_t i = 0; i < s_primitive_issued[slot]; i++) {
+				GLuint64 primitives(0);
+				glGetQueryObjectui64v(primitive_queries[i], GL_QUERY_RESULT, &primitives);
+				s_indirect_triangles += primitives;
+			}
+		}
+		s_primitive_issued[slot] = 0;
+	}
+	s_counters.triangles += s_indirect_triangles;
+}
+
+void Profiler::appendTrace(CpuEvent const& event)
+{
+	if (s_trace.capacity() < TRACE_CAPACITY)
+		s_trace.reserve(TRACE_CAPACITY);
+
+	if (s_trace.size() < TRACE_CAPACITY)
+		s_trace.push_back(event);
+	else
+		s_trace[s_trace_next] = event;
+	s_trace_next = (s_trace_next + 1) % TRACE_CAPACITY;
+}
+
+
+ProfileScope::ProfileScope(const char* name) : m_name(name), m_start(SDL_GetPerformanceCounter()), m_depth(t_depth++)
+{
+}
+
+ProfileScope::~ProfileScope()
+{
+	t_depth--;
+	Profiler::record({ m_name, m_start, SDL_GetPerformanceCounter(), Profiler::threadId(), m_depth });
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <SDL.h>
+
+
+#define PROFILER_CONCAT_IMPL(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_IMPL(a, b)
+
+// CPU-only marker, name must be a string literal
+#define PROFILE_SCOPE(name) ProfileScope PROFILER_CONCAT(profile_scope_, __LINE__){ name }
+// CPU marker plus a GPU timer query, only for render passes on the GL thread (GL_TIME_ELAPSED queries can't nest)
+#define PROFILE_PASS(name) ProfileScope PROFILER_CONCAT(profile_scope_, __LINE__){ name }; GpuProfileScope PROFILER_CONCAT(gpu_profile_scope_, __LINE__){ name }
+
+
+struct CpuEvent {
+	const char* name;
+	Uint64 start;
+	Uint64 end;
+	uint32_t thread_id;
+	uint32_t depth;
+};
+
+struct FrameCounters {
+	unsigned int draw_calls;
+	unsigned long long triangles; // those of indirect draws are read back from a frame issued a couple of frames earlier
+	unsigned int state_changes;
+	double gpu_ms; // sum of the pass timings read back during the frame, issued a couple of frames earlier, 0 unless gpu_complete
+	bool gpu_complete; // every pass issued that frame had its timing available
+	unsigned long long allocations; // operator new calls during the frame, from every thread
+	size_t texture_bytes; // resident texture memory, 0 without texture streaming
+	size_t texture_budget_bytes;
+	unsigned int textures_loading;
+	unsigned int meshlets_tested; // of the opaque pass
+	unsigned int meshlets_visible;
+	unsigned long long opaque_fragments; // shaded by the opaque pass, read back from a frame issued a couple of frames earlier
+	unsigned long long opaque_pixels; // render target area of that frame, fragments / pixels is the overdraw
+	unsigned int posed_instances; // animated instances posed by the workers
+	unsigned int posed_bones;
+	double pose_cpu_ms; // summed over the workers
+};
+
+
+// Collects CPU markers from any thread and GPU timings from the GL thread, aggregated once per frame.
+// Markers are written lock-free into a ring buffer owned by their thread, the main thread drains them in newFrame().
+class Profiler
+{
+public:
+	struct PassTiming {
+		const char* name;
+		double cpu_ms;
+		double gpu_ms;
+		bool gpu_fresh; // gpu_ms was read back during the last frame, otherwise it is an older sample
+		double accumulated_cpu_ms;
+		std::array<GLuint, 2> queries;
+		std::array<bool, 2> issued;
+		Uint64 gpu_start; // CPU timestamp of the last query, used to place GPU events in traces
+		unsigned int draw_calls; // issued inside the pass during the last frame
+		unsigned int pending_draw_calls; // counted during the current frame
+	};
+
+	static void newFrame(double const& frame_time);
+	static void drawOverlay();
+	static bool exportChromeTrace(std::string const& file_path);
+
+	static void countDraw(GLsizei const& index_count);
+	static void countStateChange(unsigned int const& count = 1);
+	static void countTextures(size_t const& resident_bytes, size_t const& budget_bytes, unsigned int const& loading);
+	static void countMeshlets(unsigned int const& tested, unsigned int const& visible);
+	static void countPoses(unsigned int const& instances, unsigned int const& bones, double const& cpu_ms);
+
+	static FrameCounters const& counters();
+	static std::vector<PassTiming> const& passes();
+	// Sum of the last GPU timings of the named passes, 0 unless every one of them is fresh
+	static double gpuTime(std::initializer_list<const char*> const& names);
+
+	static void record(CpuEvent const& event);
+	static uint32_t threadId();
+
+	static void beginGpu(const char* name);
+	static void endGpu();
+
+	static void beginFragmentCount(unsigned long long const& pixels);
+	static void endFragmentCount();
+	static const char* fragmentCountSource();
+
+	// Around indirect draws, whose instance counts only the GPU knows: their triangles are counted by a query instead of
+	// countDraw(). Can be used several times per frame, not nested.
+	static void beginIndirectCount();
+	static void endIndirectCount();
+
+private:
+	struct ThreadEvents {
+		static constexpr uint32_t s_capacity = 4096;
+
+		std::array<CpuEvent, s_capacity> events;
+		std::atomic<uint32_t> head;
+		std::atomic<uint32_t> tail;
+	};
+
+	static ThreadEvents& threadEvents();
+	static PassTiming& pass(const char* name);
+	static void collectCpuEvents();
+	static void collectGpuQueries();
+	static void appendTrace(CpuEvent const& event);
+
+	static std::vector<std::unique_ptr<ThreadEvents>> s_threads;
+	static std::vector<PassTiming> s_passes;
+	static std::vector<CpuEvent> s_trace; // ring of the last captured events
+	static size_t s_trace_next;
+
+	static std::array<float, 240> s_frame_times;
+	static size_t s_frame_index;
+	static FrameCounters s_counters;
+	static FrameCounters s_last_counters;
+	static int s_active_gpu_pass;
+
+	static GLenum s_fragment_query_target; // fragment shader invocations when supported, samples passing the depth test otherwise
+	static std::array<GLuint, 2> s_fragment_queries;
+	static std::array<bool, 2> s_fragment_issued;
+	static std::array<unsigned long long, 2> s_fragment_pixels;
+	static std::array<std::vector<GLuint>, 2> s_primitive_queries; // grown to the number of indirect counts per frame
+	static std::array<size_t, 2> s_primitive_issued;
+	static unsigned long long s_indirect_triangles; // last complete read back
+	static std::atomic<uint32_t> s_dropped_events;
+};
+
+
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name);
+	~ProfileScope();
+
+private:
+	const char* m_name;
+	Uint64 m_start;
+	uint32_t m_depth;
+};
+
+class GpuProfileScope
+{
+public:
+	explicit GpuProfileScope(const char* name) { Profiler::beginGpu(name); }
+	~GpuProfileScope() { Profiler::endGpu(); }
+};
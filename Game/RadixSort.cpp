@@ -0,0 +1,85 @@
+#include "RadixSort.h"
+
+#include <array>
+#include <cstring>
+
+
+namespace
+{
+	// Maps the float ordering to the unsigned integer one: negative values get all their bits flipped, positive ones their sign bit
+	inline uint32_t orderedBits(float const& value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+	}
+}
+
+
+RadixSort::RadixSort() : m_keys(), m_keys_scratch(), m_indices(), m_indices_scratch()
+{
+}
+
+RadixSort::~RadixSort()
+{
+}
+
+
+// Returns the indices of keys from the smallest to the largest, equal keys keeping their order
+std::vector<uint32_t> const& RadixSort::sortAscending(float const* keys, size_t const& count)
+{
+	return sort(keys, count, false);
+}
+
+// Returns the indices of keys from the largest to the smallest, equal keys keeping their order
+std::vector<uint32_t> const& RadixSort::sortDescending(float const* keys, size_t const& count)
+{
+	return sort(keys, count, true);
+}
+
+
+std::vector<uint32_t> const& RadixSort::sort(float const* keys, size_t const& count, bool const& descending)
+{
+	m_keys.resize(count);
+	m_keys_scratch.resize(count);
+	m_indices.resize(count);
+	m_indices_scratch.resize(count);
+
+	// All the histograms are built in a single read of the keys
+	std::array<std::array<uint32_t, 256>, 4> histograms{};
+	for (size_t i = 0; i < count; i++) {
+		const uint32_t key(descending ? ~orderedBits(keys[i]) : orderedBits(keys[i]));
+		m_keys[i] = key;
+		m_indices[i] = static_cast<uint32_t>(i);
+
+		for (size_t pass = 0; pass < 4; pass++)
+			histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+	}
+
+	for (size_t pass = 0; pass < 4; pass++) {
+		std::array<uint32_t, 256>& histogram(histograms[pass]);
+		const unsigned int shift(static_cast<unsigned int>(pass * 8));
+
+		// Every key sharing this digit (frequent for the exponent byte), the pass wouldn't change anything
+		if (count == 0 || histogram[(m_keys[0] >> shift) & 0xFF] == count)
+			continue;
+
+		uint32_t offset(0);
+		for (uint32_t& bucket : histogram) {
+			const uint32_t size(bucket);
+			bucket = offset;
+			offset += size;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			const uint32_t destination(histogram[(m_keys[i] >> shift) & 0xFF]++);
+			m_keys_scratch[destination] = m_keys[i];
+			m_indices_scratch[destination] = m_indices[i];
+		}
+
+		m_keys.swap(m_keys_scratch);
+		m_indices.swap(m_indices_scratch);
+	}
+
+	return m_indices;
+}
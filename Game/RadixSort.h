@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Stable LSD radix sort of float keys (4 passes of 8 bits) returning a permutation, its buffers are kept between
+// sorts so that sorting a similar number of keys every frame doesn't allocate.
+class RadixSort
+{
+public:
+	RadixSort();
+	~RadixSort();
+
+	std::vector<uint32_t> const& sortAscending(float const* keys, size_t const& count);
+	std::vector<uint32_t> const& sortDescending(float const* keys, size_t const& count);
+
+private:
+	std::vector<uint32_t> const& sort(float const* keys, size_t const& count, bool const& descending);
+
+	std::vector<uint32_t> m_keys, m_keys_scratch;
+	std::vector<uint32_t> m_indices, m_indices_scratch;
+};
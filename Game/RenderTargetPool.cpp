@@ -0,0 +1,50 @@
+#include "RenderTargetPool.h"
+
+#include <iostream>
+
+
+RenderTargetPool::RenderTargetPool() : m_entries()
+{
+}
+
+
+// The target stays reserved until released, its content is undefined
+RenderTarget const& RenderTargetPool::acquire(unsigned int const& width, unsigned int const& height, GLint const& internal_format)
+{
+	for (std::unique_ptr<Entry> const& entry : m_entries) {
+		RenderTarget const& target(entry->target);
+		if (!entry->in_use && target.width == width && target.height == height && target.internal_format == internal_format) {
+			entry->in_use = true;
+			return target;
+		}
+	}
+
+	std::unique_ptr<Entry> entry(new Entry{ { 0, 0, width, height, internal_format }, GLTexture::generate(), GLFramebuffer::generate(), true });
+	RenderTarget& target(entry->target);
+
+	target.texture = entry->texture.id();
+	glBindTexture(GL_TEXTURE_2D, target.texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	target.framebuffer = entry->framebuffer.id();
+	glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "Error: pooled render target (" << width << "x" << height << ") is incomplete." << std::endl;
+
+	m_entries.push_back(std::move(entry));
+	return target;
+}
+
+// Targets not coming from the pool are ignored
+void RenderTargetPool::release(RenderTarget const& target)
+{
+	for (std::unique_ptr<Entry> const& entry : m_entries)
+		if (&entry->target == &target)
+			entry->in_use = false;
+}
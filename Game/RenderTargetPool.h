@@ -0,0 +1,40 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GLHandle.h"
+
+
+// Color texture with its framebuffer, sampled with bilinear filtering
+struct RenderTarget {
+	GLuint framebuffer;
+	GLuint texture;
+	unsigned int width;
+	unsigned int height;
+	GLint internal_format;
+};
+
+
+// Transient render targets shared by the passes of a frame: a released target is handed to the next request of the same
+// size and format, so passes that don't overlap alias the same memory. Targets are kept from one frame to the next.
+class RenderTargetPool
+{
+public:
+	RenderTargetPool();
+
+	RenderTarget const& acquire(unsigned int const& width, unsigned int const& height, GLint const& internal_format);
+	void release(RenderTarget const& target);
+
+private:
+	struct Entry {
+		RenderTarget target;
+		GLTexture texture; // owns target.texture
+		GLFramebuffer framebuffer; // owns target.framebuffer
+		bool in_use;
+	};
+
+	std::vector<std::unique_ptr<Entry>> m_entries; // entries don't move, targets are handed out by reference
+};
@@ -1,7 +1,10 @@
 #include "Renderer.h"
 
 #include <math.h>
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <string>
 
@@ -13,45 +16,91 @@
 #include <SDL.h>
 #include <SimpleIni.h>
 #include <imgui.h>
+#include <imgui_impl_opengl3.h>
+#include <imgui_impl_sdl.h>
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
+#include "Bloom.h"
 #include "Camera.h"
+#include "CascadedShadowMap.h"
+#include "DynamicResolution.h"
+#include "DynamicRingBuffer.h"
+#include "FileSystem.h"
+#include "FrameArena.h"
+#include "FrameScheduler.h"
+#include "GLHandle.h"
+#include "GpuCulling.h"
 #include "Shader.h"
+#include "ShaderWatcher.h"
+#include "Material.h"
 #include "Model.h"
+#include "ParticleSystem.h"
+#include "RenderTargetPool.h"
+#include "JobSystem.h"
+#include "PostProcessChain.h"
+#include "Profiler.h"
+#include "Scene.h"
+#include "ScreenSpaceOutline.h"
 #include "Texture.h"
+#include "TextureStreamer.h"
+#include "ToneMapping.h"
+#include "UniformBlocks.h"
+#include "WeightedBlendedOit.h"
 
 
 Renderer::Renderer(std::string const& window_title, std::string const& directory, CSimpleIniA const& ini_file) :
 	m_window_title(window_title), m_window_width(), m_window_height(),
 	m_directory(directory), m_window(),
-	m_context(), m_ini_file(ini_file), m_input()
+	m_context(), m_headless(false), m_egl_display(nullptr), m_egl_context(nullptr), m_egl_surface(nullptr),
+	m_framebuffer(), m_framebuffer_color(), m_framebuffer_depth_stencil(), m_hdr(false), m_gpu_culling(false), m_ini_file(ini_file), m_input()
 {
 	m_window_width = std::stoi(m_ini_file.GetValue("Video", "Width", "800"));
 	m_window_height = std::stoi(m_ini_file.GetValue("Video", "Height", "600"));
+	m_hdr = std::stoi(m_ini_file.GetValue("PostProcessing", "Enabled", "1")) != 0;
+	m_gpu_culling = std::stoi(m_ini_file.GetValue("Video", "GpuCulling", "1")) != 0;
 }
 
 Renderer::~Renderer()
 {
-	SDL_GL_DeleteContext(m_context);
+	if (ImGui::GetCurrentContext()) {
+		ImGui_ImplOpenGL3_Shutdown();
+		ImGui_ImplSDL2_Shutdown();
+		ImGui::DestroyContext();
+	}
+
+	// Released here rather than with the members, which would outlive the leak report
+	m_framebuffer.reset();
+	m_framebuffer_color.reset();
+	m_framebuffer_depth_stencil.reset();
+
+	// Models and shaders are gone with the main loop, any object still owned by a handle is leaked
+	GLObjects::reportLeaks();
+
+	if (m_headless)
+		destroyHeadlessContext();
+	else
+		SDL_GL_DeleteContext(m_context);
 	SDL_Quit();
 }
 
-bool Renderer::init()
+// In headless mode, no window is created: rendering happens in an offscreen framebuffer of an EGL context,
+// which works without a display server (e.g. Mesa llvmpipe)
+bool Renderer::init(bool const& headless)
 {
 #ifdef GLM_VERSION
 	std::cout << "Compiled against GLM version " << GLM_VERSION << "." << std::endl;
 #endif
 
-	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0)
+	m_headless = headless;
+	if (SDL_Init(m_headless ? SDL_INIT_TIMER : SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0)
 	{
 		std::cerr << "Error initializing SDL: " << SDL_GetError() << std::endl;
 		SDL_Quit();
 		return false;
 	}
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, std::stoi(m_ini_file.GetValue("Video", "DoubleBuffer", "1")));
-	SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 1);
 
 	SDL_version compiled, linked;
 	SDL_VERSION(&compiled);
@@ -60,6 +109,65 @@ bool Renderer::init()
 	printf("Linked against SDL version %d.%d.%d.\n", linked.major, linked.minor, linked.patch);
 
 
+	if (m_headless) {
+		if (!createHeadlessContext()) {
+			SDL_Quit();
+			return false;
+		}
+	}
+	else if (!createWindow())
+		return false;
+
+
+	// glewInit() also looks for GLX/WGL entry points, which fail without a window
+	GLenum GLEW_initialization(m_headless ? glewContextInit() : glewInit());
+	if (GLEW_initialization != GLEW_OK)
+	{
+		std::cerr << "Error initializing GLEW: " << glewGetErrorString(GLEW_initialization) << std::endl;
+		delete this;
+		return false;
+	}
+	std::cout << "GLEW version " << glewGetString(GLEW_VERSION) << "." << std::endl;
+	std::cout << "OpenGL renderer: " << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ")." << std::endl;
+
+	// Compute shaders and indirect draws, the context creation falls back to 3.3 when 4.3 is unavailable
+	m_gpu_culling = m_gpu_culling && GLEW_VERSION_4_3;
+	std::cout << (m_gpu_culling ? "GPU-driven culling enabled." : "CPU culling and submission.") << std::endl;
+
+	Shader::enableParallelCompilation();
+
+
+	std::cout << "Built against Assimp version " << aiGetVersionMajor() << "." << aiGetVersionMinor() << "." << std::endl << std::endl;
+
+
+	// The scene is always rendered offscreen, so that passes can share its depth buffer; windows get a copy of it before the swap
+	if (!createOffscreenTarget())
+		return false;
+
+	if (!m_headless) {
+		// Only used for debug overlays, the cursor is captured so ImGui never receives input events
+		IMGUI_CHECKVERSION();
+		ImGui::CreateContext();
+		ImGui::GetIO().IniFilename = nullptr;
+		ImGui_ImplSDL2_InitForOpenGL(m_window.get(), m_context);
+		ImGui_ImplOpenGL3_Init("#version 330 core");
+	}
+
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_STENCIL_TEST);
+
+	return true;
+}
+
+// GL 4.3 is only asked for with GPU culling, 3.3 is enough for everything else
+bool Renderer::createWindow()
+{
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, m_gpu_culling ? 4 : 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, std::stoi(m_ini_file.GetValue("Video", "DoubleBuffer", "1")));
+	SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 1);
+
 	m_window.reset(SDL_CreateWindow(m_window_title.c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, m_window_width, m_window_height, SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_OPENGL));
 	if (m_window == 0)
 	{
@@ -70,6 +178,11 @@ bool Renderer::init()
 
 
 	m_context = SDL_GL_CreateContext(m_window.get());
+	if (m_context == 0 && m_gpu_culling) {
+		std::cout << "OpenGL 4.3 unavailable, falling back to 3.3." << std::endl;
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+		m_context = SDL_GL_CreateContext(m_window.get());
+	}
 	if (m_context == 0)
 	{
 		std::cerr << "Error creating OpenGL context: " << SDL_GetError() << std::endl;
@@ -77,48 +190,163 @@ bool Renderer::init()
 		SDL_Quit();
 		return false;
 	}
-	SDL_GL_SetSwapInterval(1);
 
+	// 0 = immediate, 1 = vsync, -1 = adaptive vsync (falls back to vsync when unsupported)
+	const int swap_interval(std::stoi(m_ini_file.GetValue("Video", "VSync", "1")));
+	if (SDL_GL_SetSwapInterval(swap_interval) < 0 && swap_interval == -1)
+		SDL_GL_SetSwapInterval(1);
 
-	GLenum GLEW_initialization(glewInit());
-	if (GLEW_initialization != GLEW_OK)
-	{
-		std::cerr << "Error initializing GLEW: " << glewGetErrorString(GLEW_initialization) << std::endl;
-		delete this;
+	return true;
+}
+
+bool Renderer::createHeadlessContext()
+{
+#ifdef __linux__
+	// Prefer Mesa's surfaceless platform, which needs neither X11 nor a GPU
+	EGLDisplay display(EGL_NO_DISPLAY);
+	const auto get_platform_display(reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT")));
+	if (get_platform_display)
+		display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major(0), minor(0);
+	if (display == EGL_NO_DISPLAY || eglInitialize(display, &major, &minor) != EGL_TRUE) {
+		std::cerr << "Error initializing EGL (0x" << std::hex << eglGetError() << std::dec << ")." << std::endl;
 		return false;
 	}
-	std::cout << "GLEW version " << glewGetString(GLEW_VERSION) << "." << std::endl;
+	m_egl_display = display;
+	std::cout << "EGL version " << major << "." << minor << "." << std::endl;
 
+	const EGLint config_attributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config(nullptr);
+	EGLint config_count(0);
+	if (eglChooseConfig(display, config_attributes, &config, 1, &config_count) != EGL_TRUE || config_count == 0 || eglBindAPI(EGL_OPENGL_API) != EGL_TRUE) {
+		std::cerr << "Error: no EGL configuration supports desktop OpenGL." << std::endl;
+		destroyHeadlessContext();
+		return false;
+	}
 
-	std::cout << "Built against Assimp version " << aiGetVersionMajor() << "." << aiGetVersionMinor() << "." << std::endl << std::endl;
+	// 4.3 first with GPU culling, as for windows
+	EGLContext context(EGL_NO_CONTEXT);
+	for (EGLint const major : { 4, 3 }) {
+		if (major == 4 && !m_gpu_culling)
+			continue;
+
+		const EGLint context_attributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, major,
+			EGL_CONTEXT_MINOR_VERSION, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+		if (context != EGL_NO_CONTEXT)
+			break;
+	}
+	if (context == EGL_NO_CONTEXT) {
+		std::cerr << "Error creating the EGL OpenGL 3.3 core context (0x" << std::hex << eglGetError() << std::dec << ")." << std::endl;
+		destroyHeadlessContext();
+		return false;
+	}
+	m_egl_context = context;
+
+	// The default framebuffer is never drawn to, a 1x1 pbuffer is only needed when surfaceless contexts are unsupported
+	EGLSurface surface(EGL_NO_SURFACE);
+	const char* extensions(eglQueryString(display, EGL_EXTENSIONS));
+	if (!extensions || !std::strstr(extensions, "EGL_KHR_surfaceless_context")) {
+		const EGLint pbuffer_attributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		surface = eglCreatePbufferSurface(display, config, pbuffer_attributes);
+		m_egl_surface = surface;
+	}
 
+	if (eglMakeCurrent(display, surface, surface, context) != EGL_TRUE) {
+		std::cerr << "Error making the EGL context current (0x" << std::hex << eglGetError() << std::dec << ")." << std::endl;
+		destroyHeadlessContext();
+		return false;
+	}
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_STENCIL_TEST);
+	return true;
+#else
+	std::cerr << "Error: headless mode relies on EGL and is only available on Linux." << std::endl;
+	return false;
+#endif
+}
+
+void Renderer::destroyHeadlessContext()
+{
+#ifdef __linux__
+	if (!m_egl_display)
+		return;
+
+	eglMakeCurrent(m_egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (m_egl_surface)
+		eglDestroySurface(m_egl_display, m_egl_surface);
+	if (m_egl_context)
+		eglDestroyContext(m_egl_display, m_egl_context);
+	eglTerminate(m_egl_display);
+
+	m_egl_display = m_egl_context = m_egl_surface = nullptr;
+#endif
+}
+
+// Stands in for the window's default framebuffer, with the same size and a stencil buffer
+bool Renderer::createOffscreenTarget()
+{
+	// A texture rather than a renderbuffer, the post-processing passes and the dynamic resolution upscale sample it
+	m_framebuffer_color = GLTexture::generate();
+	glBindTexture(GL_TEXTURE_2D, m_framebuffer_color.id());
+	glTexImage2D(GL_TEXTURE_2D, 0, m_hdr ? GL_RGBA16F : GL_RGBA8, m_window_width, m_window_height, 0, GL_RGBA, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	m_framebuffer_depth_stencil = GLRenderbuffer::generate();
+	glBindRenderbuffer(GL_RENDERBUFFER, m_framebuffer_depth_stencil.id());
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_window_width, m_window_height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	m_framebuffer = GLFramebuffer::generate();
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer.id());
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_framebuffer_color.id(), 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_framebuffer_depth_stencil.id());
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "Error: offscreen framebuffer is incomplete." << std::endl;
+		return false;
+	}
 
 	return true;
 }
 
 
-void Renderer::mainLoop()
+// With a benchmark, the camera follows its scripted path instead of the user input, and frames are neither capped nor synchronized
+void Renderer::mainLoop(Benchmark* const benchmark)
 {
-	constexpr Uint32 frame_rate(1000 / 60);
-	Uint32 frame_start(0), elapsed_time(0), delta_time(0), last_frame(0);
 	const float ratio(static_cast<float>(m_window_width) / static_cast<float>(m_window_height));
 	GLfloat viewport_fov(70.0f);
 
-	m_input.showCursor(false);
-	m_input.catchCursor(true);
+	if (!m_headless) {
+		m_input.showCursor(false);
+		m_input.catchCursor(true);
+	}
+	if (benchmark && !m_headless)
+		SDL_GL_SetSwapInterval(0);
 
 
 	// Matrices work
-	glm::mat4 model, view, projection;
+	glm::mat4 view, projection;
 	projection = glm::perspective(glm::radians(viewport_fov), ratio, 0.1f, 100.0f);
 	bool update_projection(false);
 
 
 	// Camera work
-	Camera camera{ glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 3.75f, 1.1f };
+	Camera camera{ glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 0.625f, 11.0f };
 	const std::map<std::string, SDL_Scancode> keys{
 		{"forward",	 static_cast<SDL_Scancode>(std::stoi(m_ini_file.GetValue("KeyboardMap", "forward", "26")))},
 		{"backward", static_cast<SDL_Scancode>(std::stoi(m_ini_file.GetValue("KeyboardMap", "backward", "22")))},
@@ -126,29 +354,98 @@ void Renderer::mainLoop()
 		{"right",	 static_cast<SDL_Scancode>(std::stoi(m_ini_file.GetValue("KeyboardMap", "right", "7")))},
 		{"run",		 static_cast<SDL_Scancode>(std::stoi(m_ini_file.GetValue("KeyboardMap", "run", "225")))},
 		{"crouch",	 static_cast<SDL_Scancode>(std::stoi(m_ini_file.GetValue("KeyboardMap", "crouch", "224")))},
-		{"jump",	 static_cast<SDL_Scancode>(std::stoi(m_ini_file.GetValue("KeyboardMap", "jump", "44")))}
+		{"jump",	 static_cast<SDL_Scancode>(std::stoi(m_ini_file.GetValue("KeyboardMap", "jump", "44")))},
+		{"profiler", static_cast<SDL_Scancode>(std::stoi(m_ini_file.GetValue("KeyboardMap", "profiler", "60")))},
+		{"trace",	 static_cast<SDL_Scancode>(std::stoi(m_ini_file.GetValue("KeyboardMap", "trace", "61")))}
 	};
 	bool player_running(false);
+	bool show_profiler(!m_headless && std::stoi(m_ini_file.GetValue("Debug", "Profiler", "0")) != 0);
 
 
-	// Shaders loading
+	// Shaders loading, all programs are submitted before any of them is used so the driver can build them in parallel
 	Shader basic_shader{ m_directory + "Shaders/basic.vert", m_directory + "Shaders/basic.frag" },
-		stencil_shader{ m_directory + "Shaders/stencil_outline.vert", m_directory + "Shaders/stencil_outline.frag" };
-	glUseProgram(stencil_shader.id());
-	stencil_shader.setUni("offset", 0.07f);
-	stencil_shader.setUni("projection", projection);
+		stencil_shader{ m_directory + "Shaders/stencil_outline.vert", m_directory + "Shaders/stencil_outline.frag" },
+		lamp_shader{ m_directory + "Shaders/lamp.vert", m_directory + "Shaders/lamp.frag" },
+		basic_oit_shader{ m_directory + "Shaders/basic.vert", m_directory + "Shaders/basic.frag", "#define WEIGHTED_BLENDED_OIT\n" },
+		depth_prepass_shader{ m_directory + "Shaders/basic.vert", m_directory + "Shaders/depth_only.frag", "#define DEPTH_PREPASS\n" },
+		skinned_shader{ m_directory + "Shaders/basic.vert", m_directory + "Shaders/basic.frag", "#define SKINNING\n" },
+		skinned_depth_prepass_shader{ m_directory + "Shaders/basic.vert", m_directory + "Shaders/depth_only.frag", "#define DEPTH_PREPASS\n#define SKINNING\n" };
+
+	// Depth pre-pass: the opaque objects are first drawn without color, then shaded with GL_EQUAL so basic.frag runs once per pixel
+	const bool depth_prepass(std::stoi(m_ini_file.GetValue("Video", "DepthPrePass", "0")) != 0);
+
+	// Transparency: objects sorted back to front on the CPU, or weighted blended OIT (no sorting, handles intersecting surfaces)
+	std::unique_ptr<WeightedBlendedOit> oit;
+	if (std::stoi(m_ini_file.GetValue("Video", "OrderIndependentTransparency", "0")) != 0) {
+		oit.reset(new WeightedBlendedOit(m_window_width, m_window_height, m_framebuffer_depth_stencil.id(), m_directory + "Shaders/"));
+		if (!oit->valid())
+			oit.reset();
+	}
 
-	glUseProgram(basic_shader.id());
-	basic_shader.setUni("material.shininess", 32.0f);
-	basic_shader.setUni("projection", projection);
+	// Outlines: objects drawn again extruded along their normals, or a fixed cost screen-space dilation of their stencil
+	std::unique_ptr<ScreenSpaceOutline> screen_space_outline;
+	if (std::stoi(m_ini_file.GetValue("Video", "ScreenSpaceOutline", "0")) != 0) {
+		screen_space_outline.reset(new ScreenSpaceOutline(m_window_width, m_window_height, m_framebuffer_depth_stencil.id(), m_directory + "Shaders/",
+			std::stoi(m_ini_file.GetValue("Video", "OutlineWidth", "3")), glm::vec4(.5f, .25f, 0.f, 1.f)));
+		if (!screen_space_outline->valid())
+			screen_space_outline.reset();
+	}
 
+	// Dynamic resolution: the scene is drawn at a fraction of the window size, adjusted to the measured GPU time of the frames
+	std::unique_ptr<DynamicResolution> dynamic_resolution;
+	if (std::stoi(m_ini_file.GetValue("Video", "DynamicResolution", "0")) != 0)
+		dynamic_resolution.reset(new DynamicResolution(m_window_width, m_window_height, std::stod(m_ini_file.GetValue("Video", "FrameBudget", "16.6")),
+			std::stof(m_ini_file.GetValue("Video", "MinResolutionScale", "0.5")), std::stof(m_ini_file.GetValue("Video", "UpscaleSharpness", "0.5")), m_directory + "Shaders/"));
+	unsigned int render_width(m_window_width), render_height(m_window_height);
+
+	// Post-processing of the HDR scene, every pass can be turned off on its own. Without it, the scene target is LDR and presented as is.
+	const RenderTarget scene_target{ m_framebuffer.id(), m_framebuffer_color.id(), m_window_width, m_window_height, m_hdr ? GL_RGBA16F : GL_RGBA8 };
+	std::unique_ptr<PostProcessChain> post_process;
+	std::unique_ptr<Bloom> bloom;
+	std::unique_ptr<ToneMapping> tone_mapping;
+	if (m_hdr) {
+		post_process.reset(new PostProcessChain(m_window_width, m_window_height));
+
+		if (std::stoi(m_ini_file.GetValue("PostProcessing", "Bloom", "1")) != 0) {
+			bloom.reset(new Bloom(std::stoi(m_ini_file.GetValue("PostProcessing", "BloomLevels", "5")), std::stof(m_ini_file.GetValue("PostProcessing", "BloomThreshold", "1.0")),
+				std::stof(m_ini_file.GetValue("PostProcessing", "BloomIntensity", "0.05")), m_directory + "Shaders/"));
+			post_process->addPass("Bloom", [&bloom](PostProcessChain& chain, RenderTarget const& input) -> RenderTarget const& {
+				return bloom->render(chain, input);
+			});
+		}
+		if (std::stoi(m_ini_file.GetValue("PostProcessing", "ToneMapping", "1")) != 0) {
+			tone_mapping.reset(new ToneMapping(std::stof(m_ini_file.GetValue("PostProcessing", "Exposure", "1.0")), m_directory + "Shaders/"));
+			post_process->addPass("Tone mapping", [&tone_mapping](PostProcessChain& chain, RenderTarget const& input) -> RenderTarget const& {
+				return tone_mapping->render(chain, input);
+			});
+		}
+	}
+
+	// Shadows of the directional light, drawn before the opaque pass
+	std::unique_ptr<CascadedShadowMap> shadows;
+	if (std::stoi(m_ini_file.GetValue("Shadows", "Enabled", "1")) != 0) {
+		shadows.reset(new CascadedShadowMap(std::stoi(m_ini_file.GetValue("Shadows", "Resolution", "2048")), std::stoi(m_ini_file.GetValue("Shadows", "Cascades", "4")),
+			std::stof(m_ini_file.GetValue("Shadows", "Distance", "50")), m_directory + "Shaders/"));
+		if (!shadows->valid())
+			shadows.reset();
+	}
 
-	// Lights setup
-	basic_shader.setUni("lights[0].type", 0);
-	basic_shader.setUni("lights[0].direction", -0.2f, -1.0f, -0.3f);
-	basic_shader.setUni("lights[0].ambient", 0.2f, 0.2f, 0.2f);
-	basic_shader.setUni("lights[0].diffuse", 0.5f, 0.5f, 0.5f);
-	basic_shader.setUni("lights[0].specular", 1.0f, 1.0f, 1.0f);
+	// GPU-driven opaque pass: plain opaque objects are culled by a compute shader and drawn through indirect commands
+	std::unique_ptr<GpuCulling> gpu_culling;
+	if (m_gpu_culling) {
+		gpu_culling.reset(new GpuCulling(m_directory + "Shaders/"));
+		if (!gpu_culling->valid())
+			gpu_culling.reset();
+	}
+
+	// Particles simulated with transform feedback next to the nanosuit, drawn within the transparent pass
+	std::unique_ptr<ParticleSystem> particles;
+	if (std::stoi(m_ini_file.GetValue("Particles", "Enabled", "0")) != 0) {
+		particles.reset(new ParticleSystem(static_cast<size_t>(std::max(1, std::stoi(m_ini_file.GetValue("Particles", "Count", "1000000")))), glm::vec3(6.f, -10.f, -5.f),
+			std::stof(m_ini_file.GetValue("Particles", "Size", "0.05")), std::stof(m_ini_file.GetValue("Particles", "Lifetime", "3.0")), m_window_width, m_window_height, m_directory + "Shaders/"));
+		if (!particles->valid())
+			particles.reset();
+	}
 
 	glm::vec3 point_lights_pos[] = {
 		glm::vec3(0.7f, 0.2f, 2.0f),
@@ -156,64 +453,479 @@ void Renderer::mainLoop()
 		glm::vec3(-4.0f, 2.0f, -12.0f),
 		glm::vec3(0.0f, 0.0f, -3.0f)
 	};
-	size_t i = 1;
-	for (glm::vec3 const& light_pos : point_lights_pos) {
-		basic_shader.setUni("lights[" + std::to_string(i) + "].type", 1);
-		basic_shader.setUni("lights[" + std::to_string(i) + "].position", light_pos);
-		basic_shader.setUni("lights[" + std::to_string(i) + "].ambient", 0.2f, 0.2f, 0.2f);
-		basic_shader.setUni("lights[" + std::to_string(i) + "].diffuse", 0.5f, 0.5f, 0.5f);
-		basic_shader.setUni("lights[" + std::to_string(i) + "].specular", 1.0f, 1.0f, 1.0f);
-		basic_shader.setUni("lights[" + std::to_string(i) + "].constant", 1.0f);
-		basic_shader.setUni("lights[" + std::to_string(i) + "].linear", 0.09f);
-		basic_shader.setUni("lights[" + std::to_string(i) + "].quadratic", 0.032f);
-
-		i++;
-	}
 
-	basic_shader.setUni("lights[5].type", 2);
-	basic_shader.setUni("lights[5].cutoff", glm::cos(glm::radians(12.5f)));
-	basic_shader.setUni("lights[5].outer_cutoff", glm::cos(glm::radians(17.5f)));
-	basic_shader.setUni("lights[5].ambient", 0.2f, 0.2f, 0.2f);
-	basic_shader.setUni("lights[5].diffuse", 0.5f, 0.5f, 0.5f);
-	basic_shader.setUni("lights[5].specular", 1.0f, 1.0f, 1.0f);
-	basic_shader.setUni("lights[5].constant", 1.0f);
-	basic_shader.setUni("lights[5].linear", 0.09f);
-	basic_shader.setUni("lights[5].quadratic", 0.032f);
+	// Lights setup, uploaded every frame with the flashlight (lights[5]) following the camera
+	std::array<LightBlock, LIGHTS_COUNT> lights{};
+	lights[0].type = 0;
+	lights[0].direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+	lights[0].ambient = glm::vec3(0.2f, 0.2f, 0.2f);
+	lights[0].diffuse = glm::vec3(0.5f, 0.5f, 0.5f);
+	lights[0].specular = glm::vec3(1.0f, 1.0f, 1.0f);
+
+	for (size_t i = 1; i < LIGHTS_COUNT; i++) {
+		lights[i].type = 1;
+		lights[i].ambient = glm::vec3(0.2f, 0.2f, 0.2f);
+		lights[i].diffuse = glm::vec3(0.5f, 0.5f, 0.5f);
+		lights[i].specular = glm::vec3(1.0f, 1.0f, 1.0f);
+		lights[i].constant = 1.0f;
+		lights[i].linear = 0.09f;
+		lights[i].quadratic = 0.032f;
+	}
+	for (size_t i = 0; i < 4; i++)
+		lights[i + 1].position = point_lights_pos[i];
+
+	lights[5].type = 2;
+	lights[5].cutoff = glm::cos(glm::radians(12.5f));
+	lights[5].outer_cutoff = glm::cos(glm::radians(17.5f));
+
+	// Uniforms that don't change every frame, set again whenever a program gets reloaded
+	const auto setup_shaders = [&]() {
+		stencil_shader.use();
+		stencil_shader.setUni("offset", 0.07f);
+
+		// The shadow sampler keeps its own unit even without shadows, it can't share one with the material's 2D samplers
+		basic_shader.use();
+		basic_shader.setUni("material.diffuse", static_cast<int>(MATERIAL_DIFFUSE_UNIT));
+		basic_shader.setUni("material.specular", static_cast<int>(MATERIAL_SPECULAR_UNIT));
+		basic_shader.setUni("shadow_map", static_cast<int>(SHADOW_MAP_TEXTURE_UNIT));
+
+		basic_shader.bindBlock("Object", OBJECT_BLOCK_BINDING);
+		basic_shader.bindBlock("Lights", LIGHTS_BLOCK_BINDING);
+		basic_shader.bindBlock("Shadows", SHADOWS_BLOCK_BINDING);
+
+		basic_oit_shader.use();
+		basic_oit_shader.setUni("material.diffuse", static_cast<int>(MATERIAL_DIFFUSE_UNIT));
+		basic_oit_shader.setUni("material.specular", static_cast<int>(MATERIAL_SPECULAR_UNIT));
+		basic_oit_shader.setUni("shadow_map", static_cast<int>(SHADOW_MAP_TEXTURE_UNIT));
+		basic_oit_shader.bindBlock("Object", OBJECT_BLOCK_BINDING);
+		basic_oit_shader.bindBlock("Lights", LIGHTS_BLOCK_BINDING);
+		basic_oit_shader.bindBlock("Shadows", SHADOWS_BLOCK_BINDING);
+
+		stencil_shader.bindBlock("Object", OBJECT_BLOCK_BINDING);
+		lamp_shader.bindBlock("Object", OBJECT_BLOCK_BINDING);
+		depth_prepass_shader.bindBlock("Object", OBJECT_BLOCK_BINDING);
+
+		skinned_shader.use();
+		skinned_shader.setUni("material.diffuse", static_cast<int>(MATERIAL_DIFFUSE_UNIT));
+		skinned_shader.setUni("material.specular", static_cast<int>(MATERIAL_SPECULAR_UNIT));
+		skinned_shader.setUni("shadow_map", static_cast<int>(SHADOW_MAP_TEXTURE_UNIT));
+		skinned_shader.setUni("palette", static_cast<int>(SKINNING_PALETTE_TEXTURE_UNIT));
+		skinned_shader.bindBlock("Object", OBJECT_BLOCK_BINDING);
+		skinned_shader.bindBlock("Lights", LIGHTS_BLOCK_BINDING);
+		skinned_shader.bindBlock("Shadows", SHADOWS_BLOCK_BINDING);
+
+		skinned_depth_prepass_shader.use();
+		skinned_depth_prepass_shader.setUni("palette", static_cast<int>(SKINNING_PALETTE_TEXTURE_UNIT));
+		skinned_depth_prepass_shader.bindBlock("Object", OBJECT_BLOCK_BINDING);
+
+		if (gpu_culling) {
+			Shader const& gpu_shader(gpu_culling->drawShader());
+			gpu_shader.use();
+			gpu_shader.setUni("material.diffuse", static_cast<int>(MATERIAL_DIFFUSE_UNIT));
+			gpu_shader.setUni("material.specular", static_cast<int>(MATERIAL_SPECULAR_UNIT));
+			gpu_shader.setUni("shadow_map", static_cast<int>(SHADOW_MAP_TEXTURE_UNIT));
+			gpu_shader.bindBlock("Lights", LIGHTS_BLOCK_BINDING);
+			gpu_shader.bindBlock("Shadows", SHADOWS_BLOCK_BINDING);
+		}
 
+		if (shadows) {
+			shadows->depthShader().bindBlock("Object", OBJECT_BLOCK_BINDING);
+			shadows->invalidate();
+		}
 
-	Shader lamp_shader{ m_directory + "Shaders/lamp.vert", m_directory + "Shaders/lamp.frag" };
-	glUseProgram(lamp_shader.id());
-	lamp_shader.setUni("projection", projection);
+		glUseProgram(0);
+	};
+	setup_shaders();
+
+	ShaderWatcher shader_watcher{ m_directory + "Shaders/" };
+	// Edits of the loose files wouldn't be seen with the shaders coming from an archive
+	const bool hot_reload(!benchmark && !FileSystem::mounted() && std::stoi(m_ini_file.GetValue("Debug", "ShaderHotReload", "1")) != 0);
+	if (hot_reload) {
+		shader_watcher.watch(basic_shader);
+		shader_watcher.watch(stencil_shader);
+		shader_watcher.watch(lamp_shader);
+		shader_watcher.watch(basic_oit_shader);
+		shader_watcher.watch(depth_prepass_shader);
+		shader_watcher.watch(skinned_shader);
+		shader_watcher.watch(skinned_depth_prepass_shader);
+		if (dynamic_resolution)
+			shader_watcher.watch(dynamic_resolution->upscaleShader());
+		if (bloom) {
+			shader_watcher.watch(bloom->downsampleShader());
+			shader_watcher.watch(bloom->upsampleShader());
+			shader_watcher.watch(bloom->compositeShader());
+		}
+		if (tone_mapping)
+			shader_watcher.watch(tone_mapping->shader());
+		if (shadows)
+			shader_watcher.watch(shadows->depthShader());
+		if (oit)
+			shader_watcher.watch(oit->compositeShader());
+		if (gpu_culling) {
+			shader_watcher.watch(gpu_culling->cullShader());
+			shader_watcher.watch(gpu_culling->drawShader());
+			shader_watcher.watch(gpu_culling->depthShader());
+		}
+		if (particles) {
+			shader_watcher.watch(particles->updateShader());
+			shader_watcher.watch(particles->drawShader());
+			shader_watcher.watch(particles->oitDrawShader());
+		}
+		if (screen_space_outline) {
+			shader_watcher.watch(screen_space_outline->maskShader());
+			shader_watcher.watch(screen_space_outline->dilateShader());
+			shader_watcher.watch(screen_space_outline->compositeShader());
+		}
+	}
 
-	glUseProgram(0);
 
+	// Texture streaming: only the coarse mip levels are loaded with the models, the finer ones follow the size of the models on screen
+	std::unique_ptr<TextureStreamer> texture_streamer;
+	if (std::stoi(m_ini_file.GetValue("Textures", "Streaming", "1")) != 0)
+		texture_streamer.reset(new TextureStreamer(static_cast<size_t>(std::stoi(m_ini_file.GetValue("Textures", "Budget", "256"))) * 1024 * 1024,
+			std::stoi(m_ini_file.GetValue("Textures", "ResidentSize", "64"))));
 
 	// Models loading
-	Model cube{ m_directory + "Models/cube/cube.obj" };
-	Model nanosuit{ m_directory + "Models/nanosuit/nanosuit.obj", GL_REPEAT };
-	Model blades{ m_directory + "Models/blades/blades.obj", GL_CLAMP_TO_EDGE };
-	Model window{ m_directory + "Models/transparent_window/transparent_window.obj", GL_CLAMP_TO_EDGE };
-	const std::vector<glm::vec3> objects = { glm::vec3(0, 1.f, -2.f), glm::vec3(0, 0.f, -3.f) };
+	Model cube{ m_directory + "Models/cube/cube.obj", GL_REPEAT, texture_streamer.get(), depth_prepass };
+	Model nanosuit{ m_directory + "Models/nanosuit/nanosuit.obj", GL_REPEAT, texture_streamer.get(), depth_prepass };
+	Model blades{ m_directory + "Models/blades/blades.obj", GL_CLAMP_TO_EDGE, texture_streamer.get() };
+	Model window{ m_directory + "Models/transparent_window/transparent_window.obj", GL_CLAMP_TO_EDGE, texture_streamer.get() };
+
+	// Skeletal animation: instances of a rigged model, posed on the workers and skinned in the vertex shader
+	std::unique_ptr<Model> character;
+	const std::string character_file(m_ini_file.GetValue("Animation", "Model", ""));
+	if (!character_file.empty()) {
+		character.reset(new Model(m_directory + character_file, GL_REPEAT, texture_streamer.get(), depth_prepass));
+		if (!character->skeleton() || character->animations().empty()) {
+			std::cout << "Model \"" << character_file << "\" has no skeleton or no animation, it isn't instanced." << std::endl;
+			character.reset();
+		}
+	}
+	std::cout << "Assets: " << FileSystem::archiveReads() << " files read from the archive, " << FileSystem::diskReads() << " from the disk." << std::endl;
+
+	Scene scene{ std::stoi(m_ini_file.GetValue("Video", "MeshletCulling", "1")) != 0 };
+	for (glm::vec3 const& light_pos : point_lights_pos)
+		scene.add(cube, light_pos, glm::vec3(0.2f), 1 << PASS_LAMPS);
+	scene.add(nanosuit, glm::vec3(0, -10.f, -5.f), glm::vec3(1.f), (1 << PASS_OPAQUE) | (1 << PASS_OUTLINE));
+	// Plain opaque objects, drawn by GpuCulling when it's enabled (the outlined nanosuit stays on the CPU path)
+	const int cube_grid(std::max(0, std::stoi(m_ini_file.GetValue("Video", "CubeGrid", "12"))));
+	for (int i = 0; i < cube_grid * cube_grid; i++)
+		scene.add(cube, glm::vec3(1.5f * (static_cast<float>(i % cube_grid) - cube_grid * .5f), -10.5f, -5.f - 1.5f * (static_cast<float>(i / cube_grid) - cube_grid * .5f)),
+			glm::vec3(.5f), 1 << PASS_OPAQUE);
+	scene.add(window, glm::vec3(0, 1.f, -2.f), glm::vec3(1.f), 1 << PASS_TRANSPARENT);
+	scene.add(blades, glm::vec3(0, 0.f, -3.f), glm::vec3(1.f), 1 << PASS_TRANSPARENT);
+
+	// A grid behind the nanosuit, every instance with its own clip, speed, phase and blend so that none move in step
+	if (character) {
+		const int count(std::max(0, std::stoi(m_ini_file.GetValue("Animation", "Count", "300"))));
+		const float scale(std::stof(m_ini_file.GetValue("Animation", "Scale", "1.0")));
+		const int columns(static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count)))));
+		const float spacing(2.f * character->radius() * scale);
+		const size_t clips(character->animations().size());
+
+		for (int i = 0; i < count; i++) {
+			const glm::vec3 position((static_cast<float>(i % columns) - columns * .5f) * spacing, -10.f, -10.f - static_cast<float>(i / columns) * spacing);
+			const size_t animation(scene.addAnimated(*character, position, glm::vec3(scale), static_cast<size_t>(i) % clips, .8f + .05f * static_cast<float>(i % 9), .37f * static_cast<float>(i)));
+			if (clips > 1)
+				scene.animations().setBlend(animation, static_cast<size_t>(i + 1) % clips, .2f * static_cast<float>(i % 5));
+		}
+	}
+
+
+	// Threading: culling and sorting run on the workers. When pipelined, the commands of frame N + 1 are built
+	// while frame N is submitted, at the cost of one frame of latency.
+	JobSystem jobs{ static_cast<unsigned int>(std::stoi(m_ini_file.GetValue("Threading", "Workers", "0"))) };
+	const bool pipelining(std::stoi(m_ini_file.GetValue("Threading", "Pipelining", "1")) != 0);
+	std::array<FrameCommands, 2> frame_commands;
+	DynamicRingBuffer uniforms{ GL_UNIFORM_BUFFER, DYNAMIC_BUFFER_REGION_SIZE };
+	double animation_time(0.0);
+
+	// Skinning palettes, read through a buffer texture. Scenes without animated instances never allocate from it.
+	DynamicRingBuffer palettes{ GL_TEXTURE_BUFFER, character ? PALETTE_BUFFER_REGION_SIZE : 16 };
+	GLTexture palette_texture(GLTexture::generate());
+	glBindTexture(GL_TEXTURE_BUFFER, palette_texture.id());
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, palettes.id());
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	GLint max_palette_texels(0);
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_palette_texels);
+	if (character && static_cast<GLsizeiptr>(max_palette_texels) < PALETTE_BUFFER_REGION_SIZE * DynamicRingBuffer::s_regions / static_cast<GLsizeiptr>(sizeof(glm::vec4)))
+		std::cerr << "Warning: the skinning palettes exceed GL_MAX_TEXTURE_BUFFER_SIZE (" << max_palette_texels << " texels)." << std::endl;
+	size_t frame_index(0);
+
+	// Load/unload cycles, every GL object they create must be gone once they are destroyed
+	if (benchmark) {
+		benchmark->checkObjectLifetimes("model", 3, [&]() {
+			Model model{ m_directory + "Models/nanosuit/nanosuit.obj", GL_REPEAT, texture_streamer.get(), depth_prepass };
+		});
+		benchmark->checkObjectLifetimes("render target", 3, [&]() {
+			RenderTargetPool pool;
+			pool.release(pool.acquire(m_window_width, m_window_height, GL_RGBA16F));
+		});
+	}
 
 
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer.id());
 	glViewport(0, 0, m_window_width, m_window_height);
 	glEnable(GL_CULL_FACE);
 
 
+	// Created once everything is loaded, so that the loading time isn't taken for the first frame's
+	FrameScheduler scheduler{ m_ini_file };
+
+	// Only issues GL calls, every decision has been taken while building the commands
+	const auto replay = [&](FrameCommands const& commands) {
+		uniforms.commit(commands.region);
+		palettes.commit(commands.palette_region);
+		glActiveTexture(GL_TEXTURE0 + SKINNING_PALETTE_TEXTURE_UNIT);
+		glBindTexture(GL_TEXTURE_BUFFER, palette_texture.id());
+		glActiveTexture(GL_TEXTURE0);
+
+		if (texture_streamer) {
+			PROFILE_PASS("Texture streaming");
+			texture_streamer->update(commands, render_height);
+		}
+
+		if (shadows) {
+			shadows->render(commands, uniforms);
+			shadows->bindTexture(SHADOW_MAP_TEXTURE_UNIT);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer.id());
+			glViewport(0, 0, render_width, render_height);
+		}
+
+		if (gpu_culling) {
+			PROFILE_PASS("GPU culling");
+			gpu_culling->cull(scene, commands);
+		}
+
+		// Long frames are clamped so that a hitch doesn't throw every particle across the scene
+		if (particles) {
+			PROFILE_PASS("Particles update");
+			particles->update(static_cast<float>(std::min(scheduler.frameTime(), .1)));
+		}
+
+		// Fancy work starts here:
+		{
+			PROFILE_PASS("Lamps");
+
+			glDisable(GL_BLEND);
+			glStencilMask(0x00);
+			lamp_shader.use();
+
+			for (DrawPacket const& packet : commands.passes[PASS_LAMPS]) {
+				uniforms.bindRange(OBJECT_BLOCK_BINDING, packet.object);
+				packet.model->Draw(lamp_shader);
+			}
+		}
+
+		if (depth_prepass) {
+			PROFILE_PASS("Depth pre-pass");
+
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			glStencilMask(0x00);
+			depth_prepass_shader.use();
+
+			for (DrawPacket const& packet : commands.passes[PASS_OPAQUE]) {
+				uniforms.bindRange(OBJECT_BLOCK_BINDING, packet.object);
+				if (packet.meshlets != NO_MESHLET_RANGES)
+					packet.model->DrawDepth(commands.meshlets, packet.meshlets);
+				else
+					packet.model->DrawDepth();
+			}
+
+			if (!commands.skinned.empty()) {
+				skinned_depth_prepass_shader.use();
+				for (DrawPacket const& packet : commands.skinned) {
+					uniforms.bindRange(OBJECT_BLOCK_BINDING, packet.object);
+					skinned_depth_prepass_shader.setUni("palette_offset", packet.palette);
+					packet.model->DrawDepth();
+				}
+			}
+
+			if (gpu_culling) {
+				gpu_culling->depthShader().use();
+				gpu_culling->drawDepth();
+			}
+
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		}
+
+		{
+			PROFILE_PASS("Opaque");
+
+			// Only the nearest surface passes after the pre-pass, its depth is already written
+			if (depth_prepass) {
+				glDepthFunc(GL_EQUAL);
+				glDepthMask(GL_FALSE);
+			}
+			Profiler::beginFragmentCount(static_cast<unsigned long long>(render_width) * static_cast<unsigned long long>(render_height));
+
+			basic_shader.use();
+			basic_shader.setUni("view_pos", commands.camera_position);
+			uniforms.bindRange(LIGHTS_BLOCK_BINDING, commands.lights);
+			uniforms.bindRange(SHADOWS_BLOCK_BINDING, commands.shadows);
+
+			// Stencil is set to 1 where objects to outline are visible
+			glStencilMask(0xFF);
+			glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+
+			for (DrawPacket const& packet : commands.passes[PASS_OPAQUE]) {
+				glStencilFunc(GL_ALWAYS, (packet.passes & (1 << PASS_OUTLINE)) ? 1 : 0, 0xFF);
+				uniforms.bindRange(OBJECT_BLOCK_BINDING, packet.object);
+				if (packet.meshlets != NO_MESHLET_RANGES)
+					packet.model->Draw(basic_shader, commands.meshlets, packet.meshlets);
+				else
+					packet.model->Draw(basic_shader);
+			}
+			Profiler::countMeshlets(commands.meshlets.tested, commands.meshlets.visible);
+
+			if (!commands.skinned.empty()) {
+				glStencilFunc(GL_ALWAYS, 0, 0xFF);
+				skinned_shader.use();
+				skinned_shader.setUni("view_pos", commands.camera_position);
+				for (DrawPacket const& packet : commands.skinned) {
+					uniforms.bindRange(OBJECT_BLOCK_BINDING, packet.object);
+					skinned_shader.setUni("palette_offset", packet.palette);
+					packet.model->Draw(skinned_shader);
+				}
+			}
+			Profiler::countPoses(commands.poses.instances, commands.poses.bones, commands.poses.cpu_ms);
+
+			if (gpu_culling) {
+				glStencilFunc(GL_ALWAYS, 0, 0xFF);
+				gpu_culling->drawShader().use();
+				gpu_culling->drawShader().setUni("view_pos", commands.camera_position);
+				gpu_culling->draw();
+			}
+
+			Profiler::endFragmentCount();
+			if (depth_prepass) {
+				glDepthFunc(GL_LESS);
+				glDepthMask(GL_TRUE);
+			}
+		}
+
+		if (oit) {
+			PROFILE_PASS("Transparent");
+
+			glStencilMask(0x00);
+			glDisable(GL_CULL_FACE);
+			if (particles)
+				particles->copyDepth(m_framebuffer.id(), render_width, render_height);
+			oit->begin();
+
+			basic_oit_shader.use();
+			basic_oit_shader.setUni("view_pos", commands.camera_position);
+
+			for (DrawPacket const& packet : commands.passes[PASS_TRANSPARENT]) {
+				uniforms.bindRange(OBJECT_BLOCK_BINDING, packet.object);
+				packet.model->Draw(basic_oit_shader);
+			}
+
+			// Accumulated with the surfaces, which attenuate them and are attenuated by them in any order
+			if (particles)
+				particles->drawOit(commands.view, commands.projection);
+
+			Material::unbind();
+			oit->composite(m_framebuffer.id());
+		}
+		else {
+			PROFILE_PASS("Transparent");
+
+			glStencilMask(0x00);
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glDisable(GL_CULL_FACE);
+			// Back to front needs no depth writes, which would hide the particles behind the surfaces drawn before them
+			glDepthMask(GL_FALSE);
+
+			// The particles are sorted as a whole at their emitter, with the same squared distance as the packets
+			bool particles_drawn(!particles);
+			float emitter_depth(0.f);
+			if (particles) {
+				glm::vec3 const emitter_offset(particles->emitter() - commands.camera_position);
+				emitter_depth = glm::dot(emitter_offset, emitter_offset);
+				particles->copyDepth(m_framebuffer.id(), render_width, render_height);
+			}
+
+			for (DrawPacket const& packet : commands.passes[PASS_TRANSPARENT]) {
+				if (!particles_drawn && packet.depth < emitter_depth) {
+					Material::unbind();
+					particles->draw(commands.view, commands.projection);
+					particles_drawn = true;
+					basic_shader.use();
+				}
+
+				uniforms.bindRange(OBJECT_BLOCK_BINDING, packet.object);
+				packet.model->Draw(basic_shader);
+			}
+
+			Material::unbind();
+			if (!particles_drawn)
+				particles->draw(commands.view, commands.projection);
+			glDepthMask(GL_TRUE);
+		}
+
+		if (screen_space_outline) {
+			PROFILE_PASS("Outline");
+
+			screen_space_outline->render(m_framebuffer.id(), render_width, render_height);
+			glEnable(GL_CULL_FACE);
+		}
+		else {
+			PROFILE_PASS("Outline");
+
+			glDisable(GL_BLEND);
+			glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
+			glStencilMask(0x00);
+			//glDisable(GL_DEPTH_TEST);
+			stencil_shader.use();
+			glEnable(GL_CULL_FACE);
+
+			for (DrawPacket const& packet : commands.passes[PASS_OUTLINE]) {
+				uniforms.bindRange(OBJECT_BLOCK_BINDING, packet.object);
+				packet.model->Draw(stencil_shader, false);
+			}
+		}
+
+		glStencilMask(0xFF);
+		//glEnable(GL_DEPTH_TEST);
+		glBindVertexArray(0);
+		glUseProgram(0);
+
+		uniforms.fence(commands.region);
+		palettes.fence(commands.palette_region);
+	};
+
+
 
 
 	// Main loop
-	while (!m_input.end())
+	while (benchmark ? benchmark->running() : !m_input.end())
 	{
-		frame_start = SDL_GetTicks();
-		delta_time = frame_start - last_frame;
-		last_frame = frame_start;
+		// The jobs of the last frame are done, the memory they were allocated from can be reused once they're all released
+		jobs.waitReleased();
+		FrameArena::resetAll();
+
+		scheduler.beginFrame();
+		Profiler::newFrame(scheduler.frameTime());
+		if (benchmark)
+			benchmark->nextFrame(scheduler.frameTime());
+		else
+			m_input.updateEvents();
 
-		m_input.updateEvents();
 		if (m_input.isKeyPressed(SDL_SCANCODE_ESCAPE))
 			break;
 
+		if (hot_reload && shader_watcher.update())
+			setup_shaders();
+
+		if (m_input.isKeyReleased(keys.at("profiler")))
+			show_profiler = !show_profiler;
+		if (m_input.isKeyReleased(keys.at("trace")))
+			Profiler::exportChromeTrace(m_directory + "trace.json");
+
 		if (m_input.hasWheelMoved() && ((m_input.getWheelY() < 0 && viewport_fov < 100.0f) || (m_input.getWheelY() > 0 && viewport_fov > 30.0f)))
 		{
 			viewport_fov -= m_input.getWheelY() * 5;
@@ -236,97 +948,120 @@ void Renderer::mainLoop()
 		if (update_projection)
 			projection = glm::perspective(glm::radians(viewport_fov), ratio, 0.1f, 100.0f);
 
-		camera.shift(m_input, keys, delta_time / 100.0f);
-		view = camera.lookAt(); // Should the camera.lookAt() return value be passed directly to the view uniform, removing the need for the view var
+		// Looking around is applied every frame to keep latency low, movement runs at the fixed simulation rate
+		if (m_input.hasMiceMoved())
+			camera.orientate(m_input.getXRel(), m_input.getYRel());
+		{
+			PROFILE_SCOPE("Update");
+			while (scheduler.step())
+				camera.shift(m_input, keys, scheduler.fixedDelta());
+		}
+
+		if (benchmark) {
+			camera.setPosition(benchmark->cameraPosition());
+			camera.setTarget(benchmark->cameraTarget());
+		}
 
+		const float alpha(scheduler.alpha());
+		const glm::vec3 camera_position(camera.getPosition(alpha));
+		view = camera.lookAt(alpha); // Should the camera.lookAt() return value be passed directly to the view uniform, removing the need for the view var
+
+
+		FrameCommands& building(frame_commands[frame_index % frame_commands.size()]);
+		building.view = view;
+		building.projection = projection;
+		building.camera_position = camera_position;
+		building.camera_front = camera.getOrientation();
+		building.region = uniforms.beginFrame();
+		building.sort_transparent = !oit;
+		building.gpu_culling = static_cast<bool>(gpu_culling);
+		building.animation_time = animation_time;
+		building.palette_region = palettes.beginFrame();
+		animation_time += scheduler.frameTime();
+
+		lights[5].position = building.camera_position;
+		lights[5].direction = building.camera_front;
+		building.lights = uniforms.allocate(building.region, sizeof(lights));
+		if (building.lights.data)
+			std::memcpy(building.lights.data, lights.data(), sizeof(lights));
+
+		// Cascades whose projection and casters didn't change since they were drawn aren't culled nor drawn again
+		ShadowBlock shadow_block{};
+		building.cascade_count = 0;
+		building.cascade_redraw = 0;
+		if (shadows)
+			shadow_block = shadows->fit(lights[0].direction, scene.transforms().version(), building);
+		building.shadows = uniforms.allocate(building.region, sizeof(shadow_block));
+		if (building.shadows.data)
+			std::memcpy(building.shadows.data, &shadow_block, sizeof(shadow_block));
+
+		const std::shared_ptr<Job> build(scene.buildCommands(jobs, uniforms, palettes, building));
+
+		// Every pass renders to the bottom-left corner of the targets, the fullscreen ones address them by fragment coordinates
+		if (dynamic_resolution) {
+			dynamic_resolution->update(Profiler::gpuTime({ "Lamps", "Depth pre-pass", "Opaque", "Transparent", "Outline", "Bloom", "Tone mapping" }),
+				Profiler::counters().gpu_ms);
+			render_width = dynamic_resolution->width();
+			render_height = dynamic_resolution->height();
+		}
 
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer.id());
+		glViewport(0, 0, render_width, render_height);
 		glClearColor(.125f, .25f, .25f, 1.f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
+		// Frame N + 1 being built by the workers, frame N is submitted meanwhile. Nothing has been built yet on the first frame.
+		if (!pipelining)
+			jobs.wait(build);
+		if (!pipelining || frame_index > 0)
+			replay(pipelining ? frame_commands[(frame_index + 1) % frame_commands.size()] : building);
+
+		RenderTarget const& frame(post_process ? post_process->run(scene_target, render_width, render_height) : scene_target);
+
+		if (!m_headless) {
+			PROFILE_PASS("Present");
+
+			if (dynamic_resolution)
+				dynamic_resolution->present(frame.framebuffer, frame.texture);
+			else {
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, frame.framebuffer);
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+				glBlitFramebuffer(0, 0, m_window_width, m_window_height, 0, 0, m_window_width, m_window_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			}
+		}
 
-		// Fancy work starts here:
-		glDisable(GL_BLEND);
-		glStencilMask(0x00);
-		glUseProgram(lamp_shader.id());
-
-		if (update_projection)
-			lamp_shader.setUni("projection", projection);
-		lamp_shader.setUni("view", view);
-
-		for (glm::vec3 const& light_pos : point_lights_pos) {
-			model = glm::translate(glm::mat4(1.f), light_pos);
-			model = glm::scale(model, glm::vec3(0.2f));
-			lamp_shader.setUni("model", model);
+		if (show_profiler) {
+			PROFILE_PASS("Overlay");
 
-			cube.Draw(lamp_shader);
+			ImGui_ImplOpenGL3_NewFrame();
+			ImGui_ImplSDL2_NewFrame(m_window.get());
+			ImGui::NewFrame();
+			Profiler::drawOverlay();
+			ImGui::Render();
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 		}
 
-		// Distance sorting
-		std::map<float, glm::vec3> sorted;
-		for (size_t i = 0; i < objects.size(); i++)
-		{
-			float distance = glm::length(camera.getPosition() - objects[i]);
-			sorted[distance] = objects[i];
+		if (m_headless) {
+			// Nothing throttles an offscreen context, waiting makes frame times include the GPU work
+			PROFILE_SCOPE("Finish");
+			glFinish();
 		}
-
-
-		glUseProgram(basic_shader.id());
-
-		if (update_projection)
-			basic_shader.setUni("projection", projection);
-		basic_shader.setUni("view", view);
-		basic_shader.setUni("view_pos", camera.getPosition());
-		basic_shader.setUni("lights[5].position", camera.getPosition());
-		basic_shader.setUni("lights[5].direction", camera.getOrientation());
-
-		glStencilFunc(GL_ALWAYS, 1, 0xFF);
-		glStencilMask(0xFF);
-		glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-
-		model = glm::translate(glm::mat4(1.f), glm::vec3(0, -10.f, -5.f));
-		basic_shader.setUni("model", model);
-		nanosuit.Draw(basic_shader);
-
-		glStencilMask(0x00);
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glDisable(GL_CULL_FACE);
-
-		for (std::map<float, glm::vec3>::reverse_iterator it = sorted.rbegin(); it != sorted.rend(); ++it)
-		{
-			model = glm::translate(glm::mat4(), it->second);
-			basic_shader.setUni("model", model);
-
-			if (it->second == glm::vec3(0, 0.f, -3.f))
-				blades.Draw(basic_shader);
-			else
-				window.Draw(basic_shader);
+		else {
+			PROFILE_SCOPE("Swap");
+			SDL_GL_SwapWindow(m_window.get());
 		}
 
+		if (pipelining) {
+			PROFILE_SCOPE("Wait");
+			jobs.wait(build);
+		}
+		frame_index++;
 
-		glDisable(GL_BLEND);
-		glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-		glStencilMask(0x00);
-		//glDisable(GL_DEPTH_TEST);
-		glUseProgram(stencil_shader.id());
-		glEnable(GL_CULL_FACE);
-
-		if (update_projection)
-			stencil_shader.setUni("projection", projection);
-		model = glm::translate(glm::mat4(1.f), glm::vec3(0, -10.f, -5.f));
-		stencil_shader.setUni("view", view);
-		stencil_shader.setUni("model", model);
-		nanosuit.Draw(stencil_shader, false);
-
-		glStencilMask(0xFF);
-		//glEnable(GL_DEPTH_TEST);
-		glBindVertexArray(0);
-		glUseProgram(0);
-
-		SDL_GL_SwapWindow(m_window.get());
-
-		elapsed_time = SDL_GetTicks() - frame_start;
-		if (elapsed_time < frame_rate)
-			SDL_Delay(frame_rate - elapsed_time);
+		if (!benchmark)
+			scheduler.endFrame();
 	}
+
+	if (benchmark)
+		benchmark->writeReport(m_window_width, m_window_height);
 }
@@ -6,6 +6,8 @@
 #include <SDL.h>
 #include <SimpleIni.h>
 
+#include "Benchmark.h"
+#include "GLHandle.h"
 #include "Input.h"
 #include "SDLDeleters.hpp"
 
@@ -15,11 +17,16 @@ class Renderer
 public:
 	Renderer(std::string const& window_title, std::string const& directory, CSimpleIniA const& ini_file);
 	~Renderer();
-	bool init();
+	bool init(bool const& headless = false);
 
-	void mainLoop();
+	void mainLoop(Benchmark* const benchmark = nullptr);
 
 private:
+	bool createWindow();
+	bool createHeadlessContext();
+	void destroyHeadlessContext();
+	bool createOffscreenTarget();
+
 	const std::string& m_window_title;
 	unsigned int m_window_width;
 	unsigned int m_window_height;
@@ -28,6 +35,18 @@ private:
 	std::unique_ptr<SDL_Window, SDLDeleters> m_window;
 	SDL_GLContext m_context;
 
+	// Headless mode: EGL objects (kept opaque to avoid leaking EGL headers)
+	bool m_headless;
+	void* m_egl_display;
+	void* m_egl_context;
+	void* m_egl_surface;
+	// Offscreen target the scene is rendered to (color texture, depth-stencil renderbuffer), copied to the window (if any) at the end of the frame
+	GLFramebuffer m_framebuffer;
+	GLTexture m_framebuffer_color;
+	GLRenderbuffer m_framebuffer_depth_stencil;
+	bool m_hdr; // RGBA16F scene color, resolved by the post-processing chain
+	bool m_gpu_culling; // requested in the settings, then only kept when the context is at least 4.3
+
 	const CSimpleIniA& m_ini_file;
 
 	Input m_input;
@@ -0,0 +1,319 @@
+#include "Scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#include "FrameArena.h"
+#include "MatrixBatch.h"
+#include "Profiler.h"
+#include "UniformBlocks.h"
+
+
+Scene::Scene(bool const& meshlet_culling) : m_objects(), m_transforms(), m_animations(), m_meshlet_culling(meshlet_culling)
+{
+}
+
+Scene::~Scene()
+{
+}
+
+
+// Returns the object's transform handle, to move it later through transforms()
+size_t Scene::add(Model const& model, glm::vec3 const& position, glm::vec3 const& scale, unsigned int const& passes)
+{
+	const size_t transform(m_transforms.create(position, glm::quat(1.f, 0.f, 0.f, 0.f), scale));
+	m_objects.push_back({ &model, transform, passes, NO_ANIMATION });
+	return transform;
+}
+
+// Animated objects are opaque, the model must have a skeleton and clip must index its animations.
+// Returns the animation handle, to blend clips later through animations().
+size_t Scene::addAnimated(Model const& model, glm::vec3 const& position, glm::vec3 const& scale, size_t const& clip, float const& speed, float const& phase)
+{
+	const size_t transform(m_transforms.create(position, glm::quat(1.f, 0.f, 0.f, 0.f), scale));
+	const size_t animation(m_animations.create(m_objects.size(), model, clip, speed, phase));
+	m_objects.push_back({ &model, transform, 1u << PASS_OPAQUE, animation });
+	return animation;
+}
+
+TransformSystem& Scene::transforms()
+{
+	return m_transforms;
+}
+
+AnimationSystem& Scene::animations()
+{
+	return m_animations;
+}
+
+std::vector<SceneObject> const& Scene::objects() const
+{
+	return m_objects;
+}
+
+// Updates the moved transforms and poses the visible animated instances, then frustum culls the objects in parallel,
+// along with the meshlets of the opaque ones, and finally merges and sorts the packets.
+// Commands must stay alive and the scene must not be modified until the returned job is done.
+// The view, projection, camera, region, sort_transparent, gpu_culling, cascade, animation_time and palette_region members
+// of commands must be set beforehand.
+std::shared_ptr<Job> Scene::buildCommands(JobSystem& jobs, DynamicRingBuffer& uniforms, DynamicRingBuffer& palettes, FrameCommands& commands)
+{
+	const size_t chunk_size(s_chunk_size);
+	const size_t chunk_count((m_objects.size() + chunk_size - 1) / chunk_size);
+	commands.chunks.resize(chunk_count);
+	commands.gpu_objects.resize(commands.gpu_culling ? m_objects.size() : 0);
+
+	// Chunks are multiples of the transform blocks, concurrent updates never touch the same block
+	static_assert(s_chunk_size % TransformSystem::s_block_size == 0, "Scene chunks must be made of whole transform blocks");
+	std::shared_ptr<Job> transforms(jobs.parallelFor(m_transforms.size(), chunk_size, [this](size_t begin, size_t end) {
+		PROFILE_SCOPE("Transforms");
+		m_transforms.update(begin, end);
+	}));
+
+	const size_t pose_chunk_size(s_pose_chunk_size);
+	commands.palettes.resize(m_animations.size());
+	commands.pose_chunks.resize((m_animations.size() + pose_chunk_size - 1) / pose_chunk_size);
+	std::shared_ptr<Job> posing(jobs.parallelFor(m_animations.size(), pose_chunk_size, [this, &palettes, &commands, pose_chunk_size](size_t begin, size_t end) {
+		PROFILE_SCOPE("Animation");
+		const auto start(std::chrono::steady_clock::now());
+
+		const Frustum frustum(commands.projection * commands.view);
+		PoseStats& stats(commands.pose_chunks[begin / pose_chunk_size]);
+		stats = PoseStats{ 0, 0, 0. };
+
+		for (size_t i = begin; i < end; i++) {
+			commands.palettes[i] = -1;
+
+			SceneObject const& object(m_objects[m_animations.object(i)]);
+			glm::mat4 const& world(m_transforms.world(object.transform));
+			const glm::vec3 scale(glm::abs(m_transforms.scale(object.transform)));
+			const glm::vec3 center(world * glm::vec4(object.model->center(), 1.f));
+			const float radius(object.model->radius() * std::max(scale.x, std::max(scale.y, scale.z)) * s_pose_bounds_scale);
+			if (!frustum.intersects(center, radius))
+				continue;
+
+			const size_t bones(m_animations.boneCount(i));
+			const DynamicSlice palette(palettes.allocate(commands.palette_region, bones * 3 * sizeof(glm::vec4)));
+			if (!palette.data)
+				continue;
+
+			m_animations.evaluate(i, commands.animation_time, static_cast<glm::vec4*>(palette.data));
+			commands.palettes[i] = static_cast<GLint>(palette.offset / static_cast<GLintptr>(sizeof(glm::vec4)));
+			stats.instances++;
+			stats.bones += static_cast<unsigned int>(bones);
+		}
+
+		stats.cpu_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}, { transforms }));
+
+	std::shared_ptr<Job> culling(jobs.parallelFor(m_objects.size(), chunk_size, [this, &uniforms, &commands, chunk_size](size_t begin, size_t end) {
+		PROFILE_SCOPE("Culling");
+
+		const glm::mat4 view_projection(commands.projection * commands.view);
+		const Frustum frustum(view_projection);
+		// Reserved for the whole chunk, so that the packets don't allocate as more objects become visible
+		CommandChunk& chunk(commands.chunks[begin / chunk_size]);
+		for (std::vector<DrawPacket>& packets : chunk.passes) {
+			packets.clear();
+			packets.reserve(chunk_size);
+		}
+		for (std::vector<DrawPacket>& packets : chunk.cascades) {
+			packets.clear();
+			packets.reserve(chunk_size);
+		}
+		chunk.meshlets.clear();
+		chunk.gpu_packets.clear();
+		chunk.gpu_packets.reserve(chunk_size);
+		chunk.skinned.clear();
+
+		// Opaque objects cast shadows, they're tested against every cascade whose map is drawn this frame
+		std::array<Frustum, MAX_SHADOW_CASCADES> cascade_frustums;
+		for (unsigned int cascade = 0; cascade < commands.cascade_count; cascade++)
+			if (commands.cascade_redraw & (1u << cascade))
+				cascade_frustums[cascade] = Frustum(commands.cascade_view_projs[cascade]);
+		const unsigned int camera_visible(1u << MAX_SHADOW_CASCADES);
+		const unsigned int gpu_drawn(1u << (MAX_SHADOW_CASCADES + 1));
+
+		// Scratch taken from the worker's frame arena and reserved for the whole chunk, so that it never grows. The matrices
+		// are computed in batch over the visible objects.
+		const ArenaAllocator<char> scratch(FrameArena::local());
+		const size_t capacity(end - begin);
+		FrameVector<size_t> visible(scratch);
+		FrameVector<unsigned int> visibility(scratch); // camera_visible and a bit per cascade
+		FrameVector<glm::mat4> models(scratch), model_view_projs(scratch);
+		FrameVector<std::array<glm::vec4, 3>> normal_matrices(scratch);
+		FrameVector<float> depths(scratch);
+		FrameVector<glm::vec4> bounds(scratch);
+		visible.reserve(capacity);
+		visibility.reserve(capacity);
+		models.reserve(capacity);
+		model_view_projs.reserve(capacity);
+		normal_matrices.reserve(capacity);
+		depths.reserve(capacity);
+		bounds.reserve(capacity);
+
+		for (size_t i = begin; i < end; i++) {
+			SceneObject const& object(m_objects[i]);
+			glm::mat4 const& world(m_transforms.world(object.transform));
+
+			const glm::vec3 scale(glm::abs(m_transforms.scale(object.transform)));
+			const glm::vec3 center(world * glm::vec4(object.model->center(), 1.f));
+			const float radius(object.model->radius() * std::max(scale.x, std::max(scale.y, scale.z)));
+
+			// The GPU tests the camera frustum of the objects it draws, animated ones were tested when posed.
+			// Skinning isn't done by the shadow passes, animated objects don't cast shadows.
+			unsigned int mask(0);
+			if (object.animation != NO_ANIMATION)
+				mask = commands.palettes[object.animation] >= 0 ? camera_visible : 0;
+			else if (commands.gpu_culling && gpuDrawn(object))
+				mask = gpu_drawn;
+			else if (frustum.intersects(center, radius))
+				mask = camera_visible;
+			if ((object.passes & (1u << PASS_OPAQUE)) && object.animation == NO_ANIMATION)
+				for (unsigned int cascade = 0; cascade < commands.cascade_count; cascade++)
+					if ((commands.cascade_redraw & (1u << cascade)) && cascade_frustums[cascade].intersects(center, radius))
+						mask |= 1u << cascade;
+			if (!mask)
+				continue;
+
+			visible.push_back(i);
+			visibility.push_back(mask);
+			models.push_back(world);
+			bounds.push_back(glm::vec4(center, radius));
+		}
+
+		model_view_projs.resize(models.size());
+		normal_matrices.resize(models.size());
+		depths.resize(models.size());
+		MatrixBatch::multiply(view_projection, models.data(), model_view_projs.data(), models.size());
+		MatrixBatch::normalMatrices(models.data(), normal_matrices.data(), models.size());
+		MatrixBatch::squaredDistances(models.data(), commands.camera_position, depths.data(), models.size());
+
+		for (size_t i = 0; i < visible.size(); i++) {
+			SceneObject const& object(m_objects[visible[i]]);
+
+			const ObjectBlock block{ models[i], model_view_projs[i], normal_matrices[i] };
+			DrawPacket packet{ object.model, models[i], depths[i], DynamicSlice{ nullptr, 0, 0 }, object.passes, NO_MESHLET_RANGES,
+				object.animation != NO_ANIMATION ? commands.palettes[object.animation] : -1 };
+
+			// Elements are indexed by object, jobs never write the same one. Casting shadows still takes the uniform block.
+			if (visibility[i] & gpu_drawn) {
+				commands.gpu_objects[visible[i]] = { block, bounds[i] };
+				chunk.gpu_packets.push_back(packet);
+				if (!(visibility[i] & ~gpu_drawn))
+					continue;
+			}
+
+			// Written once and shared by every pass drawing the object, the shadow passes only read its model matrix
+			packet.object = uniforms.allocate(commands.region, sizeof(ObjectBlock));
+			if (!packet.object.data)
+				continue;
+			std::memcpy(packet.object.data, &block, sizeof(block));
+
+			// The meshlet bounds are those of the bind pose
+			if (packet.palette >= 0) {
+				chunk.skinned.push_back(packet);
+				continue;
+			}
+
+			if (m_meshlet_culling && (visibility[i] & camera_visible) && (object.passes & (1u << PASS_OPAQUE)))
+				packet.meshlets = cullMeshlets(*object.model, models[i], model_view_projs[i], commands.camera_position, chunk.meshlets);
+
+			if (visibility[i] & camera_visible)
+				for (size_t pass = 0; pass < PASS_COUNT; pass++)
+					if (object.passes & (1u << pass))
+						chunk.passes[pass].push_back(packet);
+
+			for (unsigned int cascade = 0; cascade < commands.cascade_count; cascade++)
+				if (visibility[i] & (1u << cascade))
+					chunk.cascades[cascade].push_back(packet);
+		}
+	}, { transforms, posing }));
+
+	const size_t object_count(m_objects.size());
+	return jobs.schedule([&commands, object_count]() {
+		PROFILE_SCOPE("Sorting");
+
+		commands.meshlets.clear();
+		for (size_t pass = 0; pass < PASS_COUNT; pass++) {
+			std::vector<DrawPacket>& packets(commands.passes[pass]);
+			packets.clear();
+			packets.reserve(object_count);
+
+			for (CommandChunk const& chunk : commands.chunks) {
+				const size_t first(packets.size());
+				packets.insert(packets.end(), chunk.passes[pass].begin(), chunk.passes[pass].end());
+				if (pass != PASS_OPAQUE)
+					continue;
+
+				// The chunk's ranges are rebased once merged
+				const size_t first_mesh(commands.meshlets.append(chunk.meshlets));
+				for (size_t i = first; i < packets.size(); i++)
+					if (packets[i].meshlets != NO_MESHLET_RANGES)
+						packets[i].meshlets += first_mesh;
+			}
+		}
+
+		commands.gpu_packets.clear();
+		commands.gpu_packets.reserve(object_count);
+		for (CommandChunk const& chunk : commands.chunks)
+			commands.gpu_packets.insert(commands.gpu_packets.end(), chunk.gpu_packets.begin(), chunk.gpu_packets.end());
+
+		commands.skinned.clear();
+		for (CommandChunk const& chunk : commands.chunks)
+			commands.skinned.insert(commands.skinned.end(), chunk.skinned.begin(), chunk.skinned.end());
+
+		commands.poses = PoseStats{ 0, 0, 0. };
+		for (PoseStats const& stats : commands.pose_chunks) {
+			commands.poses.instances += stats.instances;
+			commands.poses.bones += stats.bones;
+			commands.poses.cpu_ms += stats.cpu_ms;
+		}
+
+		for (size_t cascade = 0; cascade < MAX_SHADOW_CASCADES; cascade++) {
+			std::vector<DrawPacket>& packets(commands.cascades[cascade]);
+			packets.clear();
+			packets.reserve(object_count);
+
+			for (CommandChunk const& chunk : commands.chunks)
+				packets.insert(packets.end(), chunk.cascades[cascade].begin(), chunk.cascades[cascade].end());
+		}
+
+		if (!commands.sort_transparent)
+			return;
+
+		// Keys are sorted rather than packets, which are then moved once into their final place
+		std::vector<DrawPacket>& transparent(commands.passes[PASS_TRANSPARENT]);
+		commands.transparent_depths.resize(transparent.size());
+		for (size_t i = 0; i < transparent.size(); i++)
+			commands.transparent_depths[i] = transparent[i].depth;
+
+		std::vector<uint32_t> const& order(commands.transparent_sort.sortDescending(commands.transparent_depths.data(), transparent.size()));
+		commands.transparent_sorted.resize(transparent.size());
+		for (size_t i = 0; i < order.size(); i++)
+			commands.transparent_sorted[i] = transparent[order[i]];
+		transparent.swap(commands.transparent_sorted);
+	}, { culling });
+}
+
+// Culls the meshlets of every mesh in model space, where the frustum planes come straight from the model-view-projection
+// matrix and back-facing stays the same under any transform that doesn't mirror. Returns the first MeshRanges appended.
+size_t Scene::cullMeshlets(Model const& model, glm::mat4 const& world, glm::mat4 const& model_view_proj, glm::vec3 const& camera_position, MeshletRanges& ranges) const
+{
+	const Frustum frustum(model_view_proj);
+	const glm::vec3 eye(glm::inverse(world) * glm::vec4(camera_position, 1.f));
+	const bool cull_backfaces(glm::determinant(glm::mat3(world)) > 0.f);
+
+	const size_t first_mesh(ranges.meshes.size());
+	for (Mesh const& mesh : model.meshes()) {
+		const size_t first(ranges.counts.size());
+		ranges.visible += Meshlets::cull(mesh.meshlets(), frustum, eye, cull_backfaces, ranges.counts, ranges.offsets);
+		ranges.tested += static_cast<unsigned int>(mesh.meshlets().size());
+		ranges.meshes.push_back({ first, static_cast<GLsizei>(ranges.counts.size() - first) });
+	}
+
+	return first_mesh;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "Animation.h"
+#include "DynamicRingBuffer.h"
+#include "Frustum.h"
+#include "JobSystem.h"
+#include "Meshlet.h"
+#include "Model.h"
+#include "RadixSort.h"
+#include "TransformSystem.h"
+#include "UniformBlocks.h"
+
+
+enum RenderPass { PASS_LAMPS, PASS_OPAQUE, PASS_TRANSPARENT, PASS_OUTLINE, PASS_COUNT };
+
+constexpr size_t NO_MESHLET_RANGES = SIZE_MAX;
+constexpr size_t NO_ANIMATION = SIZE_MAX;
+
+// API-agnostic draw request built by the workers and replayed by the GL thread
+struct DrawPacket {
+	Model const* model;
+	glm::mat4 transform;
+	float depth; // squared distance to the camera
+	DynamicSlice object; // ObjectBlock of the draw
+	unsigned int passes; // every pass drawing the object, (1 << RenderPass) mask
+	size_t meshlets; // first MeshRanges of the model in FrameCommands::meshlets for the opaque pass, NO_MESHLET_RANGES to draw it whole
+	GLint palette; // first texel of the skinning palette in the palette buffer, -1 when the object isn't animated
+};
+
+// Animated instances posed by one job
+struct PoseStats {
+	unsigned int instances;
+	unsigned int bones;
+	double cpu_ms; // time spent by the job, summed over the jobs of the frame
+};
+
+// Packets culled by one job, merged into FrameCommands afterwards
+struct CommandChunk {
+	std::array<std::vector<DrawPacket>, PASS_COUNT> passes;
+	std::array<std::vector<DrawPacket>, MAX_SHADOW_CASCADES> cascades;
+	MeshletRanges meshlets;
+	std::vector<DrawPacket> gpu_packets;
+	std::vector<DrawPacket> skinned;
+};
+
+// Everything the GL thread needs to render a frame, filled by Scene::buildCommands()
+struct FrameCommands {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 camera_position;
+	glm::vec3 camera_front;
+	unsigned int region; // of the dynamic buffer holding the uniform blocks of the frame
+	bool sort_transparent; // false when the transparent pass is order-independent
+	DynamicSlice lights; // LightBlock array
+	DynamicSlice shadows; // ShadowBlock
+
+	// Directional shadows, set by CascadedShadowMap::fit()
+	unsigned int cascade_count;
+	std::array<glm::mat4, MAX_SHADOW_CASCADES> cascade_view_projs;
+	unsigned int cascade_redraw; // cascades whose shadow map is out of date, only their casters are gathered
+
+	std::array<std::vector<DrawPacket>, PASS_COUNT> passes; // transparent packets are sorted back to front
+	std::array<std::vector<DrawPacket>, MAX_SHADOW_CASCADES> cascades; // opaque objects inside each redrawn cascade
+	MeshletRanges meshlets; // visible parts of the opaque packets
+
+	// GPU-driven opaque pass: the objects drawn by gpuDrawn() skip camera culling and the opaque pass, they're written to
+	// gpu_objects (indexed like the scene's objects) and culled by GpuCulling
+	bool gpu_culling; // set beforehand
+	std::vector<GpuObjectBlock> gpu_objects;
+	std::vector<DrawPacket> gpu_packets; // every object in gpu_objects, for the CPU side users of the pass (e.g. texture streaming)
+
+	// Skeletal animation: the animated instances in the camera frustum are posed by the workers, which write their palettes
+	// to the palette buffer (3 texels per bone). They're only drawn by the opaque pass, with the skinning shaders.
+	double animation_time; // set beforehand, in seconds
+	unsigned int palette_region; // set beforehand, of the palette buffer
+	std::vector<GLint> palettes; // per animation instance, -1 when culled
+	std::vector<DrawPacket> skinned;
+	std::vector<PoseStats> pose_chunks; // per posing job
+	PoseStats poses; // totals of the frame
+
+	std::vector<CommandChunk> chunks; // per culling job output, kept to reuse allocations
+
+	// Back to front sorting of the transparent pass, reused every frame
+	RadixSort transparent_sort;
+	std::vector<float> transparent_depths;
+	std::vector<DrawPacket> transparent_sorted;
+};
+
+struct SceneObject {
+	Model const* model;
+	size_t transform; // handle in the scene's TransformSystem
+	unsigned int passes; // (1 << RenderPass) mask
+	size_t animation; // handle in the scene's AnimationSystem, NO_ANIMATION for static objects
+};
+
+// Objects of the opaque pass that can be submitted by GpuCulling, outlined ones need a stencil reference of their own
+// and animated ones a skinning palette
+inline bool gpuDrawn(SceneObject const& object)
+{
+	return (object.passes & (1u << PASS_OPAQUE)) && !(object.passes & (1u << PASS_OUTLINE)) && object.animation == NO_ANIMATION;
+}
+
+
+class Scene
+{
+public:
+	explicit Scene(bool const& meshlet_culling = true);
+	~Scene();
+
+	size_t add(Model const& model, glm::vec3 const& position, glm::vec3 const& scale, unsigned int const& passes);
+	size_t addAnimated(Model const& model, glm::vec3 const& position, glm::vec3 const& scale, size_t const& clip, float const& speed, float const& phase);
+	std::shared_ptr<Job> buildCommands(JobSystem& jobs, DynamicRingBuffer& uniforms, DynamicRingBuffer& palettes, FrameCommands& commands);
+
+	TransformSystem& transforms();
+	AnimationSystem& animations();
+	std::vector<SceneObject> const& objects() const;
+
+private:
+	static constexpr size_t s_chunk_size = 256; // objects culled per job
+	static constexpr size_t s_pose_chunk_size = 16; // animated instances posed per job, each costs far more than culling an object
+	static constexpr float s_pose_bounds_scale = 1.5f; // the bind pose bounds don't cover the limbs reaching out of them
+
+	size_t cullMeshlets(Model const& model, glm::mat4 const& world, glm::mat4 const& model_view_proj, glm::vec3 const& camera_position, MeshletRanges& ranges) const;
+
+	std::vector<SceneObject> m_objects;
+	TransformSystem m_transforms;
+	AnimationSystem m_animations;
+	bool m_meshlet_culling;
+};
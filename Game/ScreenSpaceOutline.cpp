@@ -0,0 +1,128 @@
+#include "ScreenSpaceOutline.h"
+
+#include <iostream>
+
+#include <glm/glm.hpp>
+
+#include "Profiler.h"
+
+
+ScreenSpaceOutline::ScreenSpaceOutline(unsigned int const& width, unsigned int const& height, GLuint const& depth_stencil_renderbuffer, std::string const& shaders_directory,
+	int const& radius, glm::vec4 const& color) :
+	m_mask_framebuffer(0), m_mask(0), m_dilated_framebuffer(0), m_dilated(0), m_empty_vao(0), m_valid(false),
+	m_radius(radius), m_color(color),
+	m_mask_shader(shaders_directory + "fullscreen.vert", shaders_directory + "outline_mask.frag"),
+	m_dilate_shader(shaders_directory + "fullscreen.vert", shaders_directory + "outline_dilate.frag"),
+	m_composite_shader(shaders_directory + "fullscreen.vert", shaders_directory + "outline_dilate.frag", "#define COMPOSITE\n")
+{
+	const auto create_target = [width, height](GLuint& framebuffer, GLuint& texture) {
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	};
+
+	// The mask pass tests against the scene's stencil, the dilation target has no stencil so the test always passes there
+	create_target(m_mask_framebuffer, m_mask);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_stencil_renderbuffer);
+	m_valid = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+	create_target(m_dilated_framebuffer, m_dilated);
+	m_valid = m_valid && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+	if (!m_valid)
+		std::cerr << "Error: screen-space outline framebuffers are incomplete." << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenVertexArrays(1, &m_empty_vao);
+}
+
+ScreenSpaceOutline::~ScreenSpaceOutline()
+{
+	glDeleteVertexArrays(1, &m_empty_vao);
+	glDeleteFramebuffers(1, &m_mask_framebuffer);
+	glDeleteFramebuffers(1, &m_dilated_framebuffer);
+	glDeleteTextures(1, &m_mask);
+	glDeleteTextures(1, &m_dilated);
+}
+
+
+bool ScreenSpaceOutline::valid() const
+{
+	return m_valid;
+}
+
+// Leaves scene_framebuffer bound with the stencil test keeping its default function and a zero write mask
+void ScreenSpaceOutline::render(GLuint const& scene_framebuffer, unsigned int const& width, unsigned int const& height) const
+{
+	const glm::ivec2 render_size(width, height);
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	glStencilMask(0x00);
+	glBindVertexArray(m_empty_vao);
+	glActiveTexture(GL_TEXTURE0);
+
+	// Stencil to mask
+	glBindFramebuffer(GL_FRAMEBUFFER, m_mask_framebuffer);
+	glClearColor(0.f, 0.f, 0.f, 0.f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glStencilFunc(GL_EQUAL, 1, 0xFF);
+	m_mask_shader.use();
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	Profiler::countDraw(3);
+
+	// Horizontal dilation
+	glBindFramebuffer(GL_FRAMEBUFFER, m_dilated_framebuffer);
+	m_dilate_shader.use();
+	m_dilate_shader.setUni("mask", 0);
+	m_dilate_shader.setUni("direction", glm::ivec2(1, 0));
+	m_dilate_shader.setUni("radius", m_radius);
+	m_dilate_shader.setUni("render_size", render_size);
+	glBindTexture(GL_TEXTURE_2D, m_mask);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	Profiler::countDraw(3);
+
+	// Vertical dilation, written as the outline color around (not over) the marked pixels
+	glBindFramebuffer(GL_FRAMEBUFFER, scene_framebuffer);
+	glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
+	m_composite_shader.use();
+	m_composite_shader.setUni("mask", 0);
+	m_composite_shader.setUni("direction", glm::ivec2(0, 1));
+	m_composite_shader.setUni("radius", m_radius);
+	m_composite_shader.setUni("render_size", render_size);
+	m_composite_shader.setUni("color", m_color);
+	glBindTexture(GL_TEXTURE_2D, m_dilated);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	Profiler::countDraw(3);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindVertexArray(0);
+	glStencilFunc(GL_ALWAYS, 0, 0xFF);
+	glEnable(GL_DEPTH_TEST);
+}
+
+
+// Exposed for hot reloading
+Shader& ScreenSpaceOutline::maskShader()
+{
+	return m_mask_shader;
+}
+
+Shader& ScreenSpaceOutline::dilateShader()
+{
+	return m_dilate_shader;
+}
+
+Shader& ScreenSpaceOutline::compositeShader()
+{
+	return m_composite_shader;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+
+#include <GL/glew.h>
+#include <glm/vec4.hpp>
+
+#include "Shader.h"
+
+
+// Outlines every object whose pixels carry the stencil value 1 with three fullscreen passes, whatever their geometry:
+// the stencil is turned into an R8 mask, dilated horizontally, then dilated vertically straight into the scene
+// where the stencil isn't set.
+class ScreenSpaceOutline
+{
+public:
+	ScreenSpaceOutline(unsigned int const& width, unsigned int const& height, GLuint const& depth_stencil_renderbuffer, std::string const& shaders_directory,
+		int const& radius, glm::vec4 const& color);
+	~ScreenSpaceOutline();
+
+	bool valid() const;
+
+	// Expects the viewport to cover the width by height corner the scene was rendered to
+	void render(GLuint const& scene_framebuffer, unsigned int const& width, unsigned int const& height) const;
+
+	Shader& maskShader();
+	Shader& dilateShader();
+	Shader& compositeShader();
+
+private:
+	GLuint m_mask_framebuffer, m_mask;
+	GLuint m_dilated_framebuffer, m_dilated;
+	GLuint m_empty_vao;
+	bool m_valid;
+
+	int const m_radius;
+	glm::vec4 const m_color;
+
+	Shader m_mask_shader;
+	Shader m_dilate_shader;
+	Shader m_composite_shader;
+};
@@ -1,167 +1,439 @@
 #include "Shader.h"
 
-#include <sstream>
+#include <algorithm>
+#include <array>
+#include <utility>
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include "FileSystem.h"
+#include "Profiler.h"
 
-std::unordered_map<std::string, GLuint> Shader::s_compiled_shaders_list = {};
 
-Shader::Shader(std::string const& vertex_shader_source_file, std::string const& fragment_shader_source_file) : m_shader_program_id(0),
+std::unordered_map<std::string, Shader::CompiledShader> Shader::s_compiled_shaders_list = {};
+bool Shader::s_parallel_compilation = false;
+
+// Compilation and linking are only submitted here; statuses are queried by resolve() the first time the program is needed,
+// so that constructing several shaders in a row lets the driver build them concurrently.
+// Defines (e.g. "#define FEATURE\n") build a variant of the same sources, compiled shaders are shared per file and defines.
+Shader::Shader(std::string const& vertex_shader_source_file, std::string const& fragment_shader_source_file, std::string const& defines) : m_program(), m_resolved(false), m_material_slots{ -1 },
+m_stage(GL_VERTEX_SHADER),
 m_vertex_shader_source_file(vertex_shader_source_file),
-m_fragment_shader_source_file(fragment_shader_source_file)
+m_fragment_shader_source_file(fragment_shader_source_file),
+m_defines(defines),
+m_feedback_varyings(),
+m_pending_program(), m_pending_vertex_shader(0), m_pending_fragment_shader(0)
 {
-	m_vertex_shader = (s_compiled_shaders_list.count(vertex_shader_source_file)) ? s_compiled_shaders_list[vertex_shader_source_file] : compile(vertex_shader_source_file, GL_VERTEX_SHADER);
-	m_fragment_shader = (s_compiled_shaders_list.count(fragment_shader_source_file)) ? s_compiled_shaders_list[fragment_shader_source_file] : compile(fragment_shader_source_file, GL_FRAGMENT_SHADER);
+	m_vertex_shader = acquire(vertex_shader_source_file, GL_VERTEX_SHADER, m_defines);
+	m_fragment_shader = acquire(fragment_shader_source_file, GL_FRAGMENT_SHADER, m_defines);
 
-	link();
+	m_program = link(m_vertex_shader, m_fragment_shader, false, m_feedback_varyings);
 }
 
-Shader::~Shader()
+// Program made of a single stage, e.g. GL_COMPUTE_SHADER
+Shader::Shader(GLenum const& stage, std::string const& source_file, std::string const& defines) : m_program(), m_resolved(false), m_material_slots{ -1 },
+m_stage(stage),
+m_vertex_shader_source_file(source_file),
+m_fragment_shader_source_file(),
+m_defines(defines),
+m_feedback_varyings(),
+m_fragment_shader(0),
+m_pending_program(), m_pending_vertex_shader(0), m_pending_fragment_shader(0)
+{
+	m_vertex_shader = acquire(source_file, m_stage, m_defines);
+
+	m_program = link(m_vertex_shader, 0, true, m_feedback_varyings);
+}
+
+// Vertex only program whose outputs are captured by transform feedback, to be run with GL_RASTERIZER_DISCARD enabled
+Shader::Shader(std::string const& vertex_shader_source_file, std::vector<std::string> const& feedback_varyings, std::string const& defines) : m_program(), m_resolved(false), m_material_slots{ -1 },
+m_stage(GL_VERTEX_SHADER),
+m_vertex_shader_source_file(vertex_shader_source_file),
+m_fragment_shader_source_file(),
+m_defines(defines),
+m_feedback_varyings(feedback_varyings),
+m_fragment_shader(0),
+m_pending_program(), m_pending_vertex_shader(0), m_pending_fragment_shader(0)
 {
-	s_compiled_shaders_list.erase(m_vertex_shader_source_file);
-	glDeleteShader(m_vertex_shader);
-	s_compiled_shaders_list.erase(m_fragment_shader_source_file);
-	glDeleteShader(m_fragment_shader);
+	m_vertex_shader = acquire(vertex_shader_source_file, GL_VERTEX_SHADER, m_defines);
+
+	m_program = link(m_vertex_shader, 0, true, m_feedback_varyings);
+}
 
-	glDeleteProgram(m_shader_program_id);
+// The programs are deleted with their handles, shaders once no program uses them anymore
+Shader::~Shader()
+{
+	discardReload();
+	release(m_vertex_shader_source_file, m_defines, m_vertex_shader);
+	if (!m_fragment_shader_source_file.empty())
+		release(m_fragment_shader_source_file, m_defines, m_fragment_shader);
 }
 
 
-// Returns the shader program ID
+// Returns the shader program ID, waiting for its link to complete if needed
 GLuint Shader::id() const
 {
-	return m_shader_program_id;
+	if (!m_resolved)
+		resolve();
+
+	return m_program.id();
+}
+
+void Shader::use() const
+{
+	glUseProgram(id());
+	Profiler::countStateChange();
 }
 
 
-void Shader::setUni(std::string const& name, bool const& value) const
+// Must be called once GLEW is initialized; without GL_KHR_parallel_shader_compile, id() blocks on the first call
+// like a regular status query would
+void Shader::enableParallelCompilation()
 {
-	glUniform1i(glGetUniformLocation(m_shader_program_id, name.c_str()), static_cast<GLboolean>(value));
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		s_parallel_compilation = true;
+		std::cout << "Parallel shader compilation enabled (GL_KHR_parallel_shader_compile)." << std::endl;
+	}
+	else if (GLEW_ARB_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		s_parallel_compilation = true;
+		std::cout << "Parallel shader compilation enabled (GL_ARB_parallel_shader_compile)." << std::endl;
+	}
+	else
+		std::cout << "Parallel shader compilation unsupported, shaders will be built serially." << std::endl;
 }
-void Shader::setUni(std::string const& name, int const& value) const
+
+
+// Rebuilds the program from the source files currently on disk. The new program is only swapped in by applyReload(),
+// the current one keeps being used in the meantime.
+void Shader::reload()
 {
-	glUniform1i(glGetUniformLocation(m_shader_program_id, name.c_str()), static_cast<GLint>(value));
+	discardReload();
+
+	const bool single_stage(m_fragment_shader_source_file.empty());
+	m_pending_vertex_shader = compile(m_vertex_shader_source_file, m_stage, m_defines);
+	m_pending_fragment_shader = single_stage ? 0 : compile(m_fragment_shader_source_file, GL_FRAGMENT_SHADER, m_defines);
+	m_pending_program = link(m_pending_vertex_shader, m_pending_fragment_shader, single_stage, m_feedback_varyings);
 }
-void Shader::setUni(std::string const& name, float const& value) const
+
+// Returns true once a pending reload has been built successfully and swapped in, in which case every uniform
+// must be set again. On failure the previous program is kept.
+bool Shader::applyReload()
 {
-	glUniform1f(glGetUniformLocation(m_shader_program_id, name.c_str()), static_cast<GLfloat>(value));
+	if (!m_pending_program || !completed(m_pending_program.id()))
+		return false;
+
+	GLProgram program(std::move(m_pending_program));
+	const GLuint program_id(program.id());
+
+	if (!checkProgram(program_id, m_pending_vertex_shader, m_pending_fragment_shader)) {
+		std::cerr << "Reloading \"" << m_vertex_shader_source_file << "\" / \"" << m_fragment_shader_source_file << "\" failed, keeping the previous program." << std::endl;
+		discardReload();
+		return false;
+	}
+
+	// Validation depends on the current GL state, a failure is only reported
+	glValidateProgram(program_id);
+	GLint valid(0);
+	glGetProgramiv(program_id, GL_VALIDATE_STATUS, &valid);
+	if (valid != GL_TRUE)
+		std::cerr << "Warning: reloaded program (id: " << program_id << ") did not validate." << std::endl;
+
+	// The replaced shaders may still be attached to programs built from the same files that weren't reloaded yet.
+	// The new ones only take their place in the list once the old ones are gone.
+	id();
+	m_program = std::move(program);
+	release(m_vertex_shader_source_file, m_defines, m_vertex_shader);
+	m_vertex_shader = m_pending_vertex_shader;
+	if (!m_fragment_shader_source_file.empty()) {
+		release(m_fragment_shader_source_file, m_defines, m_fragment_shader);
+		m_fragment_shader = m_pending_fragment_shader;
+	}
+	m_pending_vertex_shader = 0;
+	m_pending_fragment_shader = 0;
+	s_compiled_shaders_list.emplace(m_vertex_shader_source_file + m_defines, CompiledShader{ m_vertex_shader, 1 });
+	if (!m_fragment_shader_source_file.empty())
+		s_compiled_shaders_list.emplace(m_fragment_shader_source_file + m_defines, CompiledShader{ m_fragment_shader, 1 });
+	resolveSlots();
+
+	std::cout << "Reloaded \"" << m_vertex_shader_source_file << "\" / \"" << m_fragment_shader_source_file << "\" (id: " << m_program.id() << ")." << std::endl;
+
+	return true;
 }
-void Shader::setUni(std::string const& name, glm::mat4 const& value) const
+
+bool Shader::reloading() const
 {
-	glUniformMatrix4fv(glGetUniformLocation(m_shader_program_id, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+	return static_cast<bool>(m_pending_program);
 }
-void Shader::setUni(std::string const& name, float const& value1, float const& value2, float const& value3) const
+
+
+std::string const& Shader::vertexFile() const
 {
-	glUniform3f(glGetUniformLocation(m_shader_program_id, name.c_str()), static_cast<GLfloat>(value1), static_cast<GLfloat>(value2), static_cast<GLfloat>(value3));
+	return m_vertex_shader_source_file;
 }
-void Shader::setUni(std::string const& name, glm::vec3 const& value) const
+
+std::string const& Shader::fragmentFile() const
 {
-	glUniform3fv(glGetUniformLocation(m_shader_program_id, name.c_str()), 1, glm::value_ptr(value));
+	return m_fragment_shader_source_file;
 }
 
 
-GLuint Shader::compile(std::string const& file_path, GLuint const& type)
+void Shader::setUni(GLchar const* name, bool const& value) const
 {
-	std::cout << "Compiling shader \"" << file_path << "\" (" << type << ")." << std::endl;
-	GLuint shader_id(glCreateShader(type));
-	if (shader_id == 0) {
-		std::cerr << "Error: shader type (" << type << ") does not exist." << std::endl;
-		return 0;
-	}
+	glUniform1i(glGetUniformLocation(id(), name), static_cast<GLboolean>(value));
+}
+void Shader::setUni(GLchar const* name, int const& value) const
+{
+	glUniform1i(glGetUniformLocation(id(), name), static_cast<GLint>(value));
+}
+void Shader::setUni(GLchar const* name, unsigned int const& value) const
+{
+	glUniform1ui(glGetUniformLocation(id(), name), static_cast<GLuint>(value));
+}
+void Shader::setUni(GLchar const* name, float const& value) const
+{
+	glUniform1f(glGetUniformLocation(id(), name), static_cast<GLfloat>(value));
+}
+void Shader::setUni(GLchar const* name, glm::mat4 const& value) const
+{
+	glUniformMatrix4fv(glGetUniformLocation(id(), name), 1, GL_FALSE, glm::value_ptr(value));
+}
+void Shader::setUni(GLchar const* name, float const& value1, float const& value2, float const& value3) const
+{
+	glUniform3f(glGetUniformLocation(id(), name), static_cast<GLfloat>(value1), static_cast<GLfloat>(value2), static_cast<GLfloat>(value3));
+}
+void Shader::setUni(GLchar const* name, glm::vec2 const& value) const
+{
+	glUniform2fv(glGetUniformLocation(id(), name), 1, glm::value_ptr(value));
+}
+void Shader::setUni(GLchar const* name, glm::vec3 const& value) const
+{
+	glUniform3fv(glGetUniformLocation(id(), name), 1, glm::value_ptr(value));
+}
+void Shader::setUni(GLchar const* name, glm::vec4 const& value) const
+{
+	glUniform4fv(glGetUniformLocation(id(), name), 1, glm::value_ptr(value));
+}
+void Shader::setUni(GLchar const* name, glm::ivec2 const& value) const
+{
+	glUniform2iv(glGetUniformLocation(id(), name), 1, glm::value_ptr(value));
+}
 
+// GLSL 3.30 can't declare block bindings in the source, blocks missing from the program (optimized out) are ignored
+void Shader::bindBlock(GLchar const* name, GLuint const& binding) const
+{
+	const GLuint index(glGetUniformBlockIndex(id(), name));
+	if (index != GL_INVALID_INDEX)
+		glUniformBlockBinding(id(), index, binding);
+}
 
-	std::ifstream file(file_path);
-	std::string file_contents;
-	file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	try
-	{
-		std::stringstream file_stream;
-		file_stream << file.rdbuf();
-		file.close();
-		file_contents = file_stream.str();
-	}
-	catch (std::ifstream::failure)
-	{
-		std::cerr << "Error: shader file could not be read successfully: " << std::endl;
-	}
-	const GLchar* source_code_string(file_contents.c_str());
+MaterialSlots const& Shader::materialSlots() const
+{
+	if (!m_resolved)
+		resolve();
 
+	return m_material_slots;
+}
 
-	glShaderSource(shader_id, 1, &source_code_string, nullptr);
-	glCompileShader(shader_id);
 
+// Compiles the shader unless another program already uses it
+GLuint Shader::acquire(std::string const& file_path, GLuint const& type, std::string const& defines)
+{
+	const auto compiled(s_compiled_shaders_list.find(file_path + defines));
+	if (compiled != s_compiled_shaders_list.end()) {
+		compiled->second.users++;
+		return compiled->second.id;
+	}
 
-	GLint success(0);
-	glGetShaderiv(shader_id, GL_COMPILE_STATUS, &success);
+	const GLuint shader_id(compile(file_path, type, defines));
+	if (shader_id != 0)
+		s_compiled_shaders_list[file_path + defines] = CompiledShader{ shader_id, 1 };
 
-	if (success != GL_TRUE) {
-		GLint error_size(0);
-		glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &error_size);
+	return shader_id;
+}
 
-		GLchar* error(new char[static_cast<size_t>(error_size) + 1]);
+// Shaders that aren't in the list (built by a reload, or replaced while other programs kept the listed one) are only
+// used by the caller and deleted right away
+void Shader::release(std::string const& file_path, std::string const& defines, GLuint const& shader_id)
+{
+	if (shader_id == 0)
+		return;
 
-		glGetShaderInfoLog(shader_id, error_size, nullptr, error);
-		error[error_size] = '\0';
+	const auto compiled(s_compiled_shaders_list.find(file_path + defines));
+	if (compiled != s_compiled_shaders_list.end() && compiled->second.id == shader_id) {
+		if (--compiled->second.users > 0)
+			return;
+		s_compiled_shaders_list.erase(compiled);
+	}
 
-		std::cerr << "Shader compilation failed (file: \"" << file_path << "\"): " << error << "." << std::endl;
+	glDeleteShader(shader_id);
+}
 
-		delete[] error;
-		glDeleteShader(shader_id);
+// Drops a reload that failed or got superseded, its shaders are never listed
+void Shader::discardReload()
+{
+	m_pending_program = GLProgram();
+	if (m_pending_vertex_shader != 0)
+		glDeleteShader(m_pending_vertex_shader);
+	if (m_pending_fragment_shader != 0)
+		glDeleteShader(m_pending_fragment_shader);
+	m_pending_vertex_shader = 0;
+	m_pending_fragment_shader = 0;
+}
+
+GLuint Shader::compile(std::string const& file_path, GLuint const& type, std::string const& defines)
+{
+	std::cout << "Compiling shader \"" << file_path << "\" (" << type << ")." << std::endl;
+	GLuint shader_id(glCreateShader(type));
+	if (shader_id == 0) {
+		std::cerr << "Error: shader type (" << type << ") does not exist." << std::endl;
 		return 0;
 	}
 
-	s_compiled_shaders_list[file_path] = shader_id;
+
+	// Read in place from the archive when it's mounted, the source is passed with its length as it isn't null terminated
+	const FileData file(FileSystem::read(file_path));
+	if (!file.valid())
+		std::cerr << "Error: shader file could not be read successfully: " << file_path << std::endl;
+	GLchar const* const source(file.size() > 0 ? reinterpret_cast<GLchar const*>(file.data()) : "");
+	const size_t source_size(file.size());
+
+	// #version must stay first, #line keeps the compiler messages pointing to the lines of the file
+	std::string header;
+	size_t body(0);
+	if (!defines.empty()) {
+		GLchar const* const version_end(std::find(source, source + source_size, '\n'));
+		if (version_end != source + source_size) {
+			body = static_cast<size_t>(version_end - source) + 1;
+			header.assign(source, body);
+			header += defines + "#line 2\n";
+		}
+	}
+	const std::array<GLchar const*, 2> strings = { header.c_str(), source + body };
+	const std::array<GLint, 2> lengths = { static_cast<GLint>(header.size()), static_cast<GLint>(source_size - body) };
+
+
+	glShaderSource(shader_id, 2, strings.data(), lengths.data());
+	glCompileShader(shader_id);
 
 	return shader_id;
 }
 
-void Shader::link()
+GLProgram Shader::link(GLuint const& vertex_shader, GLuint const& fragment_shader, bool const& single_stage, std::vector<std::string> const& feedback_varyings)
 {
 	std::cout << "Linking..." << std::endl;
 
 	// Unrelated; just to test if the list behaves properly
 	std::cout << "----" << std::endl << "Compiled shaders list:" << std::endl;
 	for (auto const& element : s_compiled_shaders_list)
-		std::cout << element.first << " (id: " << element.second << ")" << std::endl;
+		std::cout << element.first << " (id: " << element.second.id << ", programs: " << element.second.users << ")" << std::endl;
 	std::cout << "----" << std::endl;
 
 
-	if (m_vertex_shader == 0 || m_fragment_shader == 0) {
-		std::cerr << "At least one shader didn't compile. Linking aborted." << std::endl;
-		return;
+	if (vertex_shader == 0 || (fragment_shader == 0 && !single_stage)) {
+		std::cerr << "At least one shader couldn't be created. Linking aborted." << std::endl;
+		return GLProgram();
 	}
 
-	m_shader_program_id = glCreateProgram();
+	GLProgram program(GLProgram::generate());
 
-	glAttachShader(m_shader_program_id, m_vertex_shader);
-	glAttachShader(m_shader_program_id, m_fragment_shader);
+	glAttachShader(program.id(), vertex_shader);
+	if (!single_stage)
+		glAttachShader(program.id(), fragment_shader);
 
-	glLinkProgram(m_shader_program_id);
+	// Only taken into account by the next link
+	if (!feedback_varyings.empty()) {
+		std::vector<GLchar const*> names;
+		for (std::string const& varying : feedback_varyings)
+			names.push_back(varying.c_str());
+		glTransformFeedbackVaryings(program.id(), static_cast<GLsizei>(names.size()), names.data(), GL_INTERLEAVED_ATTRIBS);
+	}
+
+	glLinkProgram(program.id());
+
+	return program;
+}
 
+// Non-blocking when GL_KHR_parallel_shader_compile is enabled, always true otherwise
+bool Shader::completed(GLuint const& program_id)
+{
+	if (!s_parallel_compilation || program_id == 0)
+		return true;
 
-	glDeleteShader(m_vertex_shader);
-	glDeleteShader(m_fragment_shader);
+	GLint status(GL_FALSE);
+	glGetProgramiv(program_id, GL_COMPLETION_STATUS_KHR, &status);
 
+	return status == GL_TRUE;
+}
 
+bool Shader::checkProgram(GLuint const& program_id, GLuint const& vertex_shader, GLuint const& fragment_shader) const
+{
 	GLint success(0);
-	glGetProgramiv(m_shader_program_id, GL_LINK_STATUS, &success);
+	glGetProgramiv(program_id, GL_LINK_STATUS, &success);
 
 	if (success != GL_TRUE) {
+		printShaderLog(vertex_shader, m_vertex_shader_source_file);
+		printShaderLog(fragment_shader, m_fragment_shader_source_file);
+
 		GLint error_size = 0;
-		glGetProgramiv(m_shader_program_id, GL_INFO_LOG_LENGTH, &error_size);
+		glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &error_size);
 
 		GLchar* error(new char[static_cast<size_t>(error_size) + 1]);
 
-		glGetProgramInfoLog(m_shader_program_id, error_size, nullptr, error);
+		glGetProgramInfoLog(program_id, error_size, nullptr, error);
 		error[error_size] = '\0';
 
 		std::cerr << "Shader linking error: " << error << "." << std::endl;
 
 		delete[] error;
-		glDeleteProgram(m_shader_program_id);
+		return false;
+	}
+
+	std::cout << "Link succeeded (id: " << program_id << ")." << std::endl;
+	return true;
+}
+
+void Shader::resolve() const
+{
+	m_resolved = true;
+	if (!m_program)
+		return;
+
+	if (!checkProgram(m_program.id(), m_vertex_shader, m_fragment_shader)) {
+		m_program.reset();
 		return;
 	}
 
-	std::cout << "Link succeeded (id: " << m_shader_program_id << ")." << std::endl;
+	resolveSlots();
+}
+
+void Shader::resolveSlots() const
+{
+	m_material_slots.shininess = glGetUniformLocation(m_program.id(), "material.shininess");
+}
+
+void Shader::printShaderLog(GLuint const& shader_id, std::string const& file_path)
+{
+	if (glIsShader(shader_id) != GL_TRUE)
+		return;
+
+	GLint success(0);
+	glGetShaderiv(shader_id, GL_COMPILE_STATUS, &success);
+	if (success == GL_TRUE)
+		return;
+
+	GLint error_size(0);
+	glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &error_size);
+
+	GLchar* error(new char[static_cast<size_t>(error_size) + 1]);
+
+	glGetShaderInfoLog(shader_id, error_size, nullptr, error);
+	error[error_size] = '\0';
+
+	std::cerr << "Shader compilation failed (file: \"" << file_path << "\"): " << error << "." << std::endl;
+
+	delete[] error;
 }
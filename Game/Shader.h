@@ -4,35 +4,88 @@
 #include <iostream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <GL/glew.h>
 
+#include "GLHandle.h"
+
+
+// Uniform locations read on every material bind, looked up once per linked program
+struct MaterialSlots {
+	GLint shininess;
+};
+
 
 class Shader
 {
 public:
-	Shader(std::string const& vertex_shader_source_file, std::string const& fragment_shader_source_file);
+	Shader(std::string const& vertex_shader_source_file, std::string const& fragment_shader_source_file, std::string const& defines = "");
+	Shader(GLenum const& stage, std::string const& source_file, std::string const& defines = "");
+	Shader(std::string const& vertex_shader_source_file, std::vector<std::string> const& feedback_varyings, std::string const& defines = "");
 	~Shader();
 
 	GLuint id() const;
+	void use() const;
+
+	static void enableParallelCompilation();
+
+	void reload();
+	bool applyReload();
+	bool reloading() const;
 
-	void setUni(std::string const& name, bool const& value) const;
-	void setUni(std::string const& name, int const& value) const;
-	void setUni(std::string const& name, float const& value) const;
-	void setUni(std::string const& name, glm::mat4 const& value) const;
-	void setUni(std::string const& name, float const& value1, float const& value2, float const& value3) const;
-	void setUni(std::string const& name, glm::vec3 const& value) const;
+	std::string const& vertexFile() const;
+	std::string const& fragmentFile() const;
+
+	void setUni(GLchar const* name, bool const& value) const;
+	void setUni(GLchar const* name, int const& value) const;
+	void setUni(GLchar const* name, unsigned int const& value) const;
+	void setUni(GLchar const* name, float const& value) const;
+	void setUni(GLchar const* name, glm::mat4 const& value) const;
+	void setUni(GLchar const* name, float const& value1, float const& value2, float const& value3) const;
+	void setUni(GLchar const* name, glm::vec2 const& value) const;
+	void setUni(GLchar const* name, glm::vec3 const& value) const;
+	void setUni(GLchar const* name, glm::vec4 const& value) const;
+	void setUni(GLchar const* name, glm::ivec2 const& value) const;
+
+	void bindBlock(GLchar const* name, GLuint const& binding) const;
+	MaterialSlots const& materialSlots() const;
 
 
 private:
-	static GLuint compile(std::string const& file_path, GLuint const& type);
-	void link();
+	// Compiled shaders are shared by the programs built from the same file and defines
+	struct CompiledShader {
+		GLuint id;
+		unsigned int users;
+	};
+
+	static GLuint acquire(std::string const& file_path, GLuint const& type, std::string const& defines);
+	static void release(std::string const& file_path, std::string const& defines, GLuint const& shader_id);
+	void discardReload();
+	static GLuint compile(std::string const& file_path, GLuint const& type, std::string const& defines);
+	static GLProgram link(GLuint const& vertex_shader, GLuint const& fragment_shader, bool const& single_stage, std::vector<std::string> const& feedback_varyings);
+	static bool completed(GLuint const& program_id);
+	bool checkProgram(GLuint const& program_id, GLuint const& vertex_shader, GLuint const& fragment_shader) const;
+	void resolve() const;
+	void resolveSlots() const;
+	static void printShaderLog(GLuint const& shader_id, std::string const& file_path);
 
-	GLuint m_shader_program_id;
-	std::string const m_vertex_shader_source_file;
-	std::string const m_fragment_shader_source_file;
+	mutable GLProgram m_program;
+	mutable bool m_resolved;
+	mutable MaterialSlots m_material_slots;
+	GLenum const m_stage; // GL_VERTEX_SHADER for vertex and fragment programs, the stage of single stage programs otherwise
+	std::string const m_vertex_shader_source_file; // or the source of the single stage
+	std::string const m_fragment_shader_source_file; // empty for single stage programs
+	std::string const m_defines; // inserted after the #version line of both stages
+	std::vector<std::string> const m_feedback_varyings; // captured interleaved by transform feedback, empty for most programs
 	GLuint m_vertex_shader;
 	GLuint m_fragment_shader;
-	static std::unordered_map<std::string, GLuint> s_compiled_shaders_list;
+
+	GLProgram m_pending_program;
+	GLuint m_pending_vertex_shader;
+	GLuint m_pending_fragment_shader;
+
+	static std::unordered_map<std::string, CompiledShader> s_compiled_shaders_list;
+	static bool s_parallel_compilation;
 };
@@ -0,0 +1,132 @@
+#include "ShaderWatcher.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+	long long modificationTime(std::string const& file_path)
+	{
+		struct stat file_status;
+		if (stat(file_path.c_str(), &file_status) != 0)
+			return 0;
+
+		return static_cast<long long>(file_status.st_mtime);
+	}
+}
+
+
+ShaderWatcher::ShaderWatcher(std::string const& directory) : m_directory(directory), m_shaders(), m_pending_shaders(),
+	m_inotify_fd(-1), m_watch_descriptor(-1), m_modification_times(), m_last_poll(std::chrono::steady_clock::now())
+{
+#ifdef __linux__
+	m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_inotify_fd < 0) {
+		std::cerr << "Error initializing inotify, falling back to polling for shader changes." << std::endl;
+		return;
+	}
+
+	// Editors often save through a temporary file renamed over the original
+	m_watch_descriptor = inotify_add_watch(m_inotify_fd, m_directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (m_watch_descriptor < 0) {
+		std::cerr << "Error watching \"" << m_directory << "\", falling back to polling for shader changes." << std::endl;
+		close(m_inotify_fd);
+		m_inotify_fd = -1;
+	}
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+#ifdef __linux__
+	if (m_inotify_fd >= 0)
+		close(m_inotify_fd);
+#endif
+}
+
+
+void ShaderWatcher::watch(Shader& shader)
+{
+	m_shaders.push_back(&shader);
+
+	m_modification_times[shader.vertexFile()] = modificationTime(shader.vertexFile());
+	if (!shader.fragmentFile().empty())
+		m_modification_times[shader.fragmentFile()] = modificationTime(shader.fragmentFile());
+}
+
+// Meant to be called once per frame; returns true when at least one program has been swapped,
+// meaning its uniforms have to be set again
+bool ShaderWatcher::update()
+{
+#ifdef __linux__
+	if (m_inotify_fd >= 0) {
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length(0);
+
+		while ((length = read(m_inotify_fd, buffer, sizeof(buffer))) > 0) {
+			for (char* ptr = buffer; ptr < buffer + length; ptr += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(ptr)->len) {
+				inotify_event const* event(reinterpret_cast<inotify_event*>(ptr));
+				if (event->len > 0)
+					reloadFile(m_directory + event->name);
+			}
+		}
+	}
+	else
+		pollModificationTimes();
+#else
+	pollModificationTimes();
+#endif
+
+
+	bool swapped(false);
+	for (auto it = m_pending_shaders.begin(); it != m_pending_shaders.end();) {
+		Shader* const shader(*it);
+		swapped |= shader->applyReload();
+
+		// With parallel compilation, a program still being built is simply checked again next frame
+		if (shader->reloading())
+			++it;
+		else
+			it = m_pending_shaders.erase(it);
+	}
+
+	return swapped;
+}
+
+
+void ShaderWatcher::reloadFile(std::string const& file_path)
+{
+	for (Shader* const shader : m_shaders) {
+		if (shader->vertexFile() != file_path && shader->fragmentFile() != file_path)
+			continue;
+
+		std::cout << "Shader source \"" << file_path << "\" changed, reloading." << std::endl;
+		shader->reload();
+
+		if (std::find(m_pending_shaders.begin(), m_pending_shaders.end(), shader) == m_pending_shaders.end())
+			m_pending_shaders.push_back(shader);
+	}
+}
+
+void ShaderWatcher::pollModificationTimes()
+{
+	const auto now(std::chrono::steady_clock::now());
+	if (now - m_last_poll < std::chrono::milliseconds(250))
+		return;
+	m_last_poll = now;
+
+	for (auto& file : m_modification_times) {
+		const long long modification_time(modificationTime(file.first));
+		if (modification_time != file.second) {
+			file.second = modification_time;
+			reloadFile(file.first);
+		}
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Shader.h"
+
+
+// Watches the shaders directory and rebuilds the programs whose sources changed on disk.
+// Uses inotify on Linux, falls back to polling modification times elsewhere.
+class ShaderWatcher
+{
+public:
+	explicit ShaderWatcher(std::string const& directory);
+	~ShaderWatcher();
+
+	void watch(Shader& shader);
+	bool update();
+
+private:
+	void reloadFile(std::string const& file_path);
+	void pollModificationTimes();
+
+	std::string const m_directory;
+	std::vector<Shader*> m_shaders;
+	std::vector<Shader*> m_pending_shaders;
+
+	int m_inotify_fd;
+	int m_watch_descriptor;
+
+	std::unordered_map<std::string, long long> m_modification_times;
+	std::chrono::steady_clock::time_point m_last_poll;
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#if defined(__AVX2__)
+#define SIMD_LANES_AVX
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SIMD_LANES_SSE
+#include <xmmintrin.h>
+#endif
+
+
+// Internal to the batched transform kernels (TransformSystem, Animation): one float per object or joint in each lane,
+// LANE_COUNT of them at a time, as wide as the target allows. The scalar fallback keeps the same kernels compiling.
+namespace Simd
+{
+#if defined(SIMD_LANES_AVX)
+	// Thin wrapper, operators can't be overloaded on the intrinsic types themselves
+	struct Lanes {
+		__m256 v;
+	};
+	constexpr size_t LANE_COUNT = 8;
+
+	inline Lanes load(const float* values) { return { _mm256_loadu_ps(values) }; }
+	inline void store(float* values, Lanes const& a) { _mm256_storeu_ps(values, a.v); }
+	inline Lanes set1(float const& value) { return { _mm256_set1_ps(value) }; }
+	inline Lanes operator+(Lanes const& a, Lanes const& b) { return { _mm256_add_ps(a.v, b.v) }; }
+	inline Lanes operator-(Lanes const& a, Lanes const& b) { return { _mm256_sub_ps(a.v, b.v) }; }
+	inline Lanes operator*(Lanes const& a, Lanes const& b) { return { _mm256_mul_ps(a.v, b.v) }; }
+	inline Lanes operator/(Lanes const& a, Lanes const& b) { return { _mm256_div_ps(a.v, b.v) }; }
+	inline Lanes sqrt(Lanes const& a) { return { _mm256_sqrt_ps(a.v) }; }
+	// value negated in the lanes where sign is negative
+	inline Lanes flipSign(Lanes const& value, Lanes const& sign) { return { _mm256_xor_ps(value.v, _mm256_and_ps(sign.v, _mm256_set1_ps(-0.f))) }; }
+
+	// Writes one column of LANE_COUNT consecutive matrices, transposing 4 of them at a time
+	inline void storeColumn(Lanes const& x, Lanes const& y, Lanes const& z, Lanes const& w, glm::mat4* out, int const& column)
+	{
+		for (int half = 0; half < 2; half++) {
+			__m128 c0, c1, c2, c3;
+			if (half == 0) {
+				c0 = _mm256_castps256_ps128(x.v); c1 = _mm256_castps256_ps128(y.v);
+				c2 = _mm256_castps256_ps128(z.v); c3 = _mm256_castps256_ps128(w.v);
+			}
+			else {
+				c0 = _mm256_extractf128_ps(x.v, 1); c1 = _mm256_extractf128_ps(y.v, 1);
+				c2 = _mm256_extractf128_ps(z.v, 1); c3 = _mm256_extractf128_ps(w.v, 1);
+			}
+			_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+			glm::mat4* const matrices(out + half * 4);
+			_mm_storeu_ps(&matrices[0][column][0], c0);
+			_mm_storeu_ps(&matrices[1][column][0], c1);
+			_mm_storeu_ps(&matrices[2][column][0], c2);
+			_mm_storeu_ps(&matrices[3][column][0], c3);
+		}
+	}
+#elif defined(SIMD_LANES_SSE)
+	struct Lanes {
+		__m128 v;
+	};
+	constexpr size_t LANE_COUNT = 4;
+
+	inline Lanes load(const float* values) { return { _mm_loadu_ps(values) }; }
+	inline void store(float* values, Lanes const& a) { _mm_storeu_ps(values, a.v); }
+	inline Lanes set1(float const& value) { return { _mm_set1_ps(value) }; }
+	inline Lanes operator+(Lanes const& a, Lanes const& b) { return { _mm_add_ps(a.v, b.v) }; }
+	inline Lanes operator-(Lanes const& a, Lanes const& b) { return { _mm_sub_ps(a.v, b.v) }; }
+	inline Lanes operator*(Lanes const& a, Lanes const& b) { return { _mm_mul_ps(a.v, b.v) }; }
+	inline Lanes operator/(Lanes const& a, Lanes const& b) { return { _mm_div_ps(a.v, b.v) }; }
+	inline Lanes sqrt(Lanes const& a) { return { _mm_sqrt_ps(a.v) }; }
+	inline Lanes flipSign(Lanes const& value, Lanes const& sign) { return { _mm_xor_ps(value.v, _mm_and_ps(sign.v, _mm_set1_ps(-0.f))) }; }
+
+	inline void storeColumn(Lanes const& x, Lanes const& y, Lanes const& z, Lanes const& w, glm::mat4* out, int const& column)
+	{
+		__m128 c0(x.v), c1(y.v), c2(z.v), c3(w.v);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		_mm_storeu_ps(&out[0][column][0], c0);
+		_mm_storeu_ps(&out[1][column][0], c1);
+		_mm_storeu_ps(&out[2][column][0], c2);
+		_mm_storeu_ps(&out[3][column][0], c3);
+	}
+#else
+	struct Lanes {
+		float v;
+	};
+	constexpr size_t LANE_COUNT = 1;
+
+	inline Lanes load(const float* values) { return { *values }; }
+	inline void store(float* values, Lanes const& a) { *values = a.v; }
+	inline Lanes set1(float const& value) { return { value }; }
+	inline Lanes operator+(Lanes const& a, Lanes const& b) { return { a.v + b.v }; }
+	inline Lanes operator-(Lanes const& a, Lanes const& b) { return { a.v - b.v }; }
+	inline Lanes operator*(Lanes const& a, Lanes const& b) { return { a.v * b.v }; }
+	inline Lanes operator/(Lanes const& a, Lanes const& b) { return { a.v / b.v }; }
+	inline Lanes sqrt(Lanes const& a) { return { std::sqrt(a.v) }; }
+	inline Lanes flipSign(Lanes const& value, Lanes const& sign) { return { std::signbit(sign.v) ? -value.v : value.v }; }
+
+	inline void storeColumn(Lanes const& x, Lanes const& y, Lanes const& z, Lanes const& w, glm::mat4* out, int const& column)
+	{
+		out[0][column] = glm::vec4(x.v, y.v, z.v, w.v);
+	}
+#endif
+
+	// out[i] = T * R * S from arrays of components, the rotation being expanded from the quaternion like glm::mat3_cast().
+	// count must be a multiple of LANE_COUNT.
+	inline void composeTrs(float const* const translation[3], float const* const rotation[4], float const* const scale[3], size_t const& count, glm::mat4* out)
+	{
+		const Lanes one(set1(1.f)), two(set1(2.f)), zero(set1(0.f));
+
+		for (size_t i = 0; i < count; i += LANE_COUNT) {
+			const Lanes x(load(rotation[0] + i)), y(load(rotation[1] + i)), z(load(rotation[2] + i)), w(load(rotation[3] + i));
+			const Lanes xx(x * x), yy(y * y), zz(z * z), xy(x * y), xz(x * z), yz(y * z), wx(w * x), wy(w * y), wz(w * z);
+
+			const Lanes scale_x(load(scale[0] + i)), scale_y(load(scale[1] + i)), scale_z(load(scale[2] + i));
+
+			storeColumn((one - two * (yy + zz)) * scale_x, two * (xy + wz) * scale_x, two * (xz - wy) * scale_x, zero, out + i, 0);
+			storeColumn(two * (xy - wz) * scale_y, (one - two * (xx + zz)) * scale_y, two * (yz + wx) * scale_y, zero, out + i, 1);
+			storeColumn(two * (xz + wy) * scale_z, two * (yz - wx) * scale_z, (one - two * (xx + yy)) * scale_z, zero, out + i, 2);
+			storeColumn(load(translation[0] + i), load(translation[1] + i), load(translation[2] + i), one, out + i, 3);
+		}
+	}
+}
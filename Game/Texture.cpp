@@ -1,33 +1,48 @@
 #include "Texture.h"
 
+#include <utility>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include "FileSystem.h"
+#include "TextureStreamer.h"
+
 
-Texture::Texture() : m_id(0), m_file()
+Texture::Texture() : m_texture(), m_file(), m_streamer(nullptr), m_stream_index(0)
 {
 }
 
-Texture::Texture(std::string const& file) : m_id(0), m_file(file)
+Texture::Texture(std::string const& file) : m_texture(), m_file(file), m_streamer(nullptr), m_stream_index(0)
 {
 }
 
-Texture::Texture(Texture const& texture_to_copy) : m_id(0), m_file(texture_to_copy.m_file)
+Texture::Texture(Texture&& other) noexcept : m_texture(std::move(other.m_texture)), m_file(std::move(other.m_file)),
+	m_streamer(other.m_streamer), m_stream_index(other.m_stream_index)
 {
-	load();
+	other.m_streamer = nullptr;
 }
 
-Texture& Texture::operator=(Texture const& texture_to_copy)
+Texture& Texture::operator=(Texture&& other) noexcept
 {
-	m_file = texture_to_copy.m_file;
-	load();
+	if (this != &other) {
+		if (m_streamer)
+			m_streamer->release(m_stream_index);
+
+		m_texture = std::move(other.m_texture);
+		m_file = std::move(other.m_file);
+		m_streamer = other.m_streamer;
+		m_stream_index = other.m_stream_index;
+		other.m_streamer = nullptr;
+	}
 
 	return *this;
 }
 
 Texture::~Texture()
 {
-	glDeleteTextures(1, &m_id);
+	if (m_streamer)
+		m_streamer->release(m_stream_index);
 }
 
 
@@ -35,13 +50,17 @@ bool Texture::load(GLuint const& texture_wrapping, GLuint const& min_filter, GLu
 {
 	stbi_set_flip_vertically_on_load(true);
 
-	if (glIsTexture(m_id) == GL_TRUE)
-		glDeleteTextures(1, &m_id);
+	// Every level is uploaded, the texture isn't streamed anymore
+	if (m_streamer) {
+		m_streamer->release(m_stream_index);
+		m_streamer = nullptr;
+	}
 
-	glGenTextures(1, &m_id);
+	// Replaces the previous texture, if any
+	m_texture = GLTexture::generate();
 
 	int width, height, nb_channels;
-	unsigned char* const data = stbi_load(m_file.c_str(), &width, &height, &nb_channels, 0);
+	unsigned char* const data = decode(m_file, width, height, nb_channels);
 
 	if (!data)
 	{
@@ -59,7 +78,7 @@ bool Texture::load(GLuint const& texture_wrapping, GLuint const& min_filter, GLu
 	else if (nb_channels == 4)
 		format = GL_RGBA;
 
-	glBindTexture(GL_TEXTURE_2D, m_id);
+	glBindTexture(GL_TEXTURE_2D, m_texture.id());
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texture_wrapping);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texture_wrapping);
@@ -82,7 +101,7 @@ bool Texture::load(GLuint const& texture_wrapping, GLuint const& min_filter, GLu
 
 GLuint Texture::id() const
 {
-	return m_id;
+	return m_texture.id();
 }
 
 std::string Texture::path() const
@@ -90,12 +109,17 @@ std::string Texture::path() const
 	return m_file;
 }
 
-std::string Texture::type() const
+void Texture::setImageFile(std::string const& file)
 {
-	return m_type;
+	m_file = file;
 }
 
-void Texture::setImageFile(std::string const& file)
+// Decoded straight from the mapped archive when the image is packed in it
+unsigned char* Texture::decode(std::string const& file, int& width, int& height, int& channels)
 {
-	m_file = file;
+	const FileData contents(FileSystem::read(file));
+	if (!contents.valid())
+		return nullptr;
+
+	return stbi_load_from_memory(contents.data(), static_cast<int>(contents.size()), &width, &height, &channels, 0);
 }
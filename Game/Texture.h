@@ -6,26 +6,35 @@
 
 #include <GL/glew.h>
 
+#include "GLHandle.h"
+
+class TextureStreamer;
+
 
 class Texture
 {
 public:
 	Texture();
 	explicit Texture(std::string const& file);
-	Texture(Texture const& texture_to_copy);
-	Texture& operator=(Texture const& texture_to_copy);
+	Texture(Texture&& other) noexcept;
+	Texture& operator=(Texture&& other) noexcept;
 	~Texture();
 
 	bool load(GLuint const& texture_wrapping = GL_REPEAT, GLuint const& min_filter = GL_LINEAR_MIPMAP_LINEAR, GLuint const& mag_filter = GL_LINEAR);
 
 	GLuint id() const;
 	std::string path() const;
-	std::string type() const;
 	void setImageFile(std::string const& file);
 
+	// Through the FileSystem, the pixels are freed with stbi_image_free
+	static unsigned char* decode(std::string const& file, int& width, int& height, int& channels);
+
 
 private:
-	GLuint m_id;
+	friend class TextureStreamer;
+
+	GLTexture m_texture;
 	std::string m_file;
-	std::string const m_type;
+	TextureStreamer* m_streamer; // when its levels are streamed
+	size_t m_stream_index;
 };
@@ -0,0 +1,401 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include "Profiler.h"
+
+
+namespace
+{
+	GLenum channelsFormat(int const& channels)
+	{
+		switch (channels) {
+		case 1: return GL_RED;
+		case 2: return GL_RG;
+		case 3: return GL_RGB;
+		default: return GL_RGBA;
+		}
+	}
+
+	// Next mip level of an 8 bits per channel image, 2x2 box filter. Sizes are rounded down like GL's, an odd last row
+	// or column is folded into the previous texel.
+	std::vector<unsigned char> halve(std::vector<unsigned char> const& pixels, unsigned int const& width, unsigned int const& height, unsigned int const& channels)
+	{
+		const unsigned int half_width(std::max(width / 2, 1u)), half_height(std::max(height / 2, 1u));
+		std::vector<unsigned char> half(static_cast<size_t>(half_width) * half_height * channels);
+
+		for (unsigned int y = 0; y < half_height; y++) {
+			const unsigned int y0(std::min(y * 2, height - 1)), y1(std::min(y * 2 + 1, height - 1));
+
+			for (unsigned int x = 0; x < half_width; x++) {
+				const unsigned int x0(std::min(x * 2, width - 1)), x1(std::min(x * 2 + 1, width - 1));
+
+				for (unsigned int c = 0; c < channels; c++) {
+					const unsigned int sum(pixels[(static_cast<size_t>(y0) * width + x0) * channels + c] + pixels[(static_cast<size_t>(y0) * width + x1) * channels + c]
+						+ pixels[(static_cast<size_t>(y1) * width + x0) * channels + c] + pixels[(static_cast<size_t>(y1) * width + x1) * channels + c]);
+					half[(static_cast<size_t>(y) * half_width + x) * channels + c] = static_cast<unsigned char>((sum + 2) / 4);
+				}
+			}
+		}
+
+		return half;
+	}
+
+	unsigned int levelCount(unsigned int const& width, unsigned int const& height)
+	{
+		unsigned int levels(1);
+		for (unsigned int size = std::max(width, height); size > 1; size /= 2)
+			levels++;
+		return levels;
+	}
+}
+
+
+TextureStreamer::TextureStreamer(size_t const& budget_bytes, unsigned int const& resident_size) : m_budget_bytes(budget_bytes), m_resident_size(std::max(resident_size, 1u)),
+	m_entries(), m_free(), m_resident_bytes(0), m_loading_bytes(0), m_frame(0), m_stats(), m_results_swap(),
+	m_mutex(), m_wake(), m_requests(), m_results(), m_running(true), m_thread()
+{
+	stbi_set_flip_vertically_on_load(true);
+	m_thread = std::thread(&TextureStreamer::workerLoop, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+	m_wake.notify_all();
+	m_thread.join();
+}
+
+
+// Decodes the whole image once to build the coarse levels, which stay resident until the texture is destroyed
+bool TextureStreamer::load(Texture& texture, GLuint const& texture_wrapping)
+{
+	int width(0), height(0), channels(0);
+	unsigned char* const data(Texture::decode(texture.path(), width, height, channels));
+	if (!data) {
+		std::cout << "Texture failed to load, path: " << texture.path() << std::endl;
+		return false;
+	}
+
+	Entry entry{ 0, texture.path(), channelsFormat(channels), static_cast<unsigned int>(channels), static_cast<unsigned int>(width), static_cast<unsigned int>(height),
+		0, 0, 0, 0, 0, false, true, 0 };
+	const unsigned int levels(levelCount(entry.width, entry.height));
+	while (entry.tail + 1 < levels && std::max(entry.width >> entry.tail, entry.height >> entry.tail) > m_resident_size)
+		entry.tail++;
+	entry.base = entry.tail;
+	entry.required = entry.tail;
+
+	if (texture.m_streamer)
+		texture.m_streamer->release(texture.m_stream_index);
+	texture.m_texture = GLTexture::generate();
+	entry.texture = texture.m_texture.id();
+	glBindTexture(GL_TEXTURE_2D, entry.texture);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texture_wrapping);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texture_wrapping);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.base);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+	float aniso = 0.0f;
+	glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &aniso);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, aniso);
+
+	std::vector<unsigned char> pixels(data, data + static_cast<size_t>(width) * height * channels);
+	stbi_image_free(data);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (unsigned int level = 0; level < levels; level++) {
+		if (level >= entry.tail)
+			upload(entry, level, pixels.data());
+		if (level + 1 < levels)
+			pixels = halve(pixels, std::max(entry.width >> level, 1u), std::max(entry.height >> level, 1u), entry.channels);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	m_resident_bytes += residentBytes(entry);
+	texture.m_streamer = this;
+	if (m_free.empty()) {
+		texture.m_stream_index = m_entries.size();
+		m_entries.push_back(entry);
+	}
+	else {
+		texture.m_stream_index = m_free.back();
+		m_free.pop_back();
+		entry.generation = m_entries[texture.m_stream_index].generation;
+		m_entries[texture.m_stream_index] = entry;
+	}
+
+	return true;
+}
+
+// Called by the texture when it's destroyed, its GL texture is deleted by its handle. The entry is reused by a later load.
+void TextureStreamer::release(size_t const& index)
+{
+	Entry& entry(m_entries[index]);
+	m_resident_bytes -= residentBytes(entry);
+	m_loading_bytes -= entry.loading_bytes;
+	entry.loading_bytes = 0;
+	entry.loading = false;
+	entry.alive = false;
+	entry.generation++;
+	m_free.push_back(index);
+
+	// Requests not picked up yet are dropped, the result of one being decoded won't match the generation anymore
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_requests.erase(std::remove_if(m_requests.begin(), m_requests.end(), [&index](Request const& request) { return request.index == index; }), m_requests.end());
+}
+
+
+// Once per frame on the GL thread, with the commands being drawn
+void TextureStreamer::update(FrameCommands const& commands, unsigned int const& viewport_height)
+{
+	m_frame++;
+
+	applyResults();
+	computeRequiredLevels(commands, viewport_height);
+	evict(0);
+	request();
+
+	m_stats = { m_resident_bytes, m_budget_bytes, 0, 0, 0 };
+	for (Entry const& entry : m_entries) {
+		if (!entry.alive)
+			continue;
+
+		m_stats.textures++;
+		m_stats.fully_resident += entry.base == 0 ? 1 : 0;
+		m_stats.loading += entry.loading ? 1 : 0;
+	}
+	Profiler::countTextures(m_stats.resident_bytes, m_stats.budget_bytes, m_stats.loading);
+}
+
+TextureStreamingStats const& TextureStreamer::stats() const
+{
+	return m_stats;
+}
+
+
+void TextureStreamer::applyResults()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_results_swap.swap(m_results);
+	}
+	if (m_results_swap.empty())
+		return;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (Result const& result : m_results_swap) {
+		Entry& entry(m_entries[result.index]);
+		if (result.generation != entry.generation)
+			continue;
+
+		m_loading_bytes -= entry.loading_bytes;
+		entry.loading_bytes = 0;
+		entry.loading = false;
+
+		// The file may have changed since the texture was loaded
+		if (result.width != entry.width || result.height != entry.height || result.channels != entry.channels || result.first_level >= entry.base)
+			continue;
+
+		// Every level down to the tail was decoded, which also covers the ones dropped in the meantime
+		glBindTexture(GL_TEXTURE_2D, entry.texture);
+		for (unsigned int level = result.first_level; level < entry.base; level++) {
+			upload(entry, level, result.levels[level - result.first_level].data());
+			m_resident_bytes += levelBytes(entry, level);
+		}
+		setBaseLevel(entry, result.first_level);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	m_results_swap.clear();
+}
+
+// Projected diameter of the drawn objects' bounding spheres, every texture of a model being assumed to span it once
+void TextureStreamer::computeRequiredLevels(FrameCommands const& commands, unsigned int const& viewport_height)
+{
+	const float tan_half_fov(1.f / commands.projection[1][1]);
+
+	const auto require = [&](DrawPacket const& packet) {
+		Model const& model(*packet.model);
+		if (model.textures().empty())
+			return;
+
+		const glm::vec3 center(packet.transform * glm::vec4(model.center(), 1.f));
+		const float scale(std::max(glm::length(glm::vec3(packet.transform[0])), std::max(glm::length(glm::vec3(packet.transform[1])), glm::length(glm::vec3(packet.transform[2])))));
+		const float radius(model.radius() * scale);
+		const float distance(glm::length(center - commands.camera_position));
+		const float pixels(distance > radius ? radius * viewport_height / (distance * tan_half_fov) : std::numeric_limits<float>::max());
+
+		for (std::unique_ptr<Texture> const& texture : model.textures()) {
+			if (texture->m_streamer != this)
+				continue;
+
+			Entry& entry(m_entries[texture->m_stream_index]);
+			const float size(static_cast<float>(std::max(entry.width, entry.height)));
+			const unsigned int level(pixels >= size ? 0 : std::min(static_cast<unsigned int>(std::log2(size / std::max(pixels, 1.f))), entry.tail));
+
+			entry.required = entry.last_seen == m_frame ? std::min(entry.required, level) : level;
+			entry.last_seen = m_frame;
+		}
+	};
+
+	// Objects culled on the GPU are all treated as seen
+	for (RenderPass const pass : { PASS_LAMPS, PASS_OPAQUE, PASS_TRANSPARENT })
+		for (DrawPacket const& packet : commands.passes[pass])
+			require(packet);
+	for (DrawPacket const& packet : commands.gpu_packets)
+		require(packet);
+	for (DrawPacket const& packet : commands.skinned)
+		require(packet);
+}
+
+// Drops finest levels until incoming_bytes more fit in the budget: first the levels finer than their texture needs,
+// then those of the textures not seen for a while, least recently seen first. Levels in use are never dropped.
+void TextureStreamer::evict(size_t const& incoming_bytes)
+{
+	while (m_resident_bytes + m_loading_bytes + incoming_bytes > m_budget_bytes) {
+		Entry* victim(nullptr);
+		bool victim_unneeded(false);
+
+		for (Entry& entry : m_entries) {
+			if (!entry.alive || entry.base >= entry.tail)
+				continue;
+
+			const bool unneeded(entry.base < entry.required);
+			if (!unneeded && entry.last_seen + s_keep_frames >= m_frame)
+				continue;
+
+			if (!victim || (unneeded && !victim_unneeded) || (unneeded == victim_unneeded && entry.last_seen < victim->last_seen)) {
+				victim = &entry;
+				victim_unneeded = unneeded;
+			}
+		}
+
+		if (!victim)
+			return;
+
+		// Clamped first so the texture stays complete, the level is then respecified empty to free its memory
+		const unsigned int level(victim->base);
+		setBaseLevel(*victim, level + 1);
+		m_resident_bytes -= levelBytes(*victim, level);
+		glBindTexture(GL_TEXTURE_2D, victim->texture);
+		glTexImage2D(GL_TEXTURE_2D, level, victim->format, 0, 0, 0, victim->format, GL_UNSIGNED_BYTE, nullptr);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+}
+
+// Textures seen this frame get the levels they miss, as long as the budget allows
+void TextureStreamer::request()
+{
+	bool requested(false);
+
+	for (size_t i = 0; i < m_entries.size(); i++) {
+		Entry& entry(m_entries[i]);
+		if (!entry.alive || entry.loading || entry.last_seen != m_frame || entry.required >= entry.base)
+			continue;
+
+		size_t bytes(0);
+		for (unsigned int level = entry.required; level < entry.base; level++)
+			bytes += levelBytes(entry, level);
+
+		evict(bytes);
+		if (m_resident_bytes + m_loading_bytes + bytes > m_budget_bytes)
+			continue;
+
+		entry.loading = true;
+		entry.loading_bytes = bytes;
+		m_loading_bytes += bytes;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_requests.push_back({ i, entry.generation, entry.file, entry.required, entry.tail - 1 });
+		requested = true;
+	}
+
+	if (requested)
+		m_wake.notify_one();
+}
+
+
+// Texture must be bound, with GL_UNPACK_ALIGNMENT at 1
+void TextureStreamer::upload(Entry const& entry, unsigned int const& level, unsigned char const* pixels) const
+{
+	glTexImage2D(GL_TEXTURE_2D, level, entry.format, std::max(entry.width >> level, 1u), std::max(entry.height >> level, 1u), 0, entry.format, GL_UNSIGNED_BYTE, pixels);
+}
+
+void TextureStreamer::setBaseLevel(Entry& entry, unsigned int const& level)
+{
+	entry.base = level;
+	glBindTexture(GL_TEXTURE_2D, entry.texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Estimated, drivers store RGB textures with 4 bytes per texel
+size_t TextureStreamer::levelBytes(Entry const& entry, unsigned int const& level) const
+{
+	return static_cast<size_t>(std::max(entry.width >> level, 1u)) * std::max(entry.height >> level, 1u) * (entry.channels == 3 ? 4 : entry.channels);
+}
+
+size_t TextureStreamer::residentBytes(Entry const& entry) const
+{
+	size_t bytes(0);
+	for (unsigned int level = entry.base, levels = levelCount(entry.width, entry.height); level < levels; level++)
+		bytes += levelBytes(entry, level);
+	return bytes;
+}
+
+
+// Decodes the image again for every request, only the levels down to the tail are kept
+void TextureStreamer::workerLoop()
+{
+	while (true) {
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this]() { return !m_requests.empty() || !m_running; });
+			if (!m_running)
+				return;
+
+			request = std::move(m_requests.front());
+			m_requests.erase(m_requests.begin());
+		}
+
+		Result result{ request.index, request.generation, request.first_level, 0, 0, 0, {} };
+		int width(0), height(0), channels(0);
+		unsigned char* const data(Texture::decode(request.file, width, height, channels));
+		if (data) {
+			result.width = static_cast<unsigned int>(width);
+			result.height = static_cast<unsigned int>(height);
+			result.channels = static_cast<unsigned int>(channels);
+
+			std::vector<unsigned char> pixels(data, data + static_cast<size_t>(width) * height * channels);
+			stbi_image_free(data);
+
+			for (unsigned int level = 0; level <= request.last_level; level++) {
+				if (level >= request.first_level)
+					result.levels.push_back(pixels);
+				if (level < request.last_level)
+					pixels = halve(pixels, std::max(result.width >> level, 1u), std::max(result.height >> level, 1u), result.channels);
+			}
+		}
+		else
+			std::cerr << "Error: texture \"" << request.file << "\" could not be streamed." << std::endl;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_results.push_back(std::move(result));
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "Scene.h"
+#include "Texture.h"
+
+
+struct TextureStreamingStats {
+	size_t resident_bytes;
+	size_t budget_bytes;
+	unsigned int textures;
+	unsigned int fully_resident; // textures with their level 0 resident
+	unsigned int loading; // textures waiting for levels from the streaming thread
+};
+
+
+// Keeps the mip levels of the textures resident according to their size on screen. Only the coarse levels (up to
+// resident_size texels) are uploaded at load, the finer ones are decoded again from the image file by a background
+// thread when a texture needs them, and the finest levels of the least recently seen textures are dropped to stay under
+// the budget. GL_TEXTURE_BASE_LEVEL is clamped to the finest resident level, the texture names never change.
+class TextureStreamer
+{
+public:
+	TextureStreamer(size_t const& budget_bytes, unsigned int const& resident_size);
+	~TextureStreamer();
+
+	bool load(Texture& texture, GLuint const& texture_wrapping = GL_REPEAT);
+	void release(size_t const& index);
+
+	void update(FrameCommands const& commands, unsigned int const& viewport_height);
+	TextureStreamingStats const& stats() const;
+
+private:
+	struct Entry {
+		GLuint texture; // owned by the Texture
+		std::string file;
+		GLenum format;
+		unsigned int channels;
+		unsigned int width, height; // of level 0
+		unsigned int tail; // first level uploaded at load, never dropped
+		unsigned int base; // finest resident level
+		unsigned int required; // finest level needed on screen, during the last frame it was seen
+		unsigned long long last_seen; // frame
+		size_t loading_bytes; // of the levels requested, 0 when none is
+		bool loading;
+		bool alive;
+		unsigned int generation; // bumped when released, results of the requests made before are dropped
+	};
+
+	struct Request {
+		size_t index;
+		unsigned int generation;
+		std::string file;
+		unsigned int first_level, last_level; // levels to decode, inclusive
+	};
+
+	struct Result {
+		size_t index;
+		unsigned int generation;
+		unsigned int first_level;
+		unsigned int width, height, channels; // of level 0 as decoded, checked against the entry
+		std::vector<std::vector<unsigned char>> levels; // first_level onwards
+	};
+
+	static constexpr unsigned int s_keep_frames = 60; // levels seen more recently are only dropped when nothing else can be
+
+	void applyResults();
+	void computeRequiredLevels(FrameCommands const& commands, unsigned int const& viewport_height);
+	void evict(size_t const& incoming_bytes);
+	void request();
+
+	void upload(Entry const& entry, unsigned int const& level, unsigned char const* pixels) const;
+	void setBaseLevel(Entry& entry, unsigned int const& level);
+	size_t levelBytes(Entry const& entry, unsigned int const& level) const;
+	size_t residentBytes(Entry const& entry) const;
+
+	void workerLoop();
+
+	size_t const m_budget_bytes;
+	unsigned int const m_resident_size;
+	std::vector<Entry> m_entries;
+	std::vector<size_t> m_free; // released entries, reused by the next loads
+	size_t m_resident_bytes;
+	size_t m_loading_bytes; // levels requested and not uploaded yet
+	unsigned long long m_frame;
+	TextureStreamingStats m_stats;
+
+	std::vector<Result> m_results_swap; // applied on the GL thread, swapped with m_results
+
+	// Shared with the streaming thread
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::vector<Request> m_requests;
+	std::vector<Result> m_results;
+	bool m_running;
+	std::thread m_thread;
+};
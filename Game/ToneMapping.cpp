@@ -0,0 +1,36 @@
+#include "ToneMapping.h"
+
+
+ToneMapping::ToneMapping(float const& exposure, std::string const& shaders_directory) :
+	m_exposure(exposure),
+	m_shader(shaders_directory + "fullscreen.vert", shaders_directory + "tone_mapping.frag")
+{
+}
+
+ToneMapping::~ToneMapping()
+{
+}
+
+
+RenderTarget const& ToneMapping::render(PostProcessChain& chain, RenderTarget const& input) const
+{
+	RenderTarget const& output(chain.pool().acquire(chain.width(), chain.height(), GL_RGBA8));
+	glBindFramebuffer(GL_FRAMEBUFFER, output.framebuffer);
+	glViewport(0, 0, chain.renderWidth(), chain.renderHeight());
+
+	m_shader.use();
+	m_shader.setUni("scene", 0);
+	m_shader.setUni("exposure", m_exposure);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, input.texture);
+	chain.drawFullscreen();
+
+	return output;
+}
+
+
+// Exposed for hot reloading
+Shader& ToneMapping::shader()
+{
+	return m_shader;
+}
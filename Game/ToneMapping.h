@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+#include "PostProcessChain.h"
+#include "Shader.h"
+
+
+// Maps the HDR scene to an RGBA8 target with an exposure and a filmic curve, usually the last pass of the chain
+class ToneMapping
+{
+public:
+	ToneMapping(float const& exposure, std::string const& shaders_directory);
+	~ToneMapping();
+
+	RenderTarget const& render(PostProcessChain& chain, RenderTarget const& input) const;
+
+	Shader& shader();
+
+private:
+	float const m_exposure;
+
+	Shader m_shader;
+};
@@ -0,0 +1,144 @@
+#include "TransformSystem.h"
+
+#include <initializer_list>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "MatrixBatch.h"
+#include "SimdLanes.h"
+
+
+constexpr size_t TransformSystem::s_block_size;
+
+TransformSystem::TransformSystem() : m_count(0),
+	m_position_x(), m_position_y(), m_position_z(),
+	m_rotation_x(), m_rotation_y(), m_rotation_z(), m_rotation_w(),
+	m_scale_x(), m_scale_y(), m_scale_z(), m_world(), m_dirty_blocks(), m_version(0)
+{
+}
+
+TransformSystem::~TransformSystem()
+{
+}
+
+
+size_t TransformSystem::create(glm::vec3 const& position, glm::quat const& rotation, glm::vec3 const& scale)
+{
+	if (m_count == m_world.size()) {
+		const size_t capacity(m_count + s_block_size);
+
+		for (std::vector<float>* zeros : { &m_position_x, &m_position_y, &m_position_z, &m_rotation_x, &m_rotation_y, &m_rotation_z })
+			zeros->resize(capacity, 0.f);
+		for (std::vector<float>* ones : { &m_rotation_w, &m_scale_x, &m_scale_y, &m_scale_z })
+			ones->resize(capacity, 1.f);
+		m_world.resize(capacity, glm::mat4(1.f));
+		m_dirty_blocks.push_back(0);
+	}
+
+	const size_t handle(m_count++);
+	setPosition(handle, position);
+	setRotation(handle, rotation);
+	setScale(handle, scale);
+
+	return handle;
+}
+
+
+void TransformSystem::setPosition(size_t const& handle, glm::vec3 const& position)
+{
+	m_position_x[handle] = position.x;
+	m_position_y[handle] = position.y;
+	m_position_z[handle] = position.z;
+	markDirty(handle);
+}
+
+void TransformSystem::setRotation(size_t const& handle, glm::quat const& rotation)
+{
+	m_rotation_x[handle] = rotation.x;
+	m_rotation_y[handle] = rotation.y;
+	m_rotation_z[handle] = rotation.z;
+	m_rotation_w[handle] = rotation.w;
+	markDirty(handle);
+}
+
+void TransformSystem::setScale(size_t const& handle, glm::vec3 const& scale)
+{
+	m_scale_x[handle] = scale.x;
+	m_scale_y[handle] = scale.y;
+	m_scale_z[handle] = scale.z;
+	markDirty(handle);
+}
+
+
+glm::vec3 TransformSystem::position(size_t const& handle) const
+{
+	return glm::vec3(m_position_x[handle], m_position_y[handle], m_position_z[handle]);
+}
+
+glm::vec3 TransformSystem::scale(size_t const& handle) const
+{
+	return glm::vec3(m_scale_x[handle], m_scale_y[handle], m_scale_z[handle]);
+}
+
+// Only up to date after update()
+glm::mat4 const& TransformSystem::world(size_t const& handle) const
+{
+	return m_world[handle];
+}
+
+
+void TransformSystem::update()
+{
+	update(0, m_count);
+}
+
+// Rebuilds the dirty blocks overlapping [begin, end), ranges updated concurrently must not share a block
+void TransformSystem::update(size_t const& begin, size_t const& end)
+{
+	for (size_t block = begin / s_block_size; block * s_block_size < end; block++) {
+		if (!m_dirty_blocks[block])
+			continue;
+
+		composeBlock(block * s_block_size);
+		m_dirty_blocks[block] = 0;
+	}
+}
+
+void TransformSystem::modelViewProj(glm::mat4 const& view_projection, size_t const& begin, size_t const& end, glm::mat4* out) const
+{
+	MatrixBatch::multiply(view_projection, m_world.data() + begin, out, end - begin);
+}
+
+size_t TransformSystem::size() const
+{
+	return m_count;
+}
+
+unsigned long long TransformSystem::version() const
+{
+	return m_version;
+}
+
+
+// Scalar reference, what the batched path computes
+glm::mat4 TransformSystem::compose(glm::vec3 const& position, glm::quat const& rotation, glm::vec3 const& scale)
+{
+	return glm::scale(glm::translate(glm::mat4(1.f), position) * glm::mat4_cast(rotation), scale);
+}
+
+
+void TransformSystem::markDirty(size_t const& handle)
+{
+	m_dirty_blocks[handle / s_block_size] = 1;
+	m_version++;
+}
+
+// World = T * R * S, batched like compose()
+void TransformSystem::composeBlock(size_t const& first)
+{
+	float const* const translation[3] = { &m_position_x[first], &m_position_y[first], &m_position_z[first] };
+	float const* const rotation[4] = { &m_rotation_x[first], &m_rotation_y[first], &m_rotation_z[first], &m_rotation_w[first] };
+	float const* const scale[3] = { &m_scale_x[first], &m_scale_y[first], &m_scale_z[first] };
+	Simd::composeTrs(translation, rotation, scale, s_block_size, &m_world[first]);
+}
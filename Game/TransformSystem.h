@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+
+// Translation, rotation and scale of every object stored as structure of arrays, world matrices are rebuilt in batch
+// (8 objects per iteration with AVX2, 4 with SSE) and only for the blocks where something changed since the last update.
+// Handles are indices and stay valid for the lifetime of the system.
+class TransformSystem
+{
+public:
+	static constexpr size_t s_block_size = 8; // objects sharing a dirty flag, also the widest SIMD batch
+
+	TransformSystem();
+	~TransformSystem();
+
+	size_t create(glm::vec3 const& position, glm::quat const& rotation, glm::vec3 const& scale);
+
+	void setPosition(size_t const& handle, glm::vec3 const& position);
+	void setRotation(size_t const& handle, glm::quat const& rotation);
+	void setScale(size_t const& handle, glm::vec3 const& scale);
+
+	glm::vec3 position(size_t const& handle) const;
+	glm::vec3 scale(size_t const& handle) const;
+	glm::mat4 const& world(size_t const& handle) const;
+
+	void update();
+	void update(size_t const& begin, size_t const& end);
+	void modelViewProj(glm::mat4 const& view_projection, size_t const& begin, size_t const& end, glm::mat4* out) const;
+
+	size_t size() const;
+	unsigned long long version() const;
+
+	static glm::mat4 compose(glm::vec3 const& position, glm::quat const& rotation, glm::vec3 const& scale);
+
+private:
+	void markDirty(size_t const& handle);
+	void composeBlock(size_t const& first);
+
+	size_t m_count;
+
+	// Padded to a multiple of s_block_size with identity transforms so that blocks are always full
+	std::vector<float> m_position_x, m_position_y, m_position_z;
+	std::vector<float> m_rotation_x, m_rotation_y, m_rotation_z, m_rotation_w;
+	std::vector<float> m_scale_x, m_scale_y, m_scale_z;
+	std::vector<glm::mat4> m_world;
+	std::vector<uint8_t> m_dirty_blocks;
+	unsigned long long m_version; // bumped by every change, tells caches built from the world matrices they're stale
+};
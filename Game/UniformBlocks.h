@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include <GL/glew.h>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+
+// CPU mirrors of the std140 uniform blocks declared in the shaders, any change must be done on both sides
+
+constexpr GLuint OBJECT_BLOCK_BINDING = 0, LIGHTS_BLOCK_BINDING = 1, SHADOWS_BLOCK_BINDING = 2;
+// Per frame in flight, each ObjectBlock takes up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT bytes (256 on most hardware)
+constexpr GLsizeiptr DYNAMIC_BUFFER_REGION_SIZE = 1 << 20;
+
+struct ObjectBlock {
+	glm::mat4 model;
+	glm::mat4 model_view_proj;
+	std::array<glm::vec4, 3> normal_matrix; // mat3 columns, padded to vec4 by std140
+};
+static_assert(sizeof(ObjectBlock) == 176, "ObjectBlock doesn't match the std140 layout of the Object block");
+
+// Element of the Objects storage buffer of the GPU-driven opaque pass (std430)
+struct GpuObjectBlock {
+	ObjectBlock object;
+	glm::vec4 bounds; // world space bounding sphere, w = radius
+};
+static_assert(sizeof(GpuObjectBlock) == 192, "GpuObjectBlock doesn't match the std430 layout of ObjectData");
+
+// Members are ordered so every vec3 is followed by a scalar, which std140 packs in the same 16 bytes
+struct LightBlock {
+	glm::vec3 position;
+	GLint type; // 0 = directional light, 1 = point light, 2 = spotlight (soft edges)
+	glm::vec3 direction;
+	GLfloat cutoff;
+	glm::vec3 ambient;
+	GLfloat outer_cutoff;
+	glm::vec3 diffuse;
+	GLfloat constant;
+	glm::vec3 specular;
+	GLfloat linear;
+	GLfloat quadratic;
+	GLfloat padding[3];
+};
+static_assert(sizeof(LightBlock) == 96, "LightBlock doesn't match the std140 layout of the Light struct");
+
+constexpr size_t LIGHTS_COUNT = 6; // NR_LIGHTS in basic.frag
+
+constexpr size_t MAX_SHADOW_CASCADES = 4; // MAX_SHADOW_CASCADES in basic.frag
+// Above the material textures of any mesh, a sampler2DArrayShadow can't share a unit with their sampler2D
+constexpr GLuint SHADOW_MAP_TEXTURE_UNIT = 8;
+// samplerBuffer of the skinning palettes, read as GL_RGBA32F texels
+constexpr GLuint SKINNING_PALETTE_TEXTURE_UNIT = 9;
+// Per frame in flight, 48 bytes per bone of every posed instance (e.g. 300 instances of 60 bones take 864 KB)
+constexpr GLsizeiptr PALETTE_BUFFER_REGION_SIZE = 4 << 20;
+
+struct ShadowBlock {
+	std::array<glm::mat4, MAX_SHADOW_CASCADES> view_projs; // world to the cascade's clip space
+	glm::vec4 splits; // far end of every cascade, as a distance along the camera's front
+	glm::vec3 camera_front;
+	GLint cascade_count; // 0 when shadows are disabled
+};
+static_assert(sizeof(ShadowBlock) == 288, "ShadowBlock doesn't match the std140 layout of the Shadows block");
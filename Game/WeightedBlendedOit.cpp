@@ -0,0 +1,104 @@
+#include "WeightedBlendedOit.h"
+
+#include <iostream>
+
+#include "Profiler.h"
+
+
+WeightedBlendedOit::WeightedBlendedOit(unsigned int const& width, unsigned int const& height, GLuint const& depth_stencil_renderbuffer, std::string const& shaders_directory) :
+	m_framebuffer(0), m_accumulation(0), m_weight_sum(0), m_empty_vao(0), m_valid(false),
+	m_composite_shader(shaders_directory + "fullscreen.vert", shaders_directory + "oit_composite.frag")
+{
+	const auto create_target = [width, height](GLuint& texture, GLint const& internal_format, GLenum const& format) {
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	};
+	create_target(m_accumulation, GL_RGBA16F, GL_RGBA);
+	create_target(m_weight_sum, GL_R16F, GL_RED);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_accumulation, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_weight_sum, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_stencil_renderbuffer);
+
+	const GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, draw_buffers);
+
+	m_valid = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	if (!m_valid)
+		std::cerr << "Error: order-independent transparency framebuffer is incomplete." << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenVertexArrays(1, &m_empty_vao);
+}
+
+WeightedBlendedOit::~WeightedBlendedOit()
+{
+	glDeleteVertexArrays(1, &m_empty_vao);
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glDeleteTextures(1, &m_accumulation);
+	glDeleteTextures(1, &m_weight_sum);
+}
+
+
+bool WeightedBlendedOit::valid() const
+{
+	return m_valid;
+}
+
+// Binds and clears the targets and sets the blending state, transparent objects can be drawn in any order afterwards
+void WeightedBlendedOit::begin() const
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+
+	const GLfloat accumulation_clear[] = { 0.f, 0.f, 0.f, 1.f };
+	const GLfloat weight_sum_clear[] = { 0.f, 0.f, 0.f, 0.f };
+	glClearBufferfv(GL_COLOR, 0, accumulation_clear);
+	glClearBufferfv(GL_COLOR, 1, weight_sum_clear);
+
+	// GL 3.3 has no per-target blend functions, so the revealage lives in the alpha of the accumulation target
+	glDepthMask(GL_FALSE);
+	glEnable(GL_BLEND);
+	glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+// Resolves the accumulated layers over the color of scene_framebuffer, restoring depth writes and the default blending
+void WeightedBlendedOit::composite(GLuint const& scene_framebuffer) const
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, scene_framebuffer);
+	glDepthMask(GL_TRUE);
+	glDisable(GL_DEPTH_TEST);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	// Sampler units are set on every use so that hot reloads need no extra setup
+	m_composite_shader.use();
+	m_composite_shader.setUni("accumulation", 0);
+	m_composite_shader.setUni("weight_sum", 1);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_accumulation);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, m_weight_sum);
+
+	glBindVertexArray(m_empty_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	Profiler::countDraw(3);
+
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glEnable(GL_DEPTH_TEST);
+}
+
+// Exposed for hot reloading
+Shader& WeightedBlendedOit::compositeShader()
+{
+	return m_composite_shader;
+}
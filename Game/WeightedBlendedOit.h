@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+#include <GL/glew.h>
+
+#include "Shader.h"
+
+
+// Weighted blended order-independent transparency (McGuire and Bavoil, 2013): transparent surfaces are accumulated
+// in any order into an RGBA16F target (weighted premultiplied color, revealage in alpha) and an R16F one (weight sum),
+// then resolved over the opaque image with a single fullscreen pass.
+// The scene's depth buffer is attached to test against opaque geometry, transparent draws must not write depth.
+class WeightedBlendedOit
+{
+public:
+	WeightedBlendedOit(unsigned int const& width, unsigned int const& height, GLuint const& depth_stencil_renderbuffer, std::string const& shaders_directory);
+	~WeightedBlendedOit();
+
+	bool valid() const;
+
+	void begin() const;
+	void composite(GLuint const& scene_framebuffer) const;
+
+	Shader& compositeShader();
+
+private:
+	GLuint m_framebuffer;
+	GLuint m_accumulation;
+	GLuint m_weight_sum;
+	GLuint m_empty_vao; // core profile draws need a vertex array even without attributes
+	bool m_valid;
+
+	Shader m_composite_shader;
+};
@@ -1,25 +1,94 @@
+#include <iostream>
+#include <memory>
 #include <string>
 
 #include <SimpleIni.h>
 
+#include "Archive.h"
+#include "Benchmark.h"
+#include "FileSystem.h"
 #include "Renderer.h"
 
 
+// Usage: Game [--data <directory>] [--benchmark <frames>] [--headless] [--output <report.json>] [--no-allocations] [--bench-transforms <count>]
+//             [--bench-animation <instances>] [--pack <archive> [--compress]]
+//   --data       directory holding config.ini, Models/ and Shaders/ (defaults to the working directory)
+//   --benchmark  renders the given number of frames along a scripted camera path and writes a JSON report
+//   --headless   renders offscreen through EGL without creating a window, implies --benchmark
+//   --no-allocations  makes the benchmark fail if any measured frame allocates through operator new
+//   --bench-transforms  times the batched transform updates against glm for the given number of objects, then exits
+//   --bench-animation  times the posing of the given number of instances of a synthetic skeleton, then exits
+//   --pack       packs Models/ and Shaders/ of the data directory into the given archive, then exits
+//   --compress   LZ4 compresses the packed files when it saves space
 int main(int argc, char* argv[])
 {
-	const std::string directory = "C:/Users/taosc/Documents/Repositories/Game/";
+	std::string directory = "./";
 	const std::string window_title = "Game";
 
+	bool headless(false);
+	bool no_allocations(false);
+	unsigned int benchmark_frames(0);
+	std::string report_file("benchmark.json");
+	std::string archive_file;
+	bool compress(false);
+
+	for (int i = 1; i < argc; i++) {
+		const std::string argument(argv[i]);
+		const bool has_value(i + 1 < argc);
+
+		if (argument == "--data" && has_value) {
+			directory = argv[++i];
+			if (!directory.empty() && directory.back() != '/' && directory.back() != '\\')
+				directory += '/';
+		}
+		else if (argument == "--benchmark" && has_value)
+			benchmark_frames = static_cast<unsigned int>(std::stoul(argv[++i]));
+		else if (argument == "--output" && has_value)
+			report_file = argv[++i];
+		else if (argument == "--headless")
+			headless = true;
+		else if (argument == "--no-allocations")
+			no_allocations = true;
+		else if (argument == "--pack" && has_value)
+			archive_file = argv[++i];
+		else if (argument == "--compress")
+			compress = true;
+		else if (argument == "--bench-transforms" && has_value) {
+			Benchmark::transforms(std::stoul(argv[++i]));
+			return EXIT_SUCCESS;
+		}
+		else if (argument == "--bench-animation" && has_value) {
+			Benchmark::animation(std::stoul(argv[++i]));
+			return EXIT_SUCCESS;
+		}
+		else
+			std::cerr << "Ignoring unknown argument \"" << argument << "\"." << std::endl;
+	}
+	if (headless && benchmark_frames == 0)
+		benchmark_frames = 600;
+
+	if (!archive_file.empty())
+		return Archive::pack(directory, { "Models", "Shaders" }, archive_file, compress) ? EXIT_SUCCESS : EXIT_FAILURE;
+
 	CSimpleIniA ini_file;
 	ini_file.SetUnicode();
 	ini_file.LoadFile((directory + "config.ini").c_str());
 
+	// Assets packed with --pack, the loose files are still read when the archive is missing
+	const std::string archive(ini_file.GetValue("Data", "Archive", ""));
+	if (!archive.empty() && !FileSystem::mount(directory + archive, directory))
+		std::cerr << "Reading the loose files of \"" << directory << "\" instead." << std::endl;
+
 	Renderer mainRender{ window_title, directory, ini_file };
 
-	if (!mainRender.init())
+	if (!mainRender.init(headless))
 		return EXIT_FAILURE;
 
-	mainRender.mainLoop();
+	std::unique_ptr<Benchmark> benchmark;
+	if (benchmark_frames > 0)
+		benchmark.reset(new Benchmark(benchmark_frames, report_file, no_allocations));
+
+	mainRender.mainLoop(benchmark.get());
 
-	return EXIT_SUCCESS;
+	return benchmark && !benchmark->passed() ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -11,36 +11,53 @@ struct Material {
 };
 uniform Material material;
 
+// Mirrors LightBlock (UniformBlocks.h), every vec3 is followed by a scalar to keep the std140 packing tight
 struct Light {
-	int type; // 0 = directional light, 1 = point light, 2 = spotlight (soft edges)
-
 	vec3 position;
+	int type; // 0 = directional light, 1 = point light, 2 = spotlight (soft edges)
 	vec3 direction;
-
 	float cutoff;
-	float outer_cutoff;
-
 	vec3 ambient;
+	float outer_cutoff;
 	vec3 diffuse;
-	vec3 specular;
-
 	float constant;
+	vec3 specular;
 	float linear;
 	float quadratic;
 };
 #define NR_LIGHTS 6
-uniform Light lights[NR_LIGHTS];
+layout(std140) uniform Lights {
+	Light lights[NR_LIGHTS];
+};
 
 uniform vec3 view_pos;
 
+// Mirrors ShadowBlock (UniformBlocks.h), cascades of the directional light lights[0]
+#define MAX_SHADOW_CASCADES 4
+layout(std140) uniform Shadows {
+	mat4 cascade_view_projs[MAX_SHADOW_CASCADES];
+	vec4 cascade_splits; // far end of every cascade along the camera's front
+	vec3 camera_front;
+	int cascade_count; // 0 when shadows are disabled
+};
+uniform sampler2DArrayShadow shadow_map;
 
+
+#ifdef WEIGHTED_BLENDED_OIT
+// Both targets share the blend function (ONE, ONE) / (ZERO, ONE_MINUS_SRC_ALPHA): the alpha of the first one
+// ends up holding the revealage, the product of (1 - alpha) of every layer
+layout(location = 0) out vec4 accumulation;
+layout(location = 1) out float weight_sum;
+#else
 out vec4 frag_color;
+#endif
 
 
-vec4 Phong(Light light, vec3 normal, vec3 view_dir);
-vec4 DirLight(Light light, vec3 normal, vec3 view_dir);
+vec4 Phong(Light light, vec3 light_dir, vec3 normal, vec3 view_dir, float lit);
+vec4 DirLight(Light light, vec3 normal, vec3 view_dir, float lit);
 vec4 PointLight(Light light, vec3 normal, vec3 frag_pos, vec3 view_dir);
 vec4 Spotlight(Light light, vec3 normal, vec3 frag_pos, vec3 view_dir);
+float Shadow(vec3 normal, vec3 light_dir);
 
 
 void main()
@@ -52,17 +69,25 @@ void main()
 
 	for (int i = 0; i < NR_LIGHTS; i++) {
 		if (lights[i].type == 0)
-			result += DirLight(lights[i], normal, view_dir);
+			result += DirLight(lights[i], normal, view_dir, i == 0 ? Shadow(normal, normalize(-lights[i].direction)) : 1.f);
 		else if (lights[i].type == 1)
 			result += PointLight(lights[i], normal, frag_pos, view_dir);
 		else if (lights[i].type == 2)
 			result += Spotlight(lights[i], normal, frag_pos, view_dir);
 	}
 
+#ifdef WEIGHTED_BLENDED_OIT
+	// Depth weight from McGuire and Bavoil (2013), equation 9
+	float alpha = result.a;
+	float weight = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+	accumulation = vec4(result.rgb * alpha * weight, alpha);
+	weight_sum = alpha * weight;
+#else
 	frag_color = result;
+#endif
 }
 
-vec4 Phong(Light light, vec3 light_dir, vec3 normal, vec3 view_dir) {
+vec4 Phong(Light light, vec3 light_dir, vec3 normal, vec3 view_dir, float lit) {
 	vec4 sampled_texture = texture(material.specular, vertex_tex_coord);
 
 	vec3 reflect_dir = reflect(-light_dir, normal);
@@ -78,13 +103,15 @@ vec4 Phong(Light light, vec3 light_dir, vec3 normal, vec3 view_dir) {
 	vec4 ambient = vec4(sampled_texture.xyz * light.ambient, sampled_texture.w);
 
 
-	return ambient + diffuse + specular;
+	// Shadows keep the ambient term and the alpha
+	vec4 direct = diffuse + specular;
+	return ambient + vec4(direct.xyz * lit, direct.w);
 }
 
-vec4 DirLight(Light light, vec3 normal, vec3 view_dir) {
+vec4 DirLight(Light light, vec3 normal, vec3 view_dir, float lit) {
 	vec3 light_dir = normalize(-light.direction);
 
-	return Phong(light, light_dir, normal, view_dir);
+	return Phong(light, light_dir, normal, view_dir, lit);
 }
 
 vec4 PointLight(Light light, vec3 normal, vec3 frag_pos, vec3 view_dir) {
@@ -93,7 +120,7 @@ vec4 PointLight(Light light, vec3 normal, vec3 frag_pos, vec3 view_dir) {
 	float distance = length(light.position - frag_pos);
 	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
 
-	return Phong(light, light_dir, normal, view_dir) * attenuation;
+	return Phong(light, light_dir, normal, view_dir, 1.f) * attenuation;
 }
 
 vec4 Spotlight(Light light, vec3 normal, vec3 frag_pos, vec3 view_dir) {
@@ -103,3 +130,24 @@ vec4 Spotlight(Light light, vec3 normal, vec3 frag_pos, vec3 view_dir) {
 
 	return PointLight(light, normal, frag_pos, view_dir) * intensity;
 }
+
+// Fraction of the fragment lit by the directional light, 3x3 taps of hardware 2x2 PCF in the cascade covering it
+float Shadow(vec3 normal, vec3 light_dir) {
+	float depth = dot(frag_pos - view_pos, camera_front);
+	int cascade = 0;
+	while (cascade < cascade_count && depth > cascade_splits[cascade])
+		cascade++;
+	if (cascade >= cascade_count)
+		return 1.f;
+
+	// Orthographic projection, no division by w
+	vec3 coords = (cascade_view_projs[cascade] * vec4(frag_pos, 1.f)).xyz * 0.5 + 0.5;
+	float bias = max(0.002 * (1.0 - dot(normal, light_dir)), 0.0005);
+	vec2 texel = 1.0 / vec2(textureSize(shadow_map, 0).xy);
+
+	float lit = 0.f;
+	for (int x = -1; x <= 1; x++)
+		for (int y = -1; y <= 1; y++)
+			lit += texture(shadow_map, vec4(coords.xy + vec2(x, y) * texel, float(cascade), coords.z - bias));
+	return lit / 9.0;
+}
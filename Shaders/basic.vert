@@ -2,23 +2,69 @@
 layout(location = 0) in vec3 a_pos;
 layout(location = 1) in vec3 a_normal;
 layout(location = 2) in vec2 a_tex_coord;
+#ifdef SKINNING
+layout(location = 3) in uvec4 a_bones;
+layout(location = 4) in vec4 a_weights;
+#endif
 
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Mirrors ObjectBlock (UniformBlocks.h), matrices are computed on the CPU once per object
+layout(std140) uniform Object {
+	mat4 model;
+	mat4 model_view_proj;
+	mat3 normal_matrix;
+};
 
 
+#ifdef DEPTH_ONLY
+// Shadow map pass, only the world matrix of the object is used
+uniform mat4 light_view_proj;
+
+void main()
+{
+	gl_Position = light_view_proj * model * vec4(a_pos, 1.f);
+}
+#else
+// The depth pre-pass and the color pass must compute bit identical depths for the GL_EQUAL test
+invariant gl_Position;
+
+#ifndef DEPTH_PREPASS
 out vec3 frag_pos;
 out vec3 vertex_normal;
 out vec2 vertex_tex_coord;
+#endif
+
+#ifdef SKINNING
+// Palette of the instance, 3 texels per bone holding the rows of its affine matrix (AnimationSystem::evaluate())
+uniform samplerBuffer palette;
+uniform int palette_offset;
+
+mat4 boneMatrix(uint bone)
+{
+	int texel = palette_offset + int(bone) * 3;
+	return transpose(mat4(texelFetch(palette, texel), texelFetch(palette, texel + 1), texelFetch(palette, texel + 2), vec4(0.f, 0.f, 0.f, 1.f)));
+}
+#endif
 
 
 void main()
 {
-	frag_pos = vec3(model * vec4(a_pos, 1.f));
-	vertex_normal = mat3(transpose(inverse(model))) * a_normal;
+#ifdef SKINNING
+	mat4 skin = boneMatrix(a_bones.x) * a_weights.x + boneMatrix(a_bones.y) * a_weights.y
+		+ boneMatrix(a_bones.z) * a_weights.z + boneMatrix(a_bones.w) * a_weights.w;
+	vec3 position = vec3(skin * vec4(a_pos, 1.f));
+	vec3 normal = mat3(skin) * a_normal;
+#else
+	vec3 position = a_pos;
+	vec3 normal = a_normal;
+#endif
+
+#ifndef DEPTH_PREPASS
+	frag_pos = vec3(model * vec4(position, 1.f));
+	vertex_normal = normal_matrix * normal;
 	vertex_tex_coord = a_tex_coord;
+#endif
 
-	gl_Position = projection * view * model * vec4(a_pos, 1.f);
+	gl_Position = model_view_proj * vec4(position, 1.f);
 }
+#endif
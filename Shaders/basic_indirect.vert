@@ -0,0 +1,43 @@
+#version 430 core
+layout(location = 0) in vec3 a_pos;
+layout(location = 1) in vec3 a_normal;
+layout(location = 2) in vec2 a_tex_coord;
+
+
+// GPU-driven variant of basic.vert: the object comes from the instance list filled by gpu_culling.comp
+// Mirrors GpuObjectBlock (UniformBlocks.h)
+struct ObjectData {
+	mat4 model;
+	mat4 model_view_proj;
+	mat3 normal_matrix;
+	vec4 bounds;
+};
+layout(std430, binding = 0) readonly buffer Objects {
+	ObjectData objects[];
+};
+layout(std430, binding = 3) readonly buffer Instances {
+	uint instances[];
+};
+
+uniform uint instance_offset; // first instance of the drawn batch, gl_InstanceID doesn't include the command's baseInstance
+invariant gl_Position; // see basic.vert
+
+#ifndef DEPTH_PREPASS
+out vec3 frag_pos;
+out vec3 vertex_normal;
+out vec2 vertex_tex_coord;
+#endif
+
+
+void main()
+{
+	ObjectData object = objects[instances[instance_offset + gl_InstanceID]];
+
+#ifndef DEPTH_PREPASS
+	frag_pos = vec3(object.model * vec4(a_pos, 1.f));
+	vertex_normal = object.normal_matrix * a_normal;
+	vertex_tex_coord = a_tex_coord;
+#endif
+
+	gl_Position = object.model_view_proj * vec4(a_pos, 1.f);
+}
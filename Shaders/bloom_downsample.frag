@@ -0,0 +1,36 @@
+#version 330 core
+
+uniform sampler2D source;
+uniform vec2 uv_scale; // from fragment coordinates to the source's texture coordinates
+uniform vec2 uv_min;
+uniform vec2 uv_max; // rendered part of the source
+uniform float threshold; // negative past the first level
+
+
+out vec3 downsampled;
+
+
+vec3 Tap(vec2 uv) {
+	return texture(source, clamp(uv, uv_min, uv_max)).rgb;
+}
+
+// Four bilinear taps, each averaging 2x2 source texels: a 4x4 box filter
+void main()
+{
+	vec2 uv = gl_FragCoord.xy * uv_scale;
+	vec2 texel = 1.f / vec2(textureSize(source, 0));
+
+	vec3 color = (Tap(uv + vec2(-texel.x, -texel.y)) + Tap(uv + vec2(texel.x, -texel.y))
+		+ Tap(uv + vec2(-texel.x, texel.y)) + Tap(uv + vec2(texel.x, texel.y))) * 0.25f;
+
+	// Quadratic soft knee below the threshold, so the bloom fades in rather than popping
+	if (threshold >= 0.f) {
+		float brightness = max(color.r, max(color.g, color.b));
+		float knee = threshold * 0.5f;
+		float soft = clamp(brightness - threshold + knee, 0.f, 2.f * knee);
+		soft = soft * soft / (4.f * knee + 1e-4f);
+		color *= max(soft, brightness - threshold) / max(brightness, 1e-4f);
+	}
+
+	downsampled = color;
+}
@@ -0,0 +1,37 @@
+#version 330 core
+
+uniform sampler2D source; // level below
+uniform vec2 uv_scale; // from fragment coordinates to the source's texture coordinates
+uniform vec2 uv_min;
+uniform vec2 uv_max; // rendered part of the source
+
+#ifdef COMPOSITE
+uniform sampler2D scene; // same size as the output
+uniform float intensity;
+out vec4 frag_color;
+#else
+out vec3 upsampled; // added to the level above
+#endif
+
+
+vec3 Tap(vec2 uv) {
+	return texture(source, clamp(uv, uv_min, uv_max)).rgb;
+}
+
+// 3x3 tent filter
+void main()
+{
+	vec2 uv = gl_FragCoord.xy * uv_scale;
+	vec2 texel = 1.f / vec2(textureSize(source, 0));
+
+	vec3 bloom = Tap(uv) * 4.f;
+	bloom += (Tap(uv + vec2(-texel.x, 0.f)) + Tap(uv + vec2(texel.x, 0.f)) + Tap(uv + vec2(0.f, -texel.y)) + Tap(uv + vec2(0.f, texel.y))) * 2.f;
+	bloom += Tap(uv + vec2(-texel.x, -texel.y)) + Tap(uv + vec2(texel.x, -texel.y)) + Tap(uv + vec2(-texel.x, texel.y)) + Tap(uv + vec2(texel.x, texel.y));
+	bloom /= 16.f;
+
+#ifdef COMPOSITE
+	frag_color = vec4(texelFetch(scene, ivec2(gl_FragCoord.xy), 0).rgb + bloom * intensity, 1.f);
+#else
+	upsampled = bloom;
+#endif
+}
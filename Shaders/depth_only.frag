@@ -0,0 +1,6 @@
+#version 330 core
+
+// Shadow map and depth pre-pass, only the depth is written
+void main()
+{
+}
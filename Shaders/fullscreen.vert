@@ -0,0 +1,8 @@
+#version 330 core
+
+// Fullscreen triangle generated from the vertex index, drawn without any vertex buffer
+void main()
+{
+	vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(position * 2.f - 1.f, 0.f, 1.f);
+}
@@ -2,12 +2,15 @@
 layout(location = 0) in vec3 a_pos;
 
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Mirrors ObjectBlock (UniformBlocks.h), matrices are computed on the CPU once per object
+layout(std140) uniform Object {
+	mat4 model;
+	mat4 model_view_proj;
+	mat3 normal_matrix;
+};
 
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(a_pos, 1.f);
+	gl_Position = model_view_proj * vec4(a_pos, 1.f);
 }
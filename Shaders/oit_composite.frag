@@ -0,0 +1,23 @@
+#version 330 core
+
+uniform sampler2D accumulation;
+uniform sampler2D weight_sum;
+
+
+out vec4 frag_color;
+
+
+// Blended over the opaque scene with (SRC_ALPHA, ONE_MINUS_SRC_ALPHA)
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	vec4 accumulated = texelFetch(accumulation, texel, 0);
+	float revealage = accumulated.a;
+
+	// Nothing transparent covers this pixel
+	if (revealage >= 0.9999f)
+		discard;
+
+	vec3 average_color = accumulated.rgb / max(texelFetch(weight_sum, texel, 0).r, 1e-5f);
+	frag_color = vec4(average_color, 1.f - revealage);
+}
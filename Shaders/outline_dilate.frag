@@ -0,0 +1,33 @@
+#version 330 core
+
+uniform sampler2D mask;
+uniform ivec2 direction; // (1, 0) then (0, 1), the square dilation being separable
+uniform int radius;
+uniform ivec2 render_size; // bottom-left part of the mask drawn this frame, the rest is left over from larger frames
+
+#ifdef COMPOSITE
+uniform vec4 color;
+out vec4 frag_color;
+#else
+out float dilated;
+#endif
+
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	ivec2 last_texel = render_size - 1;
+
+	float coverage = 0.f;
+	for (int i = -radius; i <= radius; i++)
+		coverage = max(coverage, texelFetch(mask, clamp(texel + direction * i, ivec2(0), last_texel), 0).r);
+
+#ifdef COMPOSITE
+	// The stencil test already rejects the inside of the outlined objects
+	if (coverage == 0.f)
+		discard;
+	frag_color = color;
+#else
+	dilated = coverage;
+#endif
+}
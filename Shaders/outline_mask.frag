@@ -0,0 +1,9 @@
+#version 330 core
+
+out float mask;
+
+// Drawn fullscreen with a stencil test keeping the pixels of outlined objects
+void main()
+{
+	mask = 1.f;
+}
@@ -0,0 +1,45 @@
+#version 330 core
+
+in vec2 corner;
+in float life;
+in float view_depth;
+
+uniform sampler2D scene_depth; // copy of the scene's depth buffer
+uniform mat4 projection;
+
+
+#ifdef WEIGHTED_BLENDED_OIT
+// Accumulated with the transparent surfaces, see basic.frag
+layout(location = 0) out vec4 accumulation;
+layout(location = 1) out float weight_sum;
+#else
+out vec4 frag_color;
+#endif
+
+const float FADE_DISTANCE = 0.25f; // particles fade out over this distance in front of the scene
+const vec3 START_COLOR = vec3(1.6f, 0.8f, 0.3f); // above 1 to show up in the bloom
+const vec3 END_COLOR = vec3(0.3f, 0.3f, 0.35f);
+
+
+// Blended additively with (SRC_ALPHA, ONE) unless accumulated, either way particles need no sorting among themselves
+void main()
+{
+	float falloff = 1.f - dot(corner, corner);
+	if (falloff <= 0.f)
+		discard;
+
+	// Soft particles: the quad fades where it gets close to the geometry behind it instead of cutting through it
+	float depth = texelFetch(scene_depth, ivec2(gl_FragCoord.xy), 0).r * 2.f - 1.f;
+	float scene_view_depth = projection[3][2] / (depth + projection[2][2]);
+	float soft = clamp((scene_view_depth - view_depth) / FADE_DISTANCE, 0.f, 1.f);
+
+	float alpha = falloff * falloff * soft * (1.f - life);
+	vec3 color = mix(START_COLOR, END_COLOR, life);
+#ifdef WEIGHTED_BLENDED_OIT
+	float weight = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+	accumulation = vec4(color * alpha * weight, alpha);
+	weight_sum = alpha * weight;
+#else
+	frag_color = vec4(color, alpha);
+#endif
+}
@@ -0,0 +1,33 @@
+#version 330 core
+
+// Per instance, from the buffer written by the last update
+layout (location = 0) in vec4 a_position_age;
+layout (location = 1) in vec4 a_velocity_lifetime;
+
+out vec2 corner; // -1 to 1 across the quad
+out float life; // 0 when emitted, 1 when dead
+out float view_depth;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float particle_size; // half width of the quad when emitted
+
+
+// Camera facing quad drawn as a 4 vertex strip
+void main()
+{
+	corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.f - 1.f;
+	life = a_position_age.w / a_velocity_lifetime.w;
+
+	// Waiting or dead particles are moved outside of the clip volume
+	if (a_position_age.w < 0.f || life >= 1.f) {
+		view_depth = 0.f;
+		gl_Position = vec4(2.f, 2.f, 2.f, 1.f);
+		return;
+	}
+
+	vec4 view_position = view * vec4(a_position_age.xyz, 1.f);
+	view_position.xy += corner * particle_size * (1.f - 0.5f * life);
+	view_depth = -view_position.z;
+	gl_Position = projection * view_position;
+}
@@ -0,0 +1,79 @@
+#version 330 core
+
+// Particle state, read from one buffer and captured into the other by transform feedback
+layout (location = 0) in vec4 a_position_age;
+layout (location = 1) in vec4 a_velocity_lifetime;
+
+out vec4 position_age; // age in seconds, negative while waiting to be emitted
+out vec4 velocity_lifetime;
+
+uniform bool reset;
+uniform float delta_time;
+uniform uint seed; // changes every update
+uniform vec3 emitter_position;
+uniform float max_lifetime;
+
+const float EMITTER_RADIUS = 0.2f;
+const float LAUNCH_SPEED = 4.f;
+const float SPREAD = 0.35f; // horizontal speed over vertical speed
+const float DRAG = 0.4f; // per second
+const vec3 GRAVITY = vec3(0.f, -3.f, 0.f);
+
+
+// PCG hash, good enough to be used as is for every particle and update
+uint hash(uint value)
+{
+	uint state = value * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+float random(inout uint state)
+{
+	state = hash(state);
+	return float(state) * (1.f / 4294967295.f);
+}
+
+
+void main()
+{
+	uint state = hash(uint(gl_VertexID) ^ hash(seed));
+
+	// Emission times spread over a lifetime, so that the emitter starts at its steady rate
+	if (reset) {
+		position_age = vec4(emitter_position, -random(state) * max_lifetime);
+		velocity_lifetime = vec4(0.f, 0.f, 0.f, max_lifetime);
+		return;
+	}
+
+	vec3 position = a_position_age.xyz;
+	float age = a_position_age.w + delta_time;
+	vec3 velocity = a_velocity_lifetime.xyz;
+	float lifetime = a_velocity_lifetime.w;
+
+	if (age < 0.f) {
+		position_age = vec4(position, age);
+		velocity_lifetime = a_velocity_lifetime;
+		return;
+	}
+
+	// Emitted for the first time or dead: recycled in place, the particle count never changes
+	if (a_position_age.w < 0.f || age >= lifetime) {
+		float angle = random(state) * 6.2831853f;
+		float radius = sqrt(random(state));
+		vec2 disc = vec2(cos(angle), sin(angle)) * radius;
+
+		position = emitter_position + vec3(disc.x, 0.f, disc.y) * EMITTER_RADIUS;
+		velocity = vec3(disc.x * SPREAD, 1.f, disc.y * SPREAD) * LAUNCH_SPEED * mix(0.75f, 1.f, random(state));
+		lifetime = mix(0.5f, 1.f, random(state)) * max_lifetime;
+		age = 0.f;
+	}
+	else {
+		velocity += GRAVITY * delta_time;
+		velocity *= max(1.f - DRAG * delta_time, 0.f);
+		position += velocity * delta_time;
+	}
+
+	position_age = vec4(position, age);
+	velocity_lifetime = vec4(velocity, lifetime);
+}
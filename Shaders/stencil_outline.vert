@@ -6,12 +6,15 @@ layout(location = 2) in vec2 a_tex_coord;
 
 uniform float offset;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Mirrors ObjectBlock (UniformBlocks.h), matrices are computed on the CPU once per object
+layout(std140) uniform Object {
+	mat4 model;
+	mat4 model_view_proj;
+	mat3 normal_matrix;
+};
 
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(a_pos + a_normal * offset, 1.f);
+	gl_Position = model_view_proj * vec4(a_pos + a_normal * offset, 1.f);
 }
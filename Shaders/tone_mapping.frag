@@ -0,0 +1,19 @@
+#version 330 core
+
+uniform sampler2D scene; // HDR, same size as the output
+uniform float exposure;
+
+
+out vec4 frag_color;
+
+
+// Fit of the ACES filmic curve (Narkowicz, 2015)
+vec3 Aces(vec3 color) {
+	return clamp((color * (2.51f * color + 0.03f)) / (color * (2.43f * color + 0.59f) + 0.14f), 0.f, 1.f);
+}
+
+void main()
+{
+	vec3 color = texelFetch(scene, ivec2(gl_FragCoord.xy), 0).rgb * exposure;
+	frag_color = vec4(Aces(color), 1.f);
+}
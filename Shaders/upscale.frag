@@ -0,0 +1,33 @@
+#version 330 core
+
+uniform sampler2D scene;
+uniform ivec2 render_size; // bottom-left part of the scene texture holding the frame
+uniform ivec2 output_size;
+uniform float sharpness; // 0 = bilinear, 1 = strongest
+
+
+out vec4 frag_color;
+
+
+// Bilinear upscale followed by an unsharp mask, clamped to the range of the neighbours so edges don't get halos
+void main()
+{
+	vec2 texel = 1.f / vec2(textureSize(scene, 0));
+	vec2 uv = gl_FragCoord.xy / vec2(output_size) * vec2(render_size) * texel;
+
+	// Pixels outside of the rendered area are left over from frames at a higher resolution
+	vec2 low = 0.5f * texel;
+	vec2 high = (vec2(render_size) - 0.5f) * texel;
+
+	vec3 center = texture(scene, clamp(uv, low, high)).rgb;
+	vec3 north = texture(scene, clamp(uv + vec2(0.f, texel.y), low, high)).rgb;
+	vec3 south = texture(scene, clamp(uv - vec2(0.f, texel.y), low, high)).rgb;
+	vec3 east = texture(scene, clamp(uv + vec2(texel.x, 0.f), low, high)).rgb;
+	vec3 west = texture(scene, clamp(uv - vec2(texel.x, 0.f), low, high)).rgb;
+
+	vec3 minimum = min(center, min(min(north, south), min(east, west)));
+	vec3 maximum = max(center, max(max(north, south), max(east, west)));
+	vec3 sharpened = center + sharpness * (4.f * center - north - south - east - west) * 0.25f;
+
+	frag_color = vec4(clamp(sharpened, minimum, maximum), 1.f);
+}